@@ -39,6 +39,16 @@ CONF_POWER_CALIBRATION = 'power_calibration'
 CONF_NIGHT_MODE_TIMEOUT = 'night_mode_timeout'
 CONF_STALE_TIMEOUT = 'stale_timeout'
 CONF_HISTORY_INTERVAL = 'history_interval'
+CONF_HISTORY_GROUP_COMMIT = 'history_group_commit'
+CONF_HISTORY_PANEL_DBS = 'history_panel_dbs'
+CONF_HISTORY_PANEL_METRICS = 'history_panel_metrics'
+CONF_RECENT_SAMPLES = 'recent_samples'
+CONF_UNDERPERFORMANCE_THRESHOLD = 'underperformance_threshold'
+CONF_UNDERPERFORMANCE_DURATION = 'underperformance_duration'
+
+# Extra per-panel history series; bit positions mirror PanelMetric in
+# tigo_history.h (power, bit 0, is always recorded).
+HISTORY_PANEL_METRICS = {'vin': 1, 'vout': 2, 'temp': 3, 'rssi': 4}
 
 # Inverter configuration schema
 INVERTER_SCHEMA = cv.Schema({
@@ -57,6 +67,16 @@ def _warn_history_wear(config):
     Runs as a validator rather than in to_code so `esphome config` surfaces it.
     """
     minutes = config[CONF_HISTORY_INTERVAL]
+    group = config[CONF_HISTORY_GROUP_COMMIT]
+    # Below 5 min only with group commit, and only while the commit cadence
+    # (interval x group) stays at or above the 5-min floor
+    # (kMinSnapshotIntervalMin / kMaxGroupCommit in tigo_history.h).
+    if minutes * group < 5:
+        raise cv.Invalid(
+            f"history_interval of {minutes} min commits to flash more often than every 5 min; "
+            f"set history_group_commit to at least {-(-5 // minutes)} to batch the snapshots",
+            path=[CONF_HISTORY_GROUP_COMMIT],
+        )
     if minutes < 15:
         _LOGGER.warning(
             "history_interval is %d min, %.1fx more often than the 30 min "
@@ -86,7 +106,33 @@ CONFIG_SCHEMA = cv.All(cv.Schema({
     # in tigo_history.h. The 5-minute floor predates the sidecar header (a commit
     # then held the flash lock ~21 s, making 5 min a ~7% duty cycle); at ~0.65 s
     # it is now a retention guard — 5 min leaves only ~19 days of panel history.
-    cv.Optional(CONF_HISTORY_INTERVAL, default=30): cv.int_range(min=5, max=1440),
+    # Below 5 only together with history_group_commit (see _warn_history_wear).
+    cv.Optional(CONF_HISTORY_INTERVAL, default=30): cv.int_range(min=1, max=1440),
+    # Snapshots held in RAM and written to flash as one commit. 1 = commit each
+    # snapshot. Held rows are lost on a crash or power cut (not on a reboot,
+    # OTA or night-mode entry, which flush them).
+    cv.Optional(CONF_HISTORY_GROUP_COMMIT, default=1): cv.int_range(min=1, max=12),
+    # Panel history databases, 16 panels each (kNumPanelDbs / kMaxPanelDbs in
+    # tigo_history.h). Left out, it is sized from number_of_devices, never
+    # below the original 3. The panel files share one flash budget, so each
+    # extra database shortens every panel's retention.
+    cv.Optional(CONF_HISTORY_PANEL_DBS): cv.int_range(min=1, max=8),
+    # Per-panel series recorded beside power, each in its own panel DBs and
+    # served by /api/history/panel?metric=. They take their flash from the
+    # panel budget, so each one shortens power's retention.
+    cv.Optional(CONF_HISTORY_PANEL_METRICS, default=[]): cv.ensure_list(
+        cv.one_of(*HISTORY_PANEL_METRICS, lower=True)),
+    # Per-device depth of the frame-rate RAM ring behind /api/recent, in power
+    # frames. 10 bytes each, PSRAM only (off without it); 0 disables. Mirrors
+    # kDefaultRecentSamples in tigo_recent.h.
+    cv.Optional(CONF_RECENT_SAMPLES, default=720): cv.int_range(min=0, max=100000),
+    # A panel whose smoothed output stays below this fraction of its string
+    # median for `underperformance_duration` minutes is flagged in /api/alerts
+    # and on its `underperforming` binary sensor. Mirrors the defaults in
+    # tigo_health.h.
+    cv.Optional(CONF_UNDERPERFORMANCE_THRESHOLD, default="70%"): cv.All(
+        cv.percentage, cv.Range(min=0.05, max=0.95)),
+    cv.Optional(CONF_UNDERPERFORMANCE_DURATION, default=30): cv.int_range(min=1, max=1440),
 }).extend(cv.polling_component_schema('30s')).extend(uart.UART_DEVICE_SCHEMA), _warn_history_wear)
 
 @coroutine
@@ -97,6 +143,20 @@ def to_code(config):
     
     cg.add(var.set_number_of_devices(config[CONF_NUMBER_OF_DEVICES]))
     cg.add(var.set_snapshot_interval_min(config[CONF_HISTORY_INTERVAL]))
+    cg.add(var.set_history_group_commit(config[CONF_HISTORY_GROUP_COMMIT]))
+    # Sizes every panel array in the history layer, so it is a define rather
+    # than a setter.
+    panel_dbs = config.get(CONF_HISTORY_PANEL_DBS)
+    if panel_dbs is None:
+        panel_dbs = max(3, -(-config[CONF_NUMBER_OF_DEVICES] // 16))
+    cg.add_define("TIGO_HISTORY_PANEL_DBS", panel_dbs)
+    metric_mask = 0
+    for metric in config[CONF_HISTORY_PANEL_METRICS]:
+        metric_mask |= 1 << HISTORY_PANEL_METRICS[metric]
+    cg.add_define("TIGO_HISTORY_PANEL_METRICS", metric_mask)
+    cg.add(var.set_recent_samples(config[CONF_RECENT_SAMPLES]))
+    cg.add(var.set_underperformance_threshold(config[CONF_UNDERPERFORMANCE_THRESHOLD]))
+    cg.add(var.set_underperformance_duration(config[CONF_UNDERPERFORMANCE_DURATION] * 60000))
 
     
     if CONF_CCA_IP in config:
@@ -4,18 +4,32 @@ import esphome.config_validation as cv
 from esphome.components import binary_sensor
 from esphome.const import (
     CONF_ID,
+    CONF_ADDRESS,
+    DEVICE_CLASS_PROBLEM,
 )
 from . import tigo_monitor_ns, TigoMonitorComponent, CONF_TIGO_MONITOR_ID
 
 DEPENDENCIES = ['tigo_monitor']
 
 CONF_NIGHT_MODE = "night_mode"
+CONF_UNDERPERFORMING = "underperforming"
+
+# One entry per panel to watch, keyed by its 4-character short address like the
+# per-device sensors. The state comes from the underperformance detector
+# (`underperformance_threshold` / `underperformance_duration`).
+UNDERPERFORMING_SCHEMA = binary_sensor.binary_sensor_schema(
+    device_class=DEVICE_CLASS_PROBLEM,
+    icon="mdi:solar-panel",
+).extend({
+    cv.Required(CONF_ADDRESS): cv.string,
+})
 
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(CONF_TIGO_MONITOR_ID): cv.use_id(TigoMonitorComponent),
     cv.Optional(CONF_NIGHT_MODE): binary_sensor.binary_sensor_schema(
         icon="mdi:weather-night"
     ),
+    cv.Optional(CONF_UNDERPERFORMING): cv.ensure_list(UNDERPERFORMING_SCHEMA),
 }).extend(cv.COMPONENT_SCHEMA)
 
 async def to_code(config):
@@ -24,3 +38,7 @@ async def to_code(config):
     if CONF_NIGHT_MODE in config:
         sens = await binary_sensor.new_binary_sensor(config[CONF_NIGHT_MODE])
         cg.add(parent.add_night_mode_sensor(sens))
+
+    for conf in config.get(CONF_UNDERPERFORMING, []):
+        sens = await binary_sensor.new_binary_sensor(conf)
+        cg.add(parent.add_underperforming_sensor(conf[CONF_ADDRESS], sens))
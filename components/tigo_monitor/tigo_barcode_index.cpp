@@ -0,0 +1,166 @@
+// Barcode index — long address -> node -> history slot, shared by everything
+// that has to find a node from a barcode.
+//
+// Four paths used to do that with strings. The history snapshot cut the last
+// six characters off every device's barcode into a fresh std::string (two
+// internal-heap allocations) and hashed it into TigoHistory's slot map, for
+// every panel on every snapshot, under the state lock. /api/panels copied the
+// whole node table and built an unordered_map of suffix strings per request.
+// CCA and cloud imports compared every serial against every node, copying
+// each node's barcode and, for the cloud, upper-casing a substring of it.
+//
+// A long address is 16 hex digits, i.e. a uint64, and the 6-digit suffix the
+// slot map and cloud serials use is its low 24 bits. So the index is the node
+// table's long addresses as numbers, sorted, with a second ordering by suffix:
+// every lookup is a binary search with no allocation. The history slot is
+// cached in the entry the first time the snapshot resolves it, so only a
+// panel's first snapshot reaches TigoHistory::get_or_assign_slot().
+//
+// Nothing has to keep it in step entry by entry. Code that changes node_table_
+// sets barcode_index_dirty_, and the next lookup rebuilds it — O(n log n) over
+// at most a few hundred nodes, once per change, carrying resolved slots
+// across. A lookup also checks the node it lands on still holds that address,
+// and a table whose size moved without the flag being set is caught too.
+
+#include "tigo_monitor.h"
+
+#include "esphome/core/log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace tigo_monitor {
+
+static const char *const BARCODE_TAG = "tigo_monitor.barcode";
+
+static constexpr uint32_t kSuffixMask = 0xFFFFFF;  // 6 hex digits
+
+// Exactly `len` hex digits, either case.
+static bool parse_barcode_hex_(const char *s, size_t len, uint64_t &out) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < len; ++i) {
+    char c = s[i];
+    uint8_t d;
+    if (c >= '0' && c <= '9') {
+      d = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      d = c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+      d = c - 'a' + 10;
+    } else {
+      return false;
+    }
+    v = (v << 4) | d;
+  }
+  out = v;
+  return true;
+}
+
+static bool node_long_addr_(const NodeTableData &node, uint64_t &out) {
+  return node.long_address.size() == 16 && parse_barcode_hex_(node.long_address.data(), 16, out);
+}
+
+void TigoMonitorComponent::rebuild_barcode_index_() const {
+  StateLock lock(state_mutex_);
+  node_vector<BarcodeEntry> index;
+  index.reserve(node_table_.size());
+  for (size_t i = 0; i < node_table_.size() && i < UINT16_MAX; ++i) {
+    uint64_t addr;
+    if (!node_long_addr_(node_table_[i], addr)) continue;
+    BarcodeEntry e;
+    e.long_addr = addr;
+    e.node = (uint16_t) i;
+    index.push_back(e);
+  }
+  auto by_addr = [](const BarcodeEntry &a, const BarcodeEntry &b) {
+    return a.long_addr != b.long_addr ? a.long_addr < b.long_addr : a.node < b.node;
+  };
+  std::sort(index.begin(), index.end(), by_addr);
+
+  // Carry resolved slots over: they belong to the address, not the position.
+  for (auto &e : index) {
+    auto old = std::lower_bound(barcode_index_.begin(), barcode_index_.end(), e.long_addr,
+                                [](const BarcodeEntry &a, uint64_t v) { return a.long_addr < v; });
+    if (old != barcode_index_.end() && old->long_addr == e.long_addr) e.slot = old->slot;
+  }
+  barcode_index_.swap(index);
+
+  barcode_suffixes_.resize(barcode_index_.size());
+  for (size_t i = 0; i < barcode_suffixes_.size(); ++i) barcode_suffixes_[i] = (uint16_t) i;
+  // Stable on node order, so a suffix shared by two nodes resolves to the
+  // first in the table. The cloud import's scan took the first match too;
+  // /api/panels' suffix map kept the last, and now agrees with the rest.
+  std::stable_sort(barcode_suffixes_.begin(), barcode_suffixes_.end(), [this](uint16_t a, uint16_t b) {
+    const BarcodeEntry &ea = barcode_index_[a], &eb = barcode_index_[b];
+    uint32_t sa = ea.long_addr & kSuffixMask, sb = eb.long_addr & kSuffixMask;
+    return sa != sb ? sa < sb : ea.node < eb.node;
+  });
+
+  barcode_index_dirty_ = false;
+  barcode_index_nodes_ = node_table_.size();
+  ESP_LOGD(BARCODE_TAG, "Barcode index rebuilt: %zu of %zu nodes", barcode_index_.size(), node_table_.size());
+}
+
+BarcodeEntry *TigoMonitorComponent::find_barcode_(uint64_t long_addr) const {
+  StateLock lock(state_mutex_);
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (barcode_index_dirty_ || barcode_index_nodes_ != node_table_.size()) rebuild_barcode_index_();
+    auto it = std::lower_bound(barcode_index_.begin(), barcode_index_.end(), long_addr,
+                               [](const BarcodeEntry &a, uint64_t v) { return a.long_addr < v; });
+    if (it == barcode_index_.end() || it->long_addr != long_addr) return nullptr;
+    uint64_t held;
+    if (it->node < node_table_.size() && node_long_addr_(node_table_[it->node], held) && held == long_addr)
+      return &*it;
+    // A change that did not mark the index; rebuild once and look again.
+    barcode_index_dirty_ = true;
+  }
+  return nullptr;
+}
+
+BarcodeEntry *TigoMonitorComponent::find_barcode_(const node_string &long_address) const {
+  uint64_t addr;
+  if (long_address.size() != 16 || !parse_barcode_hex_(long_address.data(), 16, addr)) return nullptr;
+  return find_barcode_(addr);
+}
+
+const BarcodeEntry *TigoMonitorComponent::find_barcode_suffix_(uint32_t suffix) const {
+  StateLock lock(state_mutex_);
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (barcode_index_dirty_ || barcode_index_nodes_ != node_table_.size()) rebuild_barcode_index_();
+    auto it = std::lower_bound(barcode_suffixes_.begin(), barcode_suffixes_.end(), suffix,
+                               [this](uint16_t pos, uint32_t v) {
+                                 return (uint32_t) (barcode_index_[pos].long_addr & kSuffixMask) < v;
+                               });
+    if (it == barcode_suffixes_.end()) return nullptr;
+    const BarcodeEntry &e = barcode_index_[*it];
+    if ((e.long_addr & kSuffixMask) != suffix) return nullptr;
+    uint64_t held;
+    if (e.node < node_table_.size() && node_long_addr_(node_table_[e.node], held) && held == e.long_addr)
+      return &e;
+    barcode_index_dirty_ = true;
+  }
+  return nullptr;
+}
+
+const NodeTableData *TigoMonitorComponent::find_node_by_barcode_suffix(const char *last6) const {
+  uint64_t suffix;
+  if (last6 == nullptr || strlen(last6) != 6 || !parse_barcode_hex_(last6, 6, suffix)) return nullptr;
+  StateLock lock(state_mutex_);
+  const BarcodeEntry *e = find_barcode_suffix_((uint32_t) suffix);
+  return e != nullptr ? &node_table_[e->node] : nullptr;
+}
+
+NodeTableData *TigoMonitorComponent::find_node_in_serial_(const std::string &serial, size_t digits) {
+  if (digits != 16 && digits != 6) return nullptr;
+  StateLock lock(state_mutex_);
+  for (size_t i = 0; i + digits <= serial.size(); ++i) {
+    uint64_t v;
+    if (!parse_barcode_hex_(serial.data() + i, digits, v)) continue;
+    const BarcodeEntry *e = digits == 16 ? find_barcode_(v) : find_barcode_suffix_((uint32_t) v);
+    if (e != nullptr) return &node_table_[e->node];
+  }
+  return nullptr;
+}
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -411,28 +411,22 @@ void TigoMonitorComponent::match_cloud_layout_to_uart_(const char *layout_json)
           // serial "4-BBCC02K" (6-hex core + a check char). The UART side only has the MAC
           // (long_address), so match a node when its MAC's last 6 chars appear anywhere in
           // the serial (case-insensitive) — the printed serial and the MAC are otherwise
-          // disjoint identifier spaces.
+          // disjoint identifier spaces. Each 6-hex run in the serial is one lookup in the
+          // barcode index's suffix order, so no node barcode is copied or upper-cased.
           std::string serial_up = ser->valuestring;
           for (char &c : serial_up) c = (char) toupper((unsigned char) c);
-          bool found = false;
-          for (auto &node : node_table_) {
-            node_string bc = get_barcode_for_node(node);
-            if (bc.size() < 6) continue;
-            std::string last6 = to_std_string(bc).substr(bc.size() - 6);
-            for (char &c : last6) c = (char) toupper((unsigned char) c);
-            if (serial_up.find(last6) == std::string::npos) continue;
-            node.cca_label = panel_label;
-            node.cca_string_label = string_label;
-            node.cca_inverter_label = mppt_label;
-            node.cca_object_id = obj_id;
-            node.cca_validated = true;
+          NodeTableData *node = find_node_in_serial_(serial_up, 6);
+          if (node != nullptr) {
+            node->cca_label = panel_label;
+            node->cca_string_label = string_label;
+            node->cca_inverter_label = mppt_label;
+            node->cca_object_id = obj_id;
+            node->cca_validated = true;
             matched++;
-            found = true;
-            ESP_LOGD(CLOUD_TAG, "Matched %s (...%s) -> '%s' [%s / %s]", node.addr.c_str(),
-                     last6.c_str(), panel_label.c_str(), mppt_label.c_str(), string_label.c_str());
-            break;
-          }
-          if (!found) {
+            ESP_LOGD(CLOUD_TAG, "Matched %s (...%s) -> '%s' [%s / %s]", node->addr.c_str(),
+                     node->long_address.c_str() + 10, panel_label.c_str(), mppt_label.c_str(),
+                     string_label.c_str());
+          } else {
             ESP_LOGD(CLOUD_TAG, "No UART node for cloud panel '%s' (serial %s)",
                      panel_label.c_str(), serial_up.c_str());
           }
@@ -461,15 +455,13 @@ void TigoMonitorComponent::cloud_save_creds_() {
   strncpy(c.refresh, cloud_refresh_token_.c_str(), sizeof(c.refresh) - 1);
   strncpy(c.expires, cloud_expires_iso_.c_str(), sizeof(c.expires) - 1);
   c.system_id = cloud_system_id_;
-  auto pref = this->cached_pref_<CloudCreds>(cloud_creds_hash());
-  pref.save(&c);
+  this->persist_save_(cloud_creds_hash(), "cloud_creds", c, kPersistNowMs);
   ESP_LOGD(CLOUD_TAG, "Cloud creds persisted (token %d bytes)", (int) cloud_token_.size());
 }
 
 void TigoMonitorComponent::tigo_cloud_load_creds() {
   CloudCreds c{};
-  auto pref = this->cached_pref_<CloudCreds>(cloud_creds_hash());
-  if (!pref.load(&c))
+  if (!this->persist_load_(cloud_creds_hash(), "cloud_creds", &c))
     return;
   c.email[sizeof(c.email) - 1] = '\0';
   c.token[sizeof(c.token) - 1] = '\0';
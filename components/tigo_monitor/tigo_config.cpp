@@ -56,8 +56,7 @@ void TigoMonitorComponent::tigo_config_load() {
   cfg_def_cca_ip_ = cca_ip_;
 
   TigoConfig c{};
-  auto pref = this->cached_pref_<TigoConfig>(tigo_config_hash());
-  if (!pref.load(&c) || c.magic != CFG_MAGIC) {
+  if (!this->persist_load_(tigo_config_hash(), "tigo_config", &c) || c.magic != CFG_MAGIC) {
     cfg_overrides_ = 0;
     return;
   }
@@ -83,8 +82,7 @@ void TigoMonitorComponent::tigo_config_save_() {
   c.reset_at_midnight = reset_at_midnight_ ? 1 : 0;
   c.sync_cca_on_startup = sync_cca_on_startup_ ? 1 : 0;
   strncpy(c.cca_ip, cca_ip_.c_str(), sizeof(c.cca_ip) - 1);
-  auto pref = this->cached_pref_<TigoConfig>(tigo_config_hash());
-  pref.save(&c);
+  this->persist_save_(tigo_config_hash(), "tigo_config", c, kPersistNowMs);
   ESP_LOGD(CFG_TAG, "User config persisted (overrides 0x%02X)", (unsigned) cfg_overrides_);
 }
 
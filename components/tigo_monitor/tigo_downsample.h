@@ -0,0 +1,83 @@
+#pragma once
+
+// Streaming point-budget downsampler for the history endpoints.
+//
+// A history query used to emit every stored row, up to a 1 MB response cap, and
+// leave the browser to thin a week of raw snapshots down to the few hundred
+// pixels it actually draws. Now the handler asks for `points` and rows are
+// folded into that many equal-width time buckets as they come out of the
+// query callback, one bucket in RAM at a time: min, max and mean power and
+// summed energy per bucket. Response size and formatting cost are bounded by
+// the budget, not by the range.
+//
+// Bucket aggregation rather than LTTB: LTTB picks one real sample per bucket
+// by looking one bucket ahead, so it needs two buckets buffered and still
+// drops the extremes a power chart is read for. min/max/avg keeps the
+// envelope, and it composes with rollup rows (which are already min/avg/max)
+// by taking the min of mins and the max of maxes.
+//
+// Input rows must arrive in ascending time — tsdb queries return them that
+// way. A bucket is timestamped with its first row, so records line up with the
+// rows they summarize. tests/host/test_downsample.cpp checks it against a
+// naive per-bucket reference.
+
+#include <cstdint>
+
+namespace esphome {
+namespace tigo_monitor {
+
+class HistoryDownsampler {
+ public:
+  // Buckets of ceil((end - start + 1) / points) seconds, anchored at start_ts.
+  HistoryDownsampler(uint32_t start_ts, uint32_t end_ts, uint32_t points) : start_ts_(start_ts) {
+    const uint64_t span = (end_ts >= start_ts) ? (uint64_t) end_ts - start_ts + 1 : 1;
+    if (points == 0) points = 1;
+    const uint64_t width = (span + points - 1) / points;
+    // The whole 32-bit range in one point is 2^32 s, one past what fits.
+    width_s_ = width > UINT32_MAX ? UINT32_MAX : (uint32_t) width;
+    if (width_s_ == 0) width_s_ = 1;
+  }
+
+  uint32_t width_s() const { return width_s_; }
+
+  // Folds one row. `emit(ts, avg, lo, hi, e_kwh)` fires for each bucket the
+  // row closes.
+  template<typename Emit> void add(uint32_t ts, float avg, float lo, float hi, float e_kwh, Emit &&emit) {
+    const uint32_t idx = (ts >= start_ts_) ? (ts - start_ts_) / width_s_ : 0;
+    if (n_ > 0 && idx != idx_) flush(emit);
+    if (n_ == 0) {
+      idx_ = idx;
+      t_ = ts;
+      lo_ = lo;
+      hi_ = hi;
+      sum_ = 0.0;
+      e_ = 0.0;
+    }
+    if (lo < lo_) lo_ = lo;
+    if (hi > hi_) hi_ = hi;
+    sum_ += avg;
+    e_ += e_kwh;
+    n_++;
+  }
+
+  // Emits the bucket still open, if any. Call once after the last row.
+  template<typename Emit> void flush(Emit &&emit) {
+    if (n_ == 0) return;
+    emit(t_, (float) (sum_ / n_), lo_, hi_, (float) e_);
+    n_ = 0;
+  }
+
+ private:
+  uint32_t start_ts_;
+  uint32_t width_s_{1};
+  uint32_t idx_{0};
+  uint32_t n_{0};
+  uint32_t t_{0};
+  float lo_{0.0f};
+  float hi_{0.0f};
+  double sum_{0.0};
+  double e_{0.0};
+};
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,367 @@
+// Daily energy archive — one total per calendar day, kept for years.
+//
+// This used to be a std::vector of the last 7 days, saved as a single
+// 57-byte NVS blob and searched linearly on every archive and every
+// /api/energy/history request; anything older fell off the end, so the
+// dashboard's "this month" only ever saw a week. Now each day is one packed
+// uint32 (day number since kEnergyEpochYear-01-01 in the top 15 bits, kWh x100
+// in the low 17, so up to 1,310.71 kWh a day) in a ring of kEnergyRingDays
+// slots indexed by day number. A record carries its own day, so a slot that
+// holds a different day than the one asked for — never written, or from a
+// lap ago — reads as empty, and neither archiving nor lookup scans anything.
+//
+// The ring is stored as fixed-size NVS blobs of kEnergyChunkDays records
+// (EnergyDayChunk, 520 B), so archiving a day restages the one chunk it lands
+// in, and the persistence manager drops the write of any chunk that did not
+// change. Monthly totals (kWh x10, 20 bits) sit in a second ring that outlives
+// the daily one, in one blob; a month's total is re-summed from its days on
+// every archive, so re-archiving a day (midnight and a reboot can both do
+// it) cannot count it twice.
+//
+// Migration is automatic: when no chunk is found, the old 7-day blob is read
+// once, archived into the ring and blanked.
+
+#include "tigo_monitor.h"
+
+#include "esphome/core/log.h"
+#include "esphome/core/helpers.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace esphome {
+namespace tigo_monitor {
+
+static const char *const ENERGY_TAG = "tigo_monitor.energy";
+
+static constexpr uint32_t kEnergyDaysMagic = 0x44454754;    // "TGED"
+static constexpr uint32_t kEnergyMonthsMagic = 0x4D454754;  // "TGEM"
+static constexpr uint8_t kEnergyStoreVersion = 1;
+
+static constexpr unsigned kDayValueBits = 17;
+static constexpr uint32_t kDayValueMax = (1u << kDayValueBits) - 1;  // 1,310.71 kWh
+static constexpr int32_t kDayNumberMax = (1 << (32 - kDayValueBits)) - 1;  // year 2109
+static constexpr unsigned kMonthValueBits = 20;
+static constexpr uint32_t kMonthValueMax = (1u << kMonthValueBits) - 1;  // 104,857.5 kWh
+static constexpr int32_t kMonthNumberMax = (1 << (32 - kMonthValueBits)) - 1;
+
+static_assert(kEnergyDayChunks <= 16, "energy_dirty_chunks_ is a uint16_t mask");
+
+// One NVS blob of the daily ring: kEnergyChunkDays records from
+// index * kEnergyChunkDays.
+struct EnergyDayChunk {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t index;
+  uint16_t reserved;
+  uint32_t days[kEnergyChunkDays];
+};
+static_assert(sizeof(EnergyDayChunk) == 8 + 4 * kEnergyChunkDays, "EnergyDayChunk must stay packed");
+
+struct EnergyMonthBlob {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t reserved[3];
+  uint32_t months[kEnergyRingMonths];
+};
+
+// The pre-archive layout: a count byte, then 7 x (YYYYMMDD key, float kWh).
+static constexpr size_t kLegacyDays = 7;
+static constexpr size_t kLegacyBytes = 1 + kLegacyDays * 8;
+static const char *const kLegacyKey = "daily_energy_history";
+
+static uint32_t energy_chunk_hash_(uint8_t index, char (&key)[24]) {
+  snprintf(key, sizeof(key), "energy_days_v1_%u", (unsigned) index);
+  return fnv1_hash(key);
+}
+
+static const char *const kMonthsKey = "energy_months_v1";
+
+// Proleptic Gregorian day count (H. Hinnant's days_from_civil), valid for any
+// year this device will see.
+static constexpr int32_t days_from_civil_(int32_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  const int32_t era = y / 400;
+  const uint32_t yoe = static_cast<uint32_t>(y - era * 400);
+  const uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+static constexpr int32_t kEpochDays = days_from_civil_(kEnergyEpochYear, 1, 1);
+
+DailyEnergyData DailyEnergyData::from_day_number(uint32_t day) {
+  const int32_t z = static_cast<int32_t>(day) + kEpochDays + 719468;
+  const int32_t era = z / 146097;
+  const uint32_t doe = static_cast<uint32_t>(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  DailyEnergyData out;
+  out.day = static_cast<uint8_t>(doy - (153 * mp + 2) / 5 + 1);
+  out.month = static_cast<uint8_t>(mp < 10 ? mp + 3 : mp - 9);
+  out.year = static_cast<uint16_t>(static_cast<int32_t>(yoe) + era * 400 + (out.month <= 2));
+  return out;
+}
+
+int32_t DailyEnergyData::day_number() const {
+  if (year < kEnergyEpochYear || month < 1 || month > 12 || day < 1 || day > 31) return -1;
+  const int32_t n = days_from_civil_(year, month, day) - kEpochDays;
+  // days_from_civil_ normalises Feb 30 into March; the round trip does not.
+  const DailyEnergyData check = from_day_number(static_cast<uint32_t>(n));
+  if (check.day != day || check.month != month) return -1;
+  return n;
+}
+
+static int32_t month_number_(const DailyEnergyData &d) {
+  if (d.year < kEnergyEpochYear || d.month < 1 || d.month > 12) return -1;
+  return (d.year - kEnergyEpochYear) * 12 + (d.month - 1);
+}
+
+static DailyEnergyData from_month_number_(int32_t n) {
+  DailyEnergyData out;
+  out.year = static_cast<uint16_t>(kEnergyEpochYear + n / 12);
+  out.month = static_cast<uint8_t>(n % 12 + 1);
+  return out;
+}
+
+static uint32_t scale_energy_(float kwh, float scale, uint32_t max) {
+  if (!(kwh > 0.0f)) return 0;
+  const float scaled = kwh * scale + 0.5f;
+  return scaled >= static_cast<float>(max) ? max : static_cast<uint32_t>(scaled);
+}
+
+// Value of the record in `day`'s slot if it holds that day, else 0.
+static uint32_t day_value_(const node_vector<uint32_t> &ring, int32_t day) {
+  const uint32_t rec = ring[static_cast<uint32_t>(day) % kEnergyRingDays];
+  if (rec == 0 || static_cast<int32_t>(rec >> kDayValueBits) != day) return 0;
+  return rec & kDayValueMax;
+}
+
+static uint32_t month_value_(const node_vector<uint32_t> &ring, int32_t month) {
+  const uint32_t rec = ring[static_cast<uint32_t>(month) % kEnergyRingMonths];
+  if (rec == 0 || static_cast<int32_t>(rec >> kMonthValueBits) != month) return 0;
+  return rec & kMonthValueMax;
+}
+
+void TigoMonitorComponent::archive_daily_energy_(uint32_t day_key, float energy_kwh) {
+  const DailyEnergyData date = DailyEnergyData::from_key(day_key);
+  const int32_t day = date.day_number();
+  if (day < 0 || day > kDayNumberMax) {
+    ESP_LOGW(ENERGY_TAG, "Not archiving %u: not a date in %u..2109", (unsigned) day_key, (unsigned) kEnergyEpochYear);
+    return;
+  }
+
+  StateLock lock(state_mutex_);
+  if (energy_days_.empty()) energy_days_.assign(kEnergyRingDays, 0);
+  if (energy_months_.empty()) energy_months_.assign(kEnergyRingMonths, 0);
+
+  const uint32_t slot = static_cast<uint32_t>(day) % kEnergyRingDays;
+  if (static_cast<int32_t>(energy_days_[slot] >> kDayValueBits) > day) {
+    ESP_LOGW(ENERGY_TAG, "Not archiving %u: older than the archive's %zu days", (unsigned) day_key, kEnergyRingDays);
+    return;
+  }
+  const uint32_t value = scale_energy_(energy_kwh, 100.0f, kDayValueMax);
+  if (value == kDayValueMax)
+    ESP_LOGW(ENERGY_TAG, "%u: %.2f kWh clamped to %.2f", (unsigned) day_key, energy_kwh, kDayValueMax / 100.0f);
+  energy_days_[slot] = (static_cast<uint32_t>(day) << kDayValueBits) | value;
+  energy_dirty_chunks_ |= static_cast<uint16_t>(1u << (slot / kEnergyChunkDays));
+
+  // A day archived now has its whole month alongside it in the ring. Only a
+  // day from the far edge of the ring may not; its month total is kept as is
+  // rather than re-summed from the days that survived.
+  const int32_t first = day - (date.day - 1);
+  uint64_t month_cwh = 0;
+  bool month_complete = true;
+  for (int32_t d = first; d < first + 31; ++d) {
+    const DailyEnergyData dd = DailyEnergyData::from_day_number(static_cast<uint32_t>(d));
+    if (dd.month != date.month) break;
+    if (static_cast<int32_t>(energy_days_[static_cast<uint32_t>(d) % kEnergyRingDays] >> kDayValueBits) > d)
+      month_complete = false;
+    month_cwh += day_value_(energy_days_, d);
+  }
+  const int32_t month = month_number_(date);
+  if (month_complete && month <= kMonthNumberMax) {
+    const uint32_t month_value = static_cast<uint32_t>(std::min<uint64_t>((month_cwh + 5) / 10, kMonthValueMax));
+    energy_months_[static_cast<uint32_t>(month) % kEnergyRingMonths] =
+        (static_cast<uint32_t>(month) << kMonthValueBits) | month_value;
+    energy_months_dirty_ = true;
+  }
+
+  // The oldest day still held: slots from a full lap ago read as empty.
+  const int32_t lap_start = day - static_cast<int32_t>(kEnergyRingDays) + 1;
+  if (energy_first_day_ < 0 || day < energy_first_day_) energy_first_day_ = day;
+  if (energy_first_day_ < lap_start) energy_first_day_ = lap_start;
+}
+
+void TigoMonitorComponent::save_daily_energy_history() {
+  if (energy_dirty_chunks_ == 0 && !energy_months_dirty_) return;
+
+  // Staged in PSRAM (node_vector), like the node table: the month blob is
+  // nearly 1 KB, more than the loop task should carry on its stack.
+  node_vector<uint8_t> staging(std::max(sizeof(EnergyDayChunk), sizeof(EnergyMonthBlob)));
+  size_t staged = 0;
+  StateLock lock(state_mutex_);
+  for (uint8_t i = 0; i < kEnergyDayChunks; ++i) {
+    if (!(energy_dirty_chunks_ & (1u << i))) continue;
+    auto *chunk = reinterpret_cast<EnergyDayChunk *>(staging.data());
+    memset(chunk, 0, sizeof(EnergyDayChunk));
+    chunk->magic = kEnergyDaysMagic;
+    chunk->version = kEnergyStoreVersion;
+    chunk->index = i;
+    memcpy(chunk->days, &energy_days_[i * kEnergyChunkDays], sizeof(chunk->days));
+    char key[24];
+    uint32_t hash = energy_chunk_hash_(i, key);
+    this->persist_save_(hash, key, *chunk, kPersistTelemetryMs);
+    staged++;
+  }
+  energy_dirty_chunks_ = 0;
+
+  if (energy_months_dirty_) {
+    auto *blob = reinterpret_cast<EnergyMonthBlob *>(staging.data());
+    memset(blob, 0, sizeof(EnergyMonthBlob));
+    blob->magic = kEnergyMonthsMagic;
+    blob->version = kEnergyStoreVersion;
+    memcpy(blob->months, energy_months_.data(), sizeof(blob->months));
+    this->persist_save_(fnv1_hash(kMonthsKey), kMonthsKey, *blob, kPersistTelemetryMs);
+    energy_months_dirty_ = false;
+  }
+  ESP_LOGD(ENERGY_TAG, "Staged %zu daily energy chunk(s)", staged);
+}
+
+void TigoMonitorComponent::load_daily_energy_history() {
+  StateLock lock(state_mutex_);
+  energy_days_.assign(kEnergyRingDays, 0);
+  energy_months_.assign(kEnergyRingMonths, 0);
+  energy_first_day_ = -1;
+
+  node_vector<uint8_t> staging(std::max(sizeof(EnergyDayChunk), sizeof(EnergyMonthBlob)));
+  size_t chunks = 0, days = 0, rejected = 0;
+  for (uint8_t i = 0; i < kEnergyDayChunks; ++i) {
+    auto *chunk = reinterpret_cast<EnergyDayChunk *>(staging.data());
+    char key[24];
+    uint32_t hash = energy_chunk_hash_(i, key);
+    if (!this->persist_load_(hash, key, chunk)) continue;
+    if (chunk->magic != kEnergyDaysMagic || chunk->version != kEnergyStoreVersion || chunk->index != i) {
+      ESP_LOGW(ENERGY_TAG, "Ignoring daily energy chunk %u: bad header", (unsigned) i);
+      continue;
+    }
+    chunks++;
+    for (size_t j = 0; j < kEnergyChunkDays; ++j) {
+      const uint32_t rec = chunk->days[j];
+      if (rec == 0) continue;
+      const size_t slot = i * kEnergyChunkDays + j;
+      const int32_t day = static_cast<int32_t>(rec >> kDayValueBits);
+      if (static_cast<size_t>(day) % kEnergyRingDays != slot) {
+        rejected++;
+        continue;
+      }
+      energy_days_[slot] = rec;
+      days++;
+      if (energy_first_day_ < 0 || day < energy_first_day_) energy_first_day_ = day;
+    }
+  }
+
+  auto *blob = reinterpret_cast<EnergyMonthBlob *>(staging.data());
+  if (this->persist_load_(fnv1_hash(kMonthsKey), kMonthsKey, blob)) {
+    if (blob->magic == kEnergyMonthsMagic && blob->version == kEnergyStoreVersion) {
+      memcpy(energy_months_.data(), blob->months, sizeof(blob->months));
+    } else {
+      ESP_LOGW(ENERGY_TAG, "Ignoring monthly energy totals: bad header");
+    }
+  }
+
+  if (chunks == 0) {
+    if (load_daily_energy_legacy_()) save_daily_energy_history();
+    return;
+  }
+
+  // Records from a lap before the newest one are dead weight; a ring that
+  // has wrapped starts one lap back from the newest day.
+  int32_t newest = -1;
+  for (uint32_t rec : energy_days_)
+    if (rec != 0) newest = std::max(newest, static_cast<int32_t>(rec >> kDayValueBits));
+  const int32_t lap_start = newest - static_cast<int32_t>(kEnergyRingDays) + 1;
+  if (energy_first_day_ < lap_start) energy_first_day_ = lap_start;
+
+  if (rejected > 0) ESP_LOGW(ENERGY_TAG, "Dropped %zu misplaced daily energy record(s)", rejected);
+  ESP_LOGI(ENERGY_TAG, "Loaded %zu archived day(s) from %zu chunk(s), oldest %u", days, chunks,
+           energy_first_day_ < 0 ? 0u
+                                 : (unsigned) DailyEnergyData::from_day_number(energy_first_day_).to_key());
+}
+
+bool TigoMonitorComponent::load_daily_energy_legacy_() {
+  uint8_t buffer[kLegacyBytes] = {0};
+  const uint32_t hash = fnv1_hash(kLegacyKey);
+  if (!this->persist_load_(hash, kLegacyKey, &buffer)) return false;
+
+  const size_t count = buffer[0];
+  if (count == 0) return false;
+  if (count > kLegacyDays) {
+    ESP_LOGW(ENERGY_TAG, "Invalid legacy daily energy count: %zu (max=%zu)", count, kLegacyDays);
+    return false;
+  }
+  size_t migrated = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t key;
+    float energy;
+    memcpy(&key, &buffer[1 + i * 8], sizeof(key));
+    memcpy(&energy, &buffer[1 + i * 8 + 4], sizeof(energy));
+    if (DailyEnergyData::from_key(key).day_number() < 0) continue;
+    archive_daily_energy_(key, energy);
+    migrated++;
+  }
+
+  // Blank the old blob so the migration runs once; same commit as the chunks.
+  uint8_t empty[kLegacyBytes] = {0};
+  this->persist_save_(hash, kLegacyKey, empty, kPersistNowMs);
+  ESP_LOGI(ENERGY_TAG, "Migrated %zu day(s) from the 7-day energy history", migrated);
+  return migrated > 0;
+}
+
+node_vector<DailyEnergyData> TigoMonitorComponent::get_daily_energy_history(uint32_t from_key,
+                                                                            uint32_t to_key) const {
+  node_vector<DailyEnergyData> out;
+  int32_t from = DailyEnergyData::from_key(from_key).day_number();
+  const int32_t to = std::min(DailyEnergyData::from_key(to_key).day_number(), kDayNumberMax);
+  if (to < 0) return out;
+  from = std::max(from, std::max<int32_t>(0, to - static_cast<int32_t>(kEnergyRingDays) + 1));
+  if (from > to) return out;
+
+  out.reserve(static_cast<size_t>(to - from + 1));
+  StateLock lock(state_mutex_);
+  for (int32_t d = from; d <= to; ++d) {
+    DailyEnergyData entry = DailyEnergyData::from_day_number(static_cast<uint32_t>(d));
+    if (!energy_days_.empty()) entry.energy_kwh = day_value_(energy_days_, d) / 100.0f;
+    out.push_back(entry);
+  }
+  return out;
+}
+
+node_vector<DailyEnergyData> TigoMonitorComponent::get_monthly_energy_history(uint32_t from_key,
+                                                                              uint32_t to_key) const {
+  node_vector<DailyEnergyData> out;
+  int32_t from = month_number_(DailyEnergyData::from_key(from_key));
+  const int32_t to = std::min(month_number_(DailyEnergyData::from_key(to_key)), kMonthNumberMax);
+  if (to < 0) return out;
+  from = std::max(from, std::max<int32_t>(0, to - static_cast<int32_t>(kEnergyRingMonths) + 1));
+  if (from > to) return out;
+
+  out.reserve(static_cast<size_t>(to - from + 1));
+  StateLock lock(state_mutex_);
+  for (int32_t m = from; m <= to; ++m) {
+    DailyEnergyData entry = from_month_number_(m);
+    if (!energy_months_.empty()) entry.energy_kwh = month_value_(energy_months_, m) / 10.0f;
+    out.push_back(entry);
+  }
+  return out;
+}
+
+uint32_t TigoMonitorComponent::get_energy_history_first_key() const {
+  StateLock lock(state_mutex_);
+  if (energy_first_day_ < 0) return 0;
+  return DailyEnergyData::from_day_number(static_cast<uint32_t>(energy_first_day_)).to_key();
+}
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,124 @@
+#pragma once
+
+// Per-panel underperformance detection, run on every decoded power frame.
+//
+// A dirty, shaded or failing panel does not stop producing — it produces a
+// steady fraction of what its neighbours do, which the stale and
+// zero-production counts never see. This tracks, per panel, an exponentially
+// weighted ratio of its output power to a reference, and raises an alert once
+// that ratio has sat below `underperformance_threshold` for
+// `underperformance_duration`.
+//
+// The reference is the median output power of the panel's string over the
+// previous update interval (StringData::power_quartiles, tigo_quantile.h), or
+// of the whole array for a panel that belongs to no string or whose string
+// had fewer than kMinPeerPanels distinct panels reporting. Comparing against
+// the panel's own historical peak would be cheaper but is wrong every evening:
+// the sun alone takes every panel below any useful fraction of its peak. A
+// median of its peers falls with them. Below kMinReferenceW (dawn, dusk,
+// heavy overcast) ratios are dominated by measurement noise, so the state is
+// frozen rather than updated — an alert raised in the afternoon is still up
+// the next morning, and a sunrise never starts one.
+//
+// The EWMA uses a time-based weight, alpha = 1 - exp(-dt / tau), so a panel
+// that reports every 2 s and one that reports every 30 s converge equally
+// fast. Memory is one PanelHealth per device and the per-frame cost is
+// constant, so 500 panels cost 10 KB and no extra work per frame.
+//
+// Pure functions over plain structs: no ESPHome or IDF dependency, so the
+// state machine can be driven from a recorded frame sequence on the host
+// (tests/host/test_health.cpp).
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace tigo_monitor {
+
+// Reference power below which a ratio is not trusted (W).
+static constexpr float kMinReferenceW = 20.0f;
+// Distinct panels a window needs before its median is used as a reference.
+static constexpr uint16_t kMinPeerPanels = 3;
+// EWMA time constant. Long enough that a passing cloud edge over one panel
+// does not move it much, short enough that the hold timer, not the filter,
+// dominates how quickly an alert is raised.
+static constexpr float kHealthTauS = 300.0f;
+// The alert clears only once the ratio is this far back above the threshold,
+// so a panel hovering at the threshold does not flap.
+static constexpr float kHealthHysteresis = 0.05f;
+// Defaults for `underperformance_threshold` / `underperformance_duration`.
+static constexpr float kDefaultUnderperformanceThreshold = 0.7f;
+static constexpr uint32_t kDefaultUnderperformanceHoldMs = 30UL * 60UL * 1000UL;
+
+enum class HealthReference : uint8_t { NONE = 0, STRING = 1, ARRAY = 2 };
+
+struct PanelHealth {
+  float ratio = NAN;            // EWMA of power_out / reference; NaN until first trusted frame
+  uint32_t last_ms = 0;         // millis() of the last frame folded into ratio
+  uint32_t below_since_ms = 0;  // millis() the ratio first went below threshold
+  uint32_t alert_since_ms = 0;  // millis() the alert was raised
+  bool below = false;
+  bool alerting = false;
+  HealthReference reference = HealthReference::NONE;
+};
+
+struct HealthParams {
+  float threshold = kDefaultUnderperformanceThreshold;
+  uint32_t hold_ms = kDefaultUnderperformanceHoldMs;
+};
+
+// Folds one frame into h. reference_w is the string (or array) median output
+// power, NaN when unknown. Returns true when h.alerting changed.
+inline bool update_panel_health(PanelHealth &h, const HealthParams &params, uint32_t now_ms,
+                                float power_w, float reference_w, HealthReference source) {
+  if (std::isnan(power_w) || std::isnan(reference_w) || reference_w < kMinReferenceW) {
+    // Freeze. Restart the EWMA clock so the night is not one huge step, and
+    // the hold timer so hours of darkness do not count toward an alert.
+    h.last_ms = 0;
+    h.below = false;
+    return false;
+  }
+
+  float x = power_w / reference_w;
+  if (x < 0.0f) x = 0.0f;
+  if (x > 2.0f) x = 2.0f;  // one frame from a panel in full sun among shaded ones
+  if (std::isnan(h.ratio)) {
+    h.ratio = x;
+  } else if (h.last_ms != 0) {
+    float dt_s = (float) (now_ms - h.last_ms) / 1000.0f;
+    float alpha = 1.0f - expf(-dt_s / kHealthTauS);
+    h.ratio += alpha * (x - h.ratio);
+  }
+  h.last_ms = now_ms;
+  h.reference = source;
+
+  bool was_alerting = h.alerting;
+  if (h.ratio < params.threshold) {
+    if (!h.below) {
+      h.below = true;
+      h.below_since_ms = now_ms;
+    }
+    if (!h.alerting && now_ms - h.below_since_ms >= params.hold_ms) {
+      h.alerting = true;
+      h.alert_since_ms = now_ms;
+    }
+  } else {
+    h.below = false;
+    if (h.alerting && h.ratio >= params.threshold + kHealthHysteresis) h.alerting = false;
+  }
+  return h.alerting != was_alerting;
+}
+
+inline const char *health_reference_str(HealthReference r) {
+  switch (r) {
+    case HealthReference::STRING:
+      return "string";
+    case HealthReference::ARRAY:
+      return "array";
+    default:
+      return "none";
+  }
+}
+
+}  // namespace tigo_monitor
+}  // namespace esphome
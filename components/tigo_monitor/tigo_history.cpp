@@ -6,13 +6,19 @@
 
 #include "esp_timer.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <climits>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <unistd.h>  // fsync, fileno
 
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
 namespace esphome {
 namespace tigo_monitor {
 
@@ -35,7 +41,10 @@ static const char *const TAG = "tigo_history";
 // letting a genuinely stuck holder hang the endpoint for long.
 //
 // The real fix is a deferred-sync write path in esp_tsdb so a commit stops
-// costing 21 s at all; this only stops the symptom being a failure.
+// costing 21 s at all; this only stops the symptom being a failure. The writer
+// now also commits in phases and lets waiters in between them, so a reader
+// waits out one phase (~5 s) rather than the whole commit, and this bound is
+// only reached behind other readers.
 static constexpr uint32_t kFsLockReaderWaitMs = 30000;
 
 // A null handle means the lock does not exist yet (pre-init, single-threaded)
@@ -44,7 +53,21 @@ TigoHistory::FlashLock::FlashLock(TigoHistory *hist, uint32_t timeout_ms)
     : mutex_(hist != nullptr ? hist->fs_mutex_ : nullptr) {
   const TickType_t wait =
       (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+  // Everyone but the writer registers as waiting, so the writer can step
+  // aside between commit phases (yield_to_flash_waiters_).
+  const bool counted = mutex_ != nullptr && xTaskGetCurrentTaskHandle() != hist->task_;
+  if (counted) hist->flash_waiters_.fetch_add(1, std::memory_order_relaxed);
   held_ = (mutex_ == nullptr) || (xSemaphoreTakeRecursive(mutex_, wait) == pdTRUE);
+  if (counted) hist->flash_waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Called by the writer between commit phases, lock released. A waiter that is
+// ready but has not been scheduled yet would otherwise lose the race to the
+// writer retaking the lock straight away. Bounded: a waiter blocked on
+// something else must not stall the commit.
+void TigoHistory::yield_to_flash_waiters_() {
+  for (int i = 0; i < 50 && flash_waiters_.load(std::memory_order_relaxed) > 0; ++i)
+    vTaskDelay(pdMS_TO_TICKS(10));
 }
 
 TigoHistory::FlashLock::~FlashLock() {
@@ -53,13 +76,115 @@ TigoHistory::FlashLock::~FlashLock() {
 
 // Encoded row pushed onto the writer queue. Layout matches the schemas below:
 // — system_values mirror kSystemParamNames (14 entries)
-// — panel_values is laid out as [panel_db_0 first 16][panel_db_1 next 16]
+// — panel_values is laid out family-major: power's kMaxPanelSlots values
+//   first, then each enabled metric's. Within a family,
+//   [panel_db_0 first 16][panel_db_1 next 16]..., one 16-slot segment per
+//   panel DB (kNumPanelDbs of them)
+// — series_values are the strings.tsdb and inverters.tsdb rows, by column
 struct EncodedRow {
   uint32_t timestamp;
   int16_t system_values[14];
-  int16_t panel_values[kMaxPanelSlots];
+  int16_t panel_values[kNumPanelFamilies * kMaxPanelSlots];
+  int16_t series_values[kNumSeriesGroups][kSeriesDbColumns];
+  bool panels_valid;  // see SystemSnapshot::panels_valid
+};
+
+// Queue markers, never real snapshot times (those are ~2e9 until 2106).
+static constexpr uint32_t kWriterStopTs = 0xFFFFFFFFu;   // flush_and_close
+static constexpr uint32_t kWriterFlushTs = 0xFFFFFFFEu;  // flush_pending
+
+// Write-behind cache of the newest rows (see recent_rows_ in the header),
+// sized by start_writer_task to hold kRecentCoverS of rows at the configured
+// history_interval, plus the rows a group commit holds back before they reach
+// the ring. Never fewer than kRecentRowMin: ~6.5 days at the 30-min default
+// and a full day at 5 min. A row is ~100 B (system, strings, inverters) plus
+// 32 B per panel DB and family: ~63 KB of PSRAM for 320 rows at three DBs of
+// power alone, ~185 KB with every metric family enabled.
+//
+// Group commit lets history_interval go down to 1 min, where a day is 1,440
+// rows. kRecentRowMaxBytes bounds what that may take; past it the ring covers
+// less than a day, start_writer_task logs how much, and the part of a day
+// chart before the ring reads flash again. Power alone at three DBs fits a
+// 1-min day; with every metric family enabled, ~15 h does.
+static constexpr uint32_t kRecentCoverS = 24 * 3600;
+static constexpr size_t kRecentRowMin = 320;
+static constexpr size_t kRecentRowMaxBytes = 512 * 1024;
+
+// Which of a row's writes reached flash. A query served from RAM must see
+// exactly what the same query against flash would, so a DB whose write failed
+// (or was skipped because the slot map was not loaded) has no row here either.
+static constexpr uint64_t kRecentSystem = 1u << 0;
+static constexpr uint64_t kRecentPanelDb(size_t family, size_t idx) {
+  return 1ULL << (1 + family * kNumPanelDbs + idx);
+}
+// The series DBs take the top bits, clear of any panel layout.
+static constexpr uint64_t kRecentSeries(size_t group) { return 1ULL << (62 + group); }
+static_assert(1 + kNumPanelFamilies * kNumPanelDbs <= 62, "RecentRow::written has one bit per panel DB");
+
+struct RecentRow {
+  EncodedRow row;
+  uint64_t written;
+};
+
+// Per-metric storage: the `metric=`/YAML name, the int16 scale, the unit and
+// the file stem. Power keeps the original panels<N>.tsdb names.
+struct PanelMetricInfo {
+  const char *name;
+  float scale;
+  const char *unit;
+  const char *file_stem;
+};
+static constexpr PanelMetricInfo kPanelMetricInfo[kPanelMetricCount] = {
+    {"power", 1.0f, "W", "panels"},
+    {"vin", 100.0f, "V", "panels_vin"},     // 327 V ceiling; optimizer inputs sit well under 100
+    {"vout", 100.0f, "V", "panels_vout"},
+    {"temp", 10.0f, "C", "panels_temp"},
+    {"rssi", 1.0f, "dBm", "panels_rssi"},
 };
 
+const char *panel_metric_str(PanelMetric m) { return m < kPanelMetricCount ? kPanelMetricInfo[m].name : "?"; }
+float panel_metric_scale(PanelMetric m) { return m < kPanelMetricCount ? kPanelMetricInfo[m].scale : 1.0f; }
+const char *panel_metric_unit(PanelMetric m) { return m < kPanelMetricCount ? kPanelMetricInfo[m].unit : ""; }
+bool parse_panel_metric(const char *s, PanelMetric &out) {
+  for (uint8_t i = 0; i < kPanelMetricCount; ++i) {
+    if (strcmp(s, kPanelMetricInfo[i].name) == 0) {
+      out = (PanelMetric) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Per-group storage for the string and inverter series. An inverter's
+// columns are (power, energy) pairs, so it holds half as many series.
+struct SeriesGroupInfo {
+  const char *name;
+  const char *db_path;
+  const char *map_path;
+  size_t capacity;
+  size_t cols_per_series;
+};
+static constexpr SeriesGroupInfo kSeriesGroupInfo[kNumSeriesGroups] = {
+    {"string", "/tsdb/strings.tsdb", "/tsdb/string_map.json", kMaxStringSeries, 1},
+    {"inverter", "/tsdb/inverters.tsdb", "/tsdb/inverter_map.json", kMaxInverterSeries, 2},
+};
+static_assert(kMaxStringSeries * 1 <= kSeriesDbColumns && kMaxInverterSeries * 2 <= kSeriesDbColumns,
+              "series columns must fit one DB");
+
+const char *series_group_str(SeriesGroup group) {
+  return group < kNumSeriesGroups ? kSeriesGroupInfo[group].name : "?";
+}
+size_t series_group_capacity(SeriesGroup group) {
+  return group < kNumSeriesGroups ? kSeriesGroupInfo[group].capacity : 0;
+}
+
+// Slots [idx*16, idx*16+16) — the ones panel DB `idx` holds.
+static PanelSlotMask panel_db_slots_(size_t idx) {
+  PanelSlotMask m;
+  for (size_t c = 0; c < kPanelsPerDb; ++c) m.set(idx * kPanelsPerDb + c);
+  return m;
+}
+
 // Encoders — clamp to int16 range to avoid silent wraparound on runaway sensors.
 static int16_t enc_clamp_(float v) {
   if (std::isnan(v)) return 0;
@@ -94,25 +219,103 @@ static const char *kPanelParamNames[kPanelsPerDb] = {
     "p08", "p09", "p10", "p11", "p12", "p13", "p14", "p15",
 };
 
+// strings.tsdb: column n is the string string_map.json gives column n.
+// inverters.tsdb: inverter n is columns 2n (power, W) and 2n+1 (energy since
+// the previous row, kWh ×100, like system.tsdb's inv*_e).
+static const char *kStringParamNames[kSeriesDbColumns] = {
+    "s00", "s01", "s02", "s03", "s04", "s05", "s06", "s07",
+    "s08", "s09", "s10", "s11", "s12", "s13", "s14", "s15",
+};
+static const char *kInverterParamNames[kSeriesDbColumns] = {
+    "i0_p", "i0_e", "i1_p", "i1_e", "i2_p", "i2_e", "i3_p", "i3_e",
+    "i4_p", "i4_e", "i5_p", "i5_e", "i6_p", "i6_e", "i7_p", "i7_e",
+};
+
 // IMPORTANT: LittleFS is copy-on-write — to commit a header write or its
 // block-allocation journal it must write the new copy to a FREE block before
 // freeing the old. If the partition is near-full it cannot commit, so writes
 // stop persisting (headers read back garbage, records vanish on reboot) and the
 // FS spirals to 100% with uncollectable orphans. So the tsdb files must leave
-// LittleFS generous headroom — target ≲55% of the 3 MB partition for file data.
+// LittleFS generous headroom — target ≲55% of the partition for file data.
 //
-// system 1 MB + 3 × 192 KB panels = 1.6 MB of 3 MB (~52%), leaving ~1.4 MB for
-// LittleFS metadata, COW scratch, and GC. (Was 2 MB + 3×256 KB ≈ 98% full, which
-// starved LittleFS and broke persistence entirely.)
-static constexpr size_t kSystemFileBytes = 1 * 1024 * 1024;
-
-// 192 KB per panel DB × 3 = 576 KB. At 36 B/record (16×2-byte params + 4-byte
-// ts) that's ~5400 records per DB — ~112 days at the default 30-min cadence,
-// scaling linearly with `history_interval`.
-static constexpr size_t kPanelFileBytes = 192 * 1024;
+// The sizes below are the reference layout, tuned by hand for the 3 MB `tsdb`
+// partition of tigo-8mb.csv: system 832 KB + 576 KB of panels + 192 KB of
+// string and inverter series + 80 KB of rollups = 1,680 KB of 3,072 KB (~55%),
+// leaving ~1.4 MB for LittleFS metadata, COW scratch, and GC. The slot maps,
+// trend state and journal marker add a few KB more. (Was 2 MB + 3×256 KB ≈ 98%
+// full, which starved LittleFS and broke persistence entirely.) init() scales
+// every file by the real partition over this one (plan_file_sizes_), so
+// tigo-16mb.csv's 8 MB gets ~2.7x the retention at the same fill, and a smaller
+// partition shrinks rather than overfills.
+static constexpr size_t kRefPartitionBytes = 3 * 1024 * 1024;
+// Was 1 MB; the string and inverter DBs below took 192 KB of it, keeping the
+// file total where the headroom rule put it. At 32 B/record that is ~26,600
+// snapshots, ~1.5 years at 30 min — and the hourly/daily rollups, not the raw
+// ring, are what serve ranges that long.
+static constexpr size_t kRefSystemFileBytes = 832 * 1024;
+
+// The panel DBs split one 576 KB budget, whatever `history_panel_dbs` is, so a
+// larger array does not push the partition past the headroom above. Up to
+// three DBs each get the full 192 KB — the original layout, unchanged for
+// existing installs. At 36 B/record (16×2-byte params + 4-byte ts) that's
+// ~5400 records per DB, ~112 days at the default 30-min cadence; at eight DBs,
+// 72 KB and ~42 days. Either scales linearly with `history_interval`.
+//
+// Extra metric families (history_panel_metrics) come out of the same budget
+// rather than on top of it: power weighs three shares and each extra family
+// one. One extra leaves power 432 KB and gives the metric 144 KB; all four,
+// ~246 KB and ~82 KB each.
+static constexpr size_t kRefPanelBudgetBytes = 576 * 1024;
+static constexpr size_t kRefPanelFileBytes = 192 * 1024;
+static constexpr size_t kPowerBudgetShares = 3;
+
+// Rollup tiers (see HistoryTier). Four columns per bucket; energy is stored
+// kWh x100 hourly like the raw rows, but x10 daily so a large array's best day
+// (>327 kWh) does not clamp. 12 B/record:
+//   hourly  64 KB -> ~5,300 buckets, ~220 days — covers every month-range query
+//   daily   16 KB -> ~1,200 buckets, ~3.3 years
+// 80 KB together, which brings the file data to the ~55% counted above.
+// Ranges older than a tier's first bucket are folded from raw rows at query
+// time, so an install upgrading with months of raw history loses nothing.
+static constexpr size_t kRefRollupFileBytes[kNumRollupTiers] = {64 * 1024, 16 * 1024};
+
+// String and inverter series, 36 B/record like a panel DB:
+//   strings    128 KB -> ~3,600 records, ~75 days at 30 min
+//   inverters   64 KB -> ~1,800 records, ~37 days
+// The long view of an inverter is system.tsdb's inv* columns for the first
+// four; these are for the comparison charts, which look back weeks.
+static constexpr size_t kRefSeriesFileBytes[kNumSeriesGroups] = {128 * 1024, 64 * 1024};
+
+// Scaled files are rounded down to the 4 KB LittleFS block, and never below
+// two blocks: the esp_tsdb header alone is 2 KB.
+static constexpr size_t kFsBlockBytes = 4096;
+static constexpr size_t kMinFileBytes = 2 * kFsBlockBytes;
+static const char *const kRollupPaths[kNumRollupTiers] = {"/tsdb/hourly.tsdb", "/tsdb/daily.tsdb"};
+static constexpr float kRollupEnergyScale[kNumRollupTiers] = {100.0f, 10.0f};
+static const char *kRollupParamNames[] = {"p_min", "p_avg", "p_max", "e"};
+static constexpr size_t kRollupNumParams =
+    sizeof(kRollupParamNames) / sizeof(kRollupParamNames[0]);
 
 static constexpr const char *kPanelMapPath = "/tsdb/panel_map.json";
 
+// Degradation trend state, one PanelTrend per slot (tigo_trend.h). Binary, not
+// JSON like the slot map: each slot is one fixed-size struct of doubles that
+// only this firmware reads, and a CRC tells a torn write from a good one.
+static constexpr const char *kPanelTrendPath = "/tsdb/panel_trend.bin";
+static constexpr uint32_t kPanelTrendMagic = 0x52544754;  // "TGTR"
+static constexpr uint16_t kPanelTrendVersion = 1;
+// The trend moves on a scale of months, so losing a few hours of it to an
+// unclean reboot costs nothing; rewriting it every snapshot would. Saved from
+// the writer's batch at most this often.
+static constexpr uint32_t kTrendSaveIntervalS = 6 * 3600;
+
+struct PanelTrendHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;     // slots stored (kMaxPanelSlots at write time)
+  uint32_t crc;       // esp_rom_crc32_le over the PanelTrend array
+};
+
 // Marker file rewritten after each snapshot to force a LittleFS journal commit
 // (see commit_journal_). Tiny, single block, wear-levelled.
 static constexpr const char *kJournalMarkerPath = "/tsdb/.jcommit";
@@ -132,8 +335,13 @@ bool TigoHistory::init() {
 
   if (!mount_filesystem_())
     return false;
+  plan_file_sizes_();
   if (!init_system_db_())
     return false;
+  // Rollups are an optimisation: a DB that will not open leaves its tier out
+  // of pick_tier() and queries read raw rows as before.
+  if (init_rollup_dbs_())
+    rebuild_rollups_();
   // Panel DBs are opened lazily — load_slot_map_() will open any DBs
   // referenced by previously-saved slot assignments, and get_or_assign_slot()
   // opens new ones as panels appear. Empty installs commit zero panel-DB
@@ -144,12 +352,32 @@ bool TigoHistory::init() {
     for (auto &b : slot_to_barcode_) b.clear();
     next_free_slot_ = 0;
   }
-  initialized_ = true;
+  for (size_t g = 0; g < kNumSeriesGroups; ++g) load_series_map_((SeriesGroup) g);
+  load_trends_();
+  state_.store(STATE_READY, std::memory_order_release);
 
   // Populate the snapshot before anything can serve it, so /api/tsdb/stats
   // has real numbers from boot rather than an empty table until the first
   // scheduled commit. Still inside this function's FlashLock.
   refresh_stats_snapshot_();
+
+  // The ring starts empty, so it can only vouch for time after the newest row
+  // already on flash. Until a query's window starts past that, it reads flash.
+  uint32_t floor_ts = 0;
+  {
+    std::lock_guard<std::mutex> guard(stats_mutex_);
+    auto newest = [&](const StatsSnapshot::Db &db) {
+      if (db.available && db.stats.total_records > 0) floor_ts = std::max(floor_ts, db.stats.newest_timestamp);
+    };
+    newest(stats_snapshot_.system);
+    for (const auto &family : stats_snapshot_.panels) {
+      for (const auto &db : family) newest(db);
+    }
+    for (const auto &db : stats_snapshot_.series) newest(db);
+  }
+  newest_commit_ts_.store(floor_ts);
+  std::lock_guard<std::mutex> guard(recent_mutex_);
+  recent_floor_ts_ = floor_ts;
   return true;
 }
 
@@ -203,12 +431,59 @@ void TigoHistory::commit_journal_() {
   fclose(f);
 }
 
+// Scales the reference layout to the `tsdb` partition actually flashed. The
+// reference sits at the ~55% fill the headroom rule allows, so scaling every
+// file by the same factor keeps any partition at that fill. A 3 MB partition
+// gets the reference sizes exactly.
+//
+// Only a newly created file takes these: esp_tsdb writes max_records into the
+// file header at creation and keeps it, so an existing DB goes on at the
+// capacity it was made with until it is deleted. /api/tsdb/stats reports the
+// header's figure, which is the one retention follows.
+void TigoHistory::plan_file_sizes_() {
+  size_t partition = kRefPartitionBytes;
+  const esp_partition_t *part =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "tsdb");
+  if (part != nullptr) {
+    partition = part->size;
+  } else {
+    ESP_LOGW(TAG, "tsdb partition not found — sizing files for %zu KB", kRefPartitionBytes / 1024);
+  }
+
+  auto scale = [partition](size_t ref_bytes) {
+    const uint64_t b = (uint64_t) ref_bytes * partition / kRefPartitionBytes / kFsBlockBytes * kFsBlockBytes;
+    return std::max<size_t>((size_t) b, kMinFileBytes);
+  };
+  sizes_.partition = partition;
+  sizes_.system = scale(kRefSystemFileBytes);
+  // Split the panel budget before scaling so the per-DB cap and the budget
+  // round the same way at every partition size.
+  const size_t shares = kPowerBudgetShares + (kNumPanelFamilies - 1);
+  const size_t power_budget = kRefPanelBudgetBytes * kPowerBudgetShares / shares;
+  sizes_.panel = scale(std::min(kRefPanelFileBytes, power_budget / kNumPanelDbs));
+  sizes_.metric = kNumPanelFamilies > 1 ? scale(kRefPanelBudgetBytes / shares / kNumPanelDbs) : 0;
+  for (size_t t = 0; t < kNumRollupTiers; ++t) sizes_.rollup[t] = scale(kRefRollupFileBytes[t]);
+  for (size_t g = 0; g < kNumSeriesGroups; ++g) sizes_.series[g] = scale(kRefSeriesFileBytes[g]);
+
+  const size_t total = sizes_.system + kNumPanelDbs * (sizes_.panel + (kNumPanelFamilies - 1) * sizes_.metric) +
+                       sizes_.rollup[0] + sizes_.rollup[1] + sizes_.series[0] + sizes_.series[1];
+  ESP_LOGI(TAG, "tsdb sizing for a %zu KB partition: system %zu KB, %zu x panels %zu KB, %zu x metrics %zu KB, "
+           "hourly %zu KB, daily %zu KB, strings %zu KB, inverters %zu KB (%.0f%% at capacity)",
+           partition / 1024, sizes_.system / 1024, kNumPanelDbs, sizes_.panel / 1024,
+           kNumPanelDbs * (kNumPanelFamilies - 1), sizes_.metric / 1024, sizes_.rollup[0] / 1024,
+           sizes_.rollup[1] / 1024, sizes_.series[0] / 1024, sizes_.series[1] / 1024, 100.0f * total / partition);
+  if (total * 100 > partition * 60) {
+    // Only reachable through the kMinFileBytes floor on a tiny partition.
+    ESP_LOGW(TAG, "tsdb partition too small for the LittleFS headroom rule — history may not persist");
+  }
+}
+
 bool TigoHistory::init_system_db_() {
   tsdb_config_t cfg = {};
   cfg.filepath = "/tsdb/system.tsdb";
   cfg.num_params = kSystemNumParams;
   cfg.param_names = kSystemParamNames;
-  cfg.max_records = TSDB_CALC_MAX_RECORDS(kSystemFileBytes, kSystemNumParams);
+  cfg.max_records = TSDB_CALC_MAX_RECORDS(sizes_.system, kSystemNumParams);
   cfg.index_stride = 380;
   cfg.buffer_pool_size = 10 * 1024;
   // PSRAM-backed buffer pool. The S3-PICO-1 has 8 MB octal PSRAM — internal
@@ -231,70 +506,85 @@ bool TigoHistory::init_system_db_() {
 
 bool TigoHistory::open_panel_db_(size_t idx) {
   if (idx >= kNumPanelDbs) return false;
-  if (panel_db_[idx] != nullptr) return true;  // already open
+  // A metric family that fails to open only loses that metric; power decides.
+  bool ok = true;
+  for (size_t f = 0; f < kNumPanelFamilies; ++f) {
+    if (panel_db_[f][idx] != nullptr) continue;  // already open
+    const bool opened = open_panel_family_db_(f, idx);
+    if (f == 0) ok = opened;
+  }
+  return ok;
+}
 
+bool TigoHistory::open_panel_family_db_(size_t family, size_t idx) {
+  const PanelMetricInfo &info = kPanelMetricInfo[panel_family_metric(family)];
+  const size_t file_bytes = family == 0 ? sizes_.panel : sizes_.metric;
   char path[32];
-  std::snprintf(path, sizeof(path), "/tsdb/panels%zu.tsdb", idx);
+  std::snprintf(path, sizeof(path), "/tsdb/%s%zu.tsdb", info.file_stem, idx);
 
   tsdb_config_t cfg = {};
   cfg.filepath = path;
   cfg.num_params = kPanelsPerDb;
   cfg.param_names = kPanelParamNames;
-  cfg.max_records = TSDB_CALC_MAX_RECORDS(kPanelFileBytes, kPanelsPerDb);
+  cfg.max_records = TSDB_CALC_MAX_RECORDS(file_bytes, kPanelsPerDb);
   cfg.index_stride = 380;
   // Smaller pool than system db — each panel DB is ~3.5x smaller and reads
   // are rare (one column at a time). 6 KB covers read+write+query buffers.
   cfg.buffer_pool_size = 6 * 1024;
-  // PSRAM-backed (see init_system_db_ for rationale). With 3 panel DBs at
-  // 6 KB each, this saves ~18 KB of internal RAM vs. the default.
+  // PSRAM-backed (see init_system_db_ for rationale). At 6 KB per panel DB,
+  // this saves ~18 KB of internal RAM vs. the default with three, ~48 KB with
+  // eight.
   cfg.alloc_strategy = TSDB_ALLOC_PSRAM;
   cfg.use_paged_allocation = false;
   cfg.page_size = 0;
 
-  panel_db_[idx] = tsdb_open(&cfg);
-  if (panel_db_[idx] == nullptr) {
+  panel_db_[family][idx] = tsdb_open(&cfg);
+  if (panel_db_[family][idx] == nullptr) {
     ESP_LOGE(TAG, "tsdb_open for %s failed", path);
     return false;
   }
-  ESP_LOGI(TAG, "tsdb opened: %s (%zu panels, capacity ~%lu records)", path,
-           kPanelsPerDb, (unsigned long) cfg.max_records);
+  ESP_LOGI(TAG, "tsdb opened: %s (%zu panels, %zu KB, capacity ~%lu records)", path,
+           kPanelsPerDb, file_bytes / 1024, (unsigned long) cfg.max_records);
   return true;
 }
 
 // Tiny hand-rolled JSON for the slot map — avoids pulling in a parser for
 // what's ultimately a flat list of 6-char keys to uint8 values. Format:
 //   {"slots":[{"b":"abc123","s":0},{"b":"def456","s":1}]}
-// Reads tolerate trailing commas and whitespace between tokens.
-bool TigoHistory::load_slot_map_() {
-  slot_map_.clear();
-  for (auto &b : slot_to_barcode_) b.clear();
-  next_free_slot_ = 0;
-
-  FILE *f = fopen(kPanelMapPath, "rb");
+// Reads tolerate trailing commas and whitespace between tokens. The string
+// and inverter maps use the same format with labels for keys, which is why
+// get_or_assign_series refuses a label with a quote or backslash in it.
+//
+// Reads `path` whole into `buf`. False if it is absent, empty or unreadable;
+// a missing file is the normal first-boot case and is only logged at INFO.
+static bool read_map_file_(const char *path, std::string &buf) {
+  FILE *f = fopen(path, "rb");
   if (f == nullptr) {
-    ESP_LOGI(TAG, "panel_map.json absent — starting empty");
-    return true;
+    ESP_LOGI(TAG, "%s absent — starting empty", path);
+    return false;
   }
 
   fseek(f, 0, SEEK_END);
   long size = ftell(f);
   fseek(f, 0, SEEK_SET);
   if (size <= 0 || size > 8192) {
-    ESP_LOGW(TAG, "panel_map.json size out of bounds: %ld", size);
+    ESP_LOGW(TAG, "%s size out of bounds: %ld", path, size);
     fclose(f);
-    return true;  // Fresh start
+    return false;  // Fresh start
   }
 
-  std::string buf;
   buf.resize((size_t) size);
   size_t read = fread(buf.data(), 1, (size_t) size, f);
   fclose(f);
   if (read != (size_t) size) {
-    ESP_LOGW(TAG, "panel_map.json short read");
-    return true;
+    ESP_LOGW(TAG, "%s short read", path);
+    return false;
   }
+  return true;
+}
 
-  // Parse {"b":"xxxxxx","s":N} pairs.
+// Calls fn(key, index) for each {"b":"key","s":N} pair in `buf`.
+template<typename Fn> static void parse_map_entries_(const std::string &buf, Fn &&fn) {
   size_t pos = 0;
   while (pos < buf.size()) {
     size_t b_open = buf.find("\"b\"", pos);
@@ -303,22 +593,78 @@ bool TigoHistory::load_slot_map_() {
     if (q1 == std::string::npos) break;
     size_t q2 = buf.find('"', q1 + 1);
     if (q2 == std::string::npos) break;
-    std::string barcode = buf.substr(q1 + 1, q2 - q1 - 1);
+    std::string key = buf.substr(q1 + 1, q2 - q1 - 1);
 
     size_t s_open = buf.find("\"s\"", q2);
     if (s_open == std::string::npos) break;
     size_t colon = buf.find(':', s_open);
     if (colon == std::string::npos) break;
-    int slot_int = -1;
-    if (std::sscanf(buf.c_str() + colon + 1, " %d", &slot_int) != 1) break;
+    int index = -1;
+    if (std::sscanf(buf.c_str() + colon + 1, " %d", &index) != 1) break;
+
+    if (!key.empty()) fn(key, index);
+    pos = colon + 1;
+  }
+}
+
+// Writes keys[0..n) as a map file, skipping empty (unassigned) entries.
+//
+// Write directly to the destination. We tried temp-file + rename, but the
+// joltwallet LittleFS port we depend on returns EEXIST on rename when the
+// destination already exists (POSIX semantics expect clobber). Direct
+// write is good enough here:
+//  - LittleFS metadata updates are atomic at the block level, so a
+//    concurrent reader sees either the old or the new file, never a mix.
+//  - On power loss mid-write the file may end up truncated; the load path
+//    already tolerates partial JSON and falls back to the entries it could
+//    parse (worst case: a few panels get re-assigned to fresh slots,
+//    splitting their history — much better than no persistence at all).
+static bool write_map_file_(const char *path, const std::string *keys, size_t n) {
+  FILE *f = fopen(path, "wb");
+  if (f == nullptr) {
+    ESP_LOGE(TAG, "Failed to open %s for write", path);
+    return false;
+  }
+
+  fputs("{\"slots\":[", f);
+  bool first = true;
+  for (size_t i = 0; i < n; ++i) {
+    if (keys[i].empty()) continue;
+    if (!first) fputc(',', f);
+    first = false;
+    std::fprintf(f, "{\"b\":\"%s\",\"s\":%u}", keys[i].c_str(), (unsigned) i);
+  }
+  fputs("]}\n", f);
+  fflush(f);
+  fsync(fileno(f));
+  fclose(f);
+  return true;
+}
 
-    if (!barcode.empty() && slot_int >= 0 && slot_int < (int) kMaxPanelSlots) {
+bool TigoHistory::load_slot_map_() {
+  slot_map_.clear();
+  for (auto &b : slot_to_barcode_) b.clear();
+  next_free_slot_ = 0;
+
+  std::string buf;
+  if (!read_map_file_(kPanelMapPath, buf)) return true;  // Fresh start
+
+  size_t dropped = 0;
+  parse_map_entries_(buf, [&](const std::string &barcode, int slot_int) {
+    if (slot_int >= 0 && slot_int < (int) kMaxPanelSlots) {
       uint8_t slot = (uint8_t) slot_int;
       slot_map_[barcode] = slot;
       slot_to_barcode_[slot] = barcode;
       if (slot >= next_free_slot_) next_free_slot_ = slot + 1;
+    } else if (slot_int >= (int) kMaxPanelSlots) {
+      dropped++;
     }
-    pos = colon + 1;
+  });
+  if (dropped > 0) {
+    // history_panel_dbs was lowered. Those panels get fresh slots if any are
+    // free; their old history stays in a panel file nothing opens any more.
+    ESP_LOGW(TAG, "%zu saved panel slot(s) lie past slot %zu (history_panel_dbs = %zu) and were dropped",
+             dropped, kMaxPanelSlots - 1, kNumPanelDbs);
   }
 
   ESP_LOGI(TAG, "Loaded %zu panel slot mappings from %s (next_free=%u)",
@@ -334,41 +680,128 @@ bool TigoHistory::load_slot_map_() {
   return true;
 }
 
-bool TigoHistory::save_slot_map_() {
-  // Write directly to the destination. We tried temp-file + rename, but the
-  // joltwallet LittleFS port we depend on returns EEXIST on rename when the
-  // destination already exists (POSIX semantics expect clobber). Direct
-  // write is good enough here:
-  //  - LittleFS metadata updates are atomic at the block level, so a
-  //    concurrent reader sees either the old or the new file, never a mix.
-  //  - On power loss mid-write the file may end up truncated; the load path
-  //    already tolerates partial JSON and falls back to the entries it could
-  //    parse (worst case: a few panels get re-assigned to fresh slots,
-  //    splitting their history — much better than no persistence at all).
-  FILE *f = fopen(kPanelMapPath, "wb");
+bool TigoHistory::save_slot_map_() { return write_map_file_(kPanelMapPath, slot_to_barcode_, kMaxPanelSlots); }
+
+bool TigoHistory::load_series_map_(SeriesGroup group) {
+  const SeriesGroupInfo &info = kSeriesGroupInfo[group];
+  SeriesMap loaded;
+  std::string buf;
+  if (read_map_file_(info.map_path, buf)) {
+    parse_map_entries_(buf, [&](const std::string &label, int col) {
+      if (col < 0 || col >= (int) info.capacity) return;
+      loaded.columns[label] = (uint8_t) col;
+      loaded.labels[col] = label;
+      if (col >= loaded.next_free) loaded.next_free = (uint8_t) (col + 1);
+    });
+    ESP_LOGI(TAG, "Loaded %zu %s column mappings from %s", loaded.columns.size(), info.name, info.map_path);
+  }
+  const bool any = !loaded.columns.empty();
+  {
+    std::lock_guard<std::mutex> guard(series_mutex_);
+    series_maps_[group] = std::move(loaded);
+  }
+  // As with the panel DBs: open now if anything is mapped, so a query for a
+  // known label does not have to wait for the next snapshot.
+  if (any) open_series_db_(group);
+  return true;
+}
+
+bool TigoHistory::save_series_map_(SeriesGroup group) {
+  std::string labels[kSeriesDbColumns];
+  {
+    std::lock_guard<std::mutex> guard(series_mutex_);
+    for (size_t c = 0; c < kSeriesDbColumns; ++c) labels[c] = series_maps_[group].labels[c];
+  }
+  return write_map_file_(kSeriesGroupInfo[group].map_path, labels, kSeriesDbColumns);
+}
+
+bool TigoHistory::open_series_db_(SeriesGroup group) {
+  if (series_db_[group] != nullptr) return true;
+  const SeriesGroupInfo &info = kSeriesGroupInfo[group];
+  tsdb_config_t cfg = {};
+  cfg.filepath = info.db_path;
+  cfg.num_params = kSeriesDbColumns;
+  cfg.param_names = group == GROUP_STRING ? kStringParamNames : kInverterParamNames;
+  cfg.max_records = TSDB_CALC_MAX_RECORDS(sizes_.series[group], kSeriesDbColumns);
+  cfg.index_stride = 380;
+  // Same shape and read pattern as a panel DB (see open_panel_family_db_).
+  cfg.buffer_pool_size = 6 * 1024;
+  cfg.alloc_strategy = TSDB_ALLOC_PSRAM;
+  cfg.use_paged_allocation = false;
+  cfg.page_size = 0;
+
+  series_db_[group] = tsdb_open(&cfg);
+  if (series_db_[group] == nullptr) {
+    ESP_LOGE(TAG, "tsdb_open for %s failed", info.db_path);
+    return false;
+  }
+  ESP_LOGI(TAG, "tsdb opened: %s (%zu %ss, %zu KB, capacity ~%lu records)", info.db_path, info.capacity, info.name,
+           sizes_.series[group] / 1024, (unsigned long) cfg.max_records);
+  return true;
+}
+
+bool TigoHistory::load_trends_() {
+  FILE *f = fopen(kPanelTrendPath, "rb");
   if (f == nullptr) {
-    ESP_LOGE(TAG, "Failed to open %s for write", kPanelMapPath);
+    ESP_LOGI(TAG, "panel_trend.bin absent — trends start empty");
+    return true;
+  }
+  PanelTrendHeader hdr{};
+  bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1 && hdr.magic == kPanelTrendMagic &&
+            hdr.version == kPanelTrendVersion && hdr.count <= kMaxPanelSlots;
+  if (ok) ok = fread(trend_io_, sizeof(PanelTrend), hdr.count, f) == hdr.count;
+  fclose(f);
+  if (ok) ok = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(trend_io_),
+                                hdr.count * sizeof(PanelTrend)) == hdr.crc;
+  if (!ok) {
+    // A torn or foreign file. Trends rebuild from the next snapshot on; the
+    // slot map, and so the history itself, is unaffected.
+    ESP_LOGW(TAG, "panel_trend.bin invalid — trends start empty");
     return false;
   }
 
-  fputs("{\"slots\":[", f);
-  bool first = true;
-  for (uint8_t s = 0; s < kMaxPanelSlots; ++s) {
-    if (slot_to_barcode_[s].empty()) continue;
-    if (!first) fputc(',', f);
-    first = false;
-    std::fprintf(f, "{\"b\":\"%s\",\"s\":%u}", slot_to_barcode_[s].c_str(),
-                 (unsigned) s);
+  std::lock_guard<std::mutex> guard(trend_mutex_);
+  for (size_t i = 0; i < hdr.count; ++i) trends_[i] = trend_io_[i];
+  ESP_LOGI(TAG, "Loaded degradation trends for %u slots", (unsigned) hdr.count);
+  return true;
+}
+
+bool TigoHistory::save_trends_() {
+  {
+    std::lock_guard<std::mutex> guard(trend_mutex_);
+    for (size_t i = 0; i < kMaxPanelSlots; ++i) trend_io_[i] = trends_[i];
   }
-  fputs("]}\n", f);
+  PanelTrendHeader hdr{};
+  hdr.magic = kPanelTrendMagic;
+  hdr.version = kPanelTrendVersion;
+  hdr.count = (uint16_t) kMaxPanelSlots;
+  hdr.crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(trend_io_), sizeof(trend_io_));
+
+  // Direct overwrite for the same reason as save_slot_map_ (no clobbering
+  // rename on this LittleFS port). A torn write fails the CRC on load.
+  FILE *f = fopen(kPanelTrendPath, "wb");
+  if (f == nullptr) {
+    ESP_LOGE(TAG, "Failed to open %s for write", kPanelTrendPath);
+    return false;
+  }
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(trend_io_, sizeof(trend_io_), 1, f) == 1;
   fflush(f);
   fsync(fileno(f));
   fclose(f);
-  return true;
+  if (!ok) ESP_LOGW(TAG, "panel_trend.bin short write");
+  return ok;
+}
+
+void TigoHistory::copy_trends(std::vector<PanelTrend> &out) {
+  std::lock_guard<std::mutex> guard(trend_mutex_);
+  out.assign(trends_, trends_ + kMaxPanelSlots);
 }
 
 uint8_t TigoHistory::get_or_assign_slot(const std::string &barcode_last6) {
   if (barcode_last6.empty()) return 0xFF;
+  // The writer task is still loading panel_map.json into slot_map_ until the
+  // mount finishes; assigning now would race it and hand out taken slots.
+  if (!initialized()) return 0xFF;
 
   auto it = slot_map_.find(barcode_last6);
   if (it != slot_map_.end()) return it->second;
@@ -418,14 +851,77 @@ std::vector<PanelSlot> TigoHistory::snapshot_slot_map() const {
   return out;
 }
 
-bool TigoHistory::start_writer_task() {
-  if (!initialized_) {
-    ESP_LOGE(TAG, "start_writer_task() called before init()");
-    return false;
+uint8_t TigoHistory::get_or_assign_series(SeriesGroup group, const std::string &label) {
+  if (group >= kNumSeriesGroups || label.empty()) return 0xFF;
+  if (!initialized()) return 0xFF;  // maps still loading, as in get_or_assign_slot
+  const SeriesGroupInfo &info = kSeriesGroupInfo[group];
+  uint8_t col;
+  {
+    std::lock_guard<std::mutex> guard(series_mutex_);
+    SeriesMap &map = series_maps_[group];
+    auto it = map.columns.find(label);
+    if (it != map.columns.end()) return it->second;
+    if (map.next_free >= info.capacity) return 0xFF;  // full; the series is dropped
+    // The map file stores labels unescaped, so one that would break it is
+    // left out of the history instead.
+    if (label.find_first_of("\"\\") != std::string::npos) return 0xFF;
+    col = map.next_free++;
+    map.columns[label] = col;
+    map.labels[col] = label;
+  }
+
+  // Flash work outside series_mutex_, under FlashLock like a slot assignment:
+  // lazy DB open on the group's first label, then a synchronous map save.
+  FlashLock lock(this, 0);
+  open_series_db_(group);
+  ESP_LOGI(TAG, "Assigned %s column %u to %s", info.name, (unsigned) col, label.c_str());
+  save_series_map_(group);
+  refresh_stats_snapshot_();
+  return col;
+}
+
+uint8_t TigoHistory::find_series(SeriesGroup group, const std::string &label) {
+  if (group >= kNumSeriesGroups) return 0xFF;
+  std::lock_guard<std::mutex> guard(series_mutex_);
+  const SeriesMap &map = series_maps_[group];
+  auto it = map.columns.find(label);
+  return it != map.columns.end() ? it->second : 0xFF;
+}
+
+std::vector<SeriesSlot> TigoHistory::snapshot_series_map(SeriesGroup group) {
+  std::vector<SeriesSlot> out;
+  if (group >= kNumSeriesGroups) return out;
+  std::lock_guard<std::mutex> guard(series_mutex_);
+  const SeriesMap &map = series_maps_[group];
+  for (uint8_t c = 0; c < kSeriesDbColumns; ++c) {
+    if (!map.labels[c].empty()) out.push_back({map.labels[c], c});
   }
+  return out;
+}
+
+const char *TigoHistory::state_str() const {
+  switch (state_.load(std::memory_order_acquire)) {
+    case STATE_MOUNTING: return "warming_up";
+    case STATE_READY: return "ready";
+    case STATE_FAILED: return "failed";
+    default: return "off";
+  }
+}
+
+bool TigoHistory::start_writer_task() {
   if (task_ != nullptr) {
     return true;  // already running
   }
+  // The flash lock has to exist before the task does: set_ota_active() and the
+  // history readers take it from other tasks while the mount is in progress.
+  // init() finds it already created.
+  if (fs_mutex_ == nullptr) {
+    fs_mutex_ = xSemaphoreCreateRecursiveMutex();
+    if (fs_mutex_ == nullptr) {
+      ESP_LOGE(TAG, "could not create flash mutex");
+      return false;
+    }
+  }
   // Queue depth 4 — at the snapshot cadence we should never be more than 1 deep.
   // Extra headroom absorbs transient flash slowdowns without dropping samples.
   queue_ = xQueueCreate(4, sizeof(EncodedRow));
@@ -441,6 +937,50 @@ bool TigoHistory::start_writer_task() {
     vQueueDelete(queue_); queue_ = nullptr;
     return false;
   }
+  // Rows held for a group commit. Tiny (12 rows at most), so the internal
+  // heap is an acceptable fallback.
+  if (pending_rows_ == nullptr) {
+    pending_rows_ = static_cast<EncodedRow *>(
+        heap_caps_malloc(group_commit_ * sizeof(EncodedRow), MALLOC_CAP_SPIRAM));
+    if (pending_rows_ == nullptr)
+      pending_rows_ = static_cast<EncodedRow *>(heap_caps_malloc(group_commit_ * sizeof(EncodedRow), MALLOC_CAP_DEFAULT));
+    if (pending_rows_ == nullptr) {
+      ESP_LOGE(TAG, "Failed to allocate the tsdb row buffer");
+      // enqueue_snapshot sends whenever queue_ is set; leave it null so
+      // nothing fills a queue no task will ever read.
+      vSemaphoreDelete(writer_done_); writer_done_ = nullptr;
+      vQueueDelete(queue_); queue_ = nullptr;
+      return false;
+    }
+  }
+  if (flush_done_ == nullptr) flush_done_ = xSemaphoreCreateBinary();
+  // PSRAM only, like the per-device recent rings: without it every query
+  // simply reads flash as before.
+  if (recent_rows_ == nullptr) {
+    const uint32_t interval_s = snapshot_interval_min_ * 60;
+    const size_t want = (kRecentCoverS + interval_s - 1) / interval_s + group_commit_ + 1;
+    const size_t cap = std::max(kRecentRowMin, kRecentRowMaxBytes / sizeof(RecentRow));
+    recent_capacity_ = std::max(kRecentRowMin, std::min(want, cap));
+    recent_rows_ = static_cast<RecentRow *>(
+        heap_caps_malloc(recent_capacity_ * sizeof(RecentRow), MALLOC_CAP_SPIRAM));
+    if (recent_rows_ == nullptr && recent_capacity_ > kRecentRowMin) {
+      recent_capacity_ = kRecentRowMin;
+      recent_rows_ = static_cast<RecentRow *>(
+          heap_caps_malloc(recent_capacity_ * sizeof(RecentRow), MALLOC_CAP_SPIRAM));
+    }
+    if (recent_rows_ == nullptr) {
+      recent_capacity_ = 0;
+      ESP_LOGW(TAG, "No PSRAM for the recent-rows cache; every history query reads flash");
+    } else if (recent_capacity_ < want) {
+      ESP_LOGW(TAG, "Recent-rows cache holds %zu rows, ~%.1f h at %u min; older day-chart rows read flash",
+               recent_capacity_, (recent_capacity_ - group_commit_ - 1) * interval_s / 3600.0f,
+               (unsigned) snapshot_interval_min_);
+    } else {
+      ESP_LOGI(TAG, "Recent-rows cache: %zu rows (%zu KB PSRAM)", recent_capacity_,
+               recent_capacity_ * sizeof(RecentRow) / 1024);
+    }
+  }
+  state_.store(STATE_MOUNTING, std::memory_order_release);
   // Stack 8 KB — tsdb_write + LittleFS ops + esp_log printf overflowed 4 KB
   // in practice. Three back-to-back writes per drain (system + 2x panels)
   // adds peak depth but stays well under 8 KB; soak shows ~3.5 KB hwm.
@@ -463,11 +1003,16 @@ bool TigoHistory::start_writer_task() {
                               1 /* core 1 = ESPHome loop_task core */);
   if (ok != pdPASS) {
     ESP_LOGE(TAG, "Failed to create tsdb writer task");
+    vSemaphoreDelete(writer_done_);
+    writer_done_ = nullptr;
     vQueueDelete(queue_);
     queue_ = nullptr;
+    state_.store(STATE_OFF, std::memory_order_release);
     return false;
   }
-  ESP_LOGI(TAG, "tsdb writer task started (queue depth 4, stack 8 KB)");
+  ESP_LOGI(TAG, "tsdb writer task started (queue depth 4, stack 8 KB); mounting /tsdb in the background");
+  if (group_commit_ > 1)
+    ESP_LOGI(TAG, "Group commit: %u snapshots per flash commit", (unsigned) group_commit_);
   return true;
 }
 
@@ -480,6 +1025,7 @@ void TigoHistory::enqueue_snapshot(const SystemSnapshot &snap) {
 
   EncodedRow row;
   row.timestamp = snap.timestamp;
+  row.panels_valid = snap.panels_valid;
   // Order must match kSystemParamNames in init_system_db_.
   row.system_values[0] = enc_w_(snap.total_p_w);
   row.system_values[1] = enc_kwh_(snap.period_e_kwh);
@@ -496,29 +1042,117 @@ void TigoHistory::enqueue_snapshot(const SystemSnapshot &snap) {
   row.system_values[12] = enc_clamp_((float) snap.frames_lost);
   row.system_values[13] = enc_clamp_((float) snap.wifi_rssi_dbm);
 
-  for (size_t i = 0; i < kMaxPanelSlots; ++i) {
-    row.panel_values[i] = enc_w_(snap.panel_p_w[i]);
+  for (size_t f = 0; f < kNumPanelFamilies; ++f) {
+    const float scale = kPanelMetricInfo[panel_family_metric(f)].scale;
+    for (size_t i = 0; i < kMaxPanelSlots; ++i)
+      row.panel_values[f * kMaxPanelSlots + i] = enc_clamp_(snap.panel_values[f][i] * scale);
+  }
+  for (size_t c = 0; c < kMaxStringSeries; ++c) row.series_values[GROUP_STRING][c] = enc_w_(snap.string_p_w[c]);
+  for (size_t i = 0; i < kMaxInverterSeries; ++i) {
+    row.series_values[GROUP_INVERTER][2 * i] = enc_w_(snap.inverter_p_w[i]);
+    row.series_values[GROUP_INVERTER][2 * i + 1] = enc_kwh_(snap.inverter_e_kwh[i]);
   }
 
   // Non-blocking. If the queue is full, drop the sample with a warning.
   if (xQueueSend(queue_, &row, 0) != pdTRUE) {
     ESP_LOGW(TAG, "tsdb queue full — dropping snapshot @ %lu",
              (unsigned long) snap.timestamp);
+    return;
+  }
+
+  // Fold this snapshot into the degradation trends (RAM only; the writer
+  // persists them on its own schedule). Only once it is queued, so a snapshot
+  // dropped under writer backpressure does not feed the fit either.
+  {
+    std::lock_guard<std::mutex> guard(trend_mutex_);
+    for (size_t i = 0; i < kMaxPanelSlots; ++i) trends_[i].add(snap.timestamp, snap.panel_ratio[i]);
+  }
+}
+
+void TigoHistory::recent_push_(const EncodedRow &row, uint64_t written) {
+  if (recent_rows_ == nullptr || written == 0) return;
+  std::lock_guard<std::mutex> guard(recent_mutex_);
+  if (recent_floor_ts_ == UINT32_MAX) return;
+  if (recent_count_ > 0) {
+    const RecentRow &newest = recent_rows_[(recent_head_ + recent_capacity_ - 1) % recent_capacity_];
+    if (row.timestamp <= newest.row.timestamp) {
+      // A clock stepped backwards. The ring is walked in time order, so start
+      // it over rather than serve rows out of order; the old rows are on flash.
+      recent_floor_ts_ = std::max(recent_floor_ts_, newest.row.timestamp);
+      recent_count_ = 0;
+    }
   }
+  RecentRow &slot = recent_rows_[recent_head_];
+  if (recent_count_ == recent_capacity_) {
+    // The oldest row leaves RAM; a window reaching back to it reads flash.
+    recent_floor_ts_ = std::max(recent_floor_ts_, slot.row.timestamp);
+  } else {
+    ++recent_count_;
+  }
+  slot.row = row;
+  slot.written = written;
+  recent_head_ = (recent_head_ + 1) % recent_capacity_;
+}
+
+template<typename Fn> bool TigoHistory::recent_for_each_(uint32_t start_ts, uint32_t end_ts, Fn &&fn) {
+  if (recent_rows_ == nullptr || recent_floor_ts_ == UINT32_MAX || start_ts <= recent_floor_ts_) {
+    recent_misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  size_t idx = (recent_head_ + recent_capacity_ - recent_count_) % recent_capacity_;
+  for (size_t n = 0; n < recent_count_; ++n, idx = (idx + 1) % recent_capacity_) {
+    const RecentRow &r = recent_rows_[idx];
+    if (r.row.timestamp < start_ts) continue;
+    if (r.row.timestamp > end_ts) break;
+    fn(r);
+  }
+  recent_hits_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool TigoHistory::recent_covers_(uint32_t start_ts) {
+  std::lock_guard<std::mutex> guard(recent_mutex_);
+  return recent_rows_ != nullptr && recent_floor_ts_ != UINT32_MAX && start_ts > recent_floor_ts_;
+}
+
+TigoHistory::RecentCacheInfo TigoHistory::recent_cache_info() {
+  RecentCacheInfo info;
+  std::lock_guard<std::mutex> guard(recent_mutex_);
+  info.capacity = recent_rows_ != nullptr ? recent_capacity_ : 0;
+  info.rows = recent_count_;
+  info.floor_ts = recent_floor_ts_ == UINT32_MAX ? 0 : recent_floor_ts_;
+  info.hits = recent_hits_.load(std::memory_order_relaxed);
+  info.misses = recent_misses_.load(std::memory_order_relaxed);
+  return info;
 }
 
 int TigoHistory::iterate_power(uint32_t start_ts, uint32_t end_ts,
                                const PowerRowCb &cb) {
-  if (!initialized_)
+  if (!initialized())
     return -1;
+  if (end_ts < start_ts)
+    return 0;
+
+  // A window that starts inside the recent-rows ring is answered from RAM: no
+  // flash lock, so it can neither wait behind nor collide with a commit, and
+  // it is safe during an OTA. This is the day chart, nearly always.
+  {
+    std::lock_guard<std::mutex> guard(recent_mutex_);
+    int count = 0;
+    if (recent_for_each_(start_ts, end_ts, [&](const RecentRow &r) {
+          if (!(r.written & kRecentSystem)) return;
+          cb(r.row.timestamp, r.row.system_values[0], r.row.system_values[1]);
+          ++count;
+        }))
+      return count;
+  }
+
   // An in-flight OTA is writing flash; a concurrent littlefs read here hits the
   // same flash-vs-OTA collision that faults the writer (the decoded crash was in
   // lfs_bd_read). Bail so a dashboard poll during OTA can't crash the device —
   // the web layer returns an error and the chart retries after the OTA (~15 s).
   if (ota_active_.load(std::memory_order_relaxed))
     return -1;
-  if (end_ts < start_ts)
-    return 0;
 
   // Runs on the esp_http_server task (tskNO_AFFINITY — can be either core).
   // Held across the whole query: init/next/close are all flash reads, and any
@@ -553,19 +1187,30 @@ int TigoHistory::iterate_power(uint32_t start_ts, uint32_t end_ts,
 }
 
 bool TigoHistory::set_ota_active(bool active, uint32_t wait_ms) {
+  // Rows held for a group commit would be lost with the reboot that ends the
+  // OTA; write them while writes are still allowed. Best effort, half the
+  // budget: the quiesce below is what the OTA's safety depends on.
+  if (active && group_commit_ > 1 && initialized()) {
+    if (!flush_pending(wait_ms / 2))
+      ESP_LOGW(TAG, "OTA quiesce: held history rows not flushed in time; they are dropped");
+  }
   ota_active_.store(active, std::memory_order_relaxed);
 
   // Clearing needs no barrier — nothing is in flight that we care about.
   if (!active)
     return true;
 
-  if (fs_mutex_ == nullptr || !initialized_)
+  // No initialized() test: while the writer is still mounting it holds the
+  // lock, and an OTA must wait that out just like a commit.
+  if (fs_mutex_ == nullptr)
     return true;
 
   // The flag is now set, so the writer will skip any snapshot it has not yet
-  // started. What it cannot do is abandon one already running, and a commit is
-  // 10-21 s of erases. Taking the lock waits that out; releasing immediately is
-  // fine because the flag keeps the next one from starting.
+  // started, and stop a running one at its next phase boundary. What it cannot
+  // do is abandon a phase mid-write — a panel DB write is seconds of erases.
+  // Taking the lock waits that out (we are counted as a waiter, so the writer
+  // lets us in at the boundary); releasing immediately is fine because the
+  // flag keeps the remaining phases from starting.
   //
   // Not portMAX_DELAY: if something is genuinely wedged we must tell the caller
   // rather than hang the OTA task forever.
@@ -588,15 +1233,49 @@ bool TigoHistory::set_ota_active(bool active, uint32_t wait_ms) {
 }
 
 int TigoHistory::iterate_panel(uint8_t slot, uint32_t start_ts, uint32_t end_ts,
-                               const PanelRowCb &cb) {
-  if (!initialized_) return -1;
-  if (ota_active_.load(std::memory_order_relaxed)) return -1;  // see iterate_power: no littlefs reads during OTA
+                               const PanelRowCb &cb, PanelMetric metric) {
+  if (!initialized()) return -1;
   if (slot >= kMaxPanelSlots) return -1;
+  const int family = panel_metric_family(metric);
+  if (family < 0) return -1;
+  if (end_ts < start_ts) return 0;
+  // Ring-served windows are cheap already; caching them would only evict
+  // results that took a flash scan.
+  if (recent_covers_(start_ts)) return iterate_panel_uncached_(slot, family, start_ts, end_ts, cb);
+  // Series key: the slot, with the metric above it (power keeps plain slots).
+  return query_cache_.query(
+      (uint16_t) (slot | (metric << 8)), TIER_RAW, start_ts, end_ts, commit_gen_.load(std::memory_order_acquire), newest_commit_ts_.load(),
+      kFsLockReaderWaitMs, [&](const HistoryQueryCache::Row &r) { cb(r.ts, (int16_t) r.avg); },
+      [&](auto &&sink) {
+        return iterate_panel_uncached_(slot, family, start_ts, end_ts, [&](uint32_t ts, int16_t p) {
+          const float w = p;
+          sink(HistoryQueryCache::Row{ts, w, w, w, 0.0f});
+        });
+      });
+}
+
+int TigoHistory::iterate_panel_uncached_(uint8_t slot, size_t family, uint32_t start_ts, uint32_t end_ts,
+                                         const PanelRowCb &cb) {
+  if (!initialized()) return -1;
+  if (slot >= kMaxPanelSlots || family >= kNumPanelFamilies) return -1;
   if (end_ts < start_ts) return 0;
 
   size_t db_idx = slot / kPanelsPerDb;
   uint8_t col = slot % kPanelsPerDb;
-  if (panel_db_[db_idx] == nullptr) return -1;
+  tsdb_t *db = panel_db_[family][db_idx];
+  if (db == nullptr) return -1;
+
+  {
+    std::lock_guard<std::mutex> guard(recent_mutex_);  // see iterate_power
+    int count = 0;
+    if (recent_for_each_(start_ts, end_ts, [&](const RecentRow &r) {
+          if (!(r.written & kRecentPanelDb(family, db_idx))) return;
+          cb(r.row.timestamp, r.row.panel_values[family * kMaxPanelSlots + slot]);
+          ++count;
+        }))
+      return count;
+  }
+  if (ota_active_.load(std::memory_order_relaxed)) return -1;  // see iterate_power: no littlefs reads during OTA
 
   // See iterate_power: same httpd-task flash reads, same lock.
   FlashLock lock(this, kFsLockReaderWaitMs);
@@ -608,10 +1287,10 @@ int TigoHistory::iterate_panel(uint8_t slot, uint32_t start_ts, uint32_t end_ts,
   tsdb_query_t q;
   uint8_t cols[] = {col};
   esp_err_t err =
-      tsdb_query_init_h(panel_db_[db_idx], &q, start_ts, end_ts, cols, 1);
+      tsdb_query_init_h(db, &q, start_ts, end_ts, cols, 1);
   if (err != ESP_OK) {
-    ESP_LOGW(TAG, "panel %u tsdb_query_init_h failed: %s", (unsigned) slot,
-             esp_err_to_name(err));
+    ESP_LOGW(TAG, "panel %u %s tsdb_query_init_h failed: %s", (unsigned) slot,
+             kPanelMetricInfo[panel_family_metric(family)].name, esp_err_to_name(err));
     return -1;
   }
 
@@ -626,6 +1305,402 @@ int TigoHistory::iterate_panel(uint8_t slot, uint32_t start_ts, uint32_t end_ts,
   return count;
 }
 
+int TigoHistory::iterate_panels(const PanelSlotMask &slot_mask, uint32_t start_ts, uint32_t end_ts,
+                                const PanelsRowCb &cb) {
+  if (!initialized()) return -1;
+  if (end_ts < start_ts) return 0;
+
+  {
+    std::lock_guard<std::mutex> guard(recent_mutex_);  // see iterate_power
+    int count = 0;
+    if (recent_for_each_(start_ts, end_ts, [&](const RecentRow &r) {
+          PanelSlotMask present;
+          for (size_t i = 0; i < kNumPanelDbs; ++i) {
+            if (r.written & kRecentPanelDb(0, i)) present |= panel_db_slots_(i);
+          }
+          present &= slot_mask;
+          if (present.none()) return;
+          cb(r.row.timestamp, r.row.panel_values, present);
+          ++count;
+        }))
+      return count;
+  }
+  if (ota_active_.load(std::memory_order_relaxed)) return -1;  // see iterate_power
+
+  // One cursor per panel DB with a wanted slot. iterate_panel() on each slot
+  // instead reads the same DB blocks once per column and takes the lock once
+  // per slot; a 16-panel comparison paid that 16 times.
+  struct Cursor {
+    tsdb_query_t q;
+    bool open{false};
+    bool valid{false};
+    uint32_t ts{0};
+    int16_t values[kPanelsPerDb];
+  };
+  Cursor cursors[kNumPanelDbs];
+  uint8_t cols[kPanelsPerDb];
+  for (size_t c = 0; c < kPanelsPerDb; ++c) cols[c] = (uint8_t) c;
+
+  FlashLock lock(this, kFsLockReaderWaitMs);
+  if (!lock.held()) {
+    ESP_LOGW(TAG, "iterate_panels: timed out waiting for flash lock");
+    return -1;
+  }
+
+  auto advance = [](Cursor &cur) { cur.valid = tsdb_query_next(&cur.q, &cur.ts, cur.values) == ESP_OK; };
+  bool ok = true;
+  for (size_t i = 0; i < kNumPanelDbs; ++i) {
+    if ((slot_mask & panel_db_slots_(i)).none() || panel_db_[0][i] == nullptr) continue;
+    esp_err_t err = tsdb_query_init_h(panel_db_[0][i], &cursors[i].q, start_ts, end_ts, cols, kPanelsPerDb);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "panels%zu tsdb_query_init_h failed: %s", i, esp_err_to_name(err));
+      ok = false;
+      break;
+    }
+    cursors[i].open = true;
+    advance(cursors[i]);
+  }
+
+  // Every DB is written with the same snapshot timestamp, so rows line up;
+  // the merge only has to cope with a DB that starts (or was evicted) later.
+  int count = 0;
+  int16_t row[kMaxPanelSlots] = {0};
+  while (ok) {
+    bool any = false;
+    uint32_t ts = 0;
+    for (const auto &cur : cursors) {
+      if (cur.valid && (!any || cur.ts < ts)) ts = cur.ts;
+      any = any || cur.valid;
+    }
+    if (!any) break;
+    PanelSlotMask present;
+    for (size_t i = 0; i < kNumPanelDbs; ++i) {
+      Cursor &cur = cursors[i];
+      if (!cur.valid || cur.ts != ts) continue;
+      memcpy(row + i * kPanelsPerDb, cur.values, sizeof(cur.values));
+      present |= panel_db_slots_(i);
+      advance(cur);
+    }
+    cb(ts, row, present & slot_mask);
+    ++count;
+  }
+  for (auto &cur : cursors) {
+    if (cur.open) tsdb_query_close(&cur.q);
+  }
+  return ok ? count : -1;
+}
+
+int TigoHistory::iterate_series(SeriesGroup group, uint8_t column, uint32_t start_ts, uint32_t end_ts,
+                                const SeriesRowCb &cb) {
+  if (!initialized()) return -1;
+  if (group >= kNumSeriesGroups || column >= kSeriesGroupInfo[group].capacity) return -1;
+  if (end_ts < start_ts) return 0;
+  if (recent_covers_(start_ts)) return iterate_series_uncached_(group, column, start_ts, end_ts, cb);
+  // Series key: clear of the panel keys (slot | metric << 8) and the system's.
+  return query_cache_.query(
+      (uint16_t) (HistoryQueryCache::kSeriesGroupBase | (group << 8) | column), TIER_RAW, start_ts, end_ts,
+      commit_gen_.load(std::memory_order_acquire), newest_commit_ts_.load(), kFsLockReaderWaitMs,
+      [&](const HistoryQueryCache::Row &r) { cb(r.ts, (int16_t) r.avg, (int16_t) r.e_kwh); },
+      [&](auto &&sink) {
+        return iterate_series_uncached_(group, column, start_ts, end_ts, [&](uint32_t ts, int16_t p, int16_t e) {
+          const float w = p;
+          sink(HistoryQueryCache::Row{ts, w, w, w, (float) e});
+        });
+      });
+}
+
+int TigoHistory::iterate_series_uncached_(SeriesGroup group, uint8_t column, uint32_t start_ts, uint32_t end_ts,
+                                          const SeriesRowCb &cb) {
+  tsdb_t *db = series_db_[group];
+  if (db == nullptr) return -1;
+  const bool with_energy = kSeriesGroupInfo[group].cols_per_series == 2;
+  const uint8_t first_col = (uint8_t) (column * kSeriesGroupInfo[group].cols_per_series);
+
+  {
+    std::lock_guard<std::mutex> guard(recent_mutex_);  // see iterate_power
+    int count = 0;
+    if (recent_for_each_(start_ts, end_ts, [&](const RecentRow &r) {
+          if (!(r.written & kRecentSeries(group))) return;
+          const int16_t *v = r.row.series_values[group] + first_col;
+          cb(r.row.timestamp, v[0], with_energy ? v[1] : (int16_t) 0);
+          ++count;
+        }))
+      return count;
+  }
+  if (ota_active_.load(std::memory_order_relaxed)) return -1;  // see iterate_power
+
+  FlashLock lock(this, kFsLockReaderWaitMs);
+  if (!lock.held()) {
+    ESP_LOGW(TAG, "iterate_series: timed out waiting for flash lock");
+    return -1;
+  }
+
+  tsdb_query_t q;
+  uint8_t cols[] = {first_col, (uint8_t) (first_col + 1)};
+  esp_err_t err = tsdb_query_init_h(db, &q, start_ts, end_ts, cols, with_energy ? 2 : 1);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "%s %u tsdb_query_init_h failed: %s", kSeriesGroupInfo[group].name, (unsigned) column,
+             esp_err_to_name(err));
+    return -1;
+  }
+
+  int count = 0;
+  uint32_t ts = 0;
+  int16_t values[kSeriesDbColumns] = {0};
+  while (tsdb_query_next(&q, &ts, values) == ESP_OK) {
+    cb(ts, values[0], with_energy ? values[1] : (int16_t) 0);
+    ++count;
+  }
+  tsdb_query_close(&q);
+  return count;
+}
+
+// ---- Rollup tiers --------------------------------------------------------
+
+const char *history_tier_str(HistoryTier tier) {
+  switch (tier) {
+    case TIER_HOURLY: return "hourly";
+    case TIER_DAILY: return "daily";
+    default: return "raw";
+  }
+}
+
+uint32_t history_tier_seconds(HistoryTier tier) {
+  switch (tier) {
+    case TIER_HOURLY: return 3600;
+    case TIER_DAILY: return 86400;
+    default: return 0;
+  }
+}
+
+uint32_t TigoHistory::rollup_bucket_(size_t tier_idx, uint32_t ts) {
+  if (tier_idx == 0) return ts - ts % 3600;
+  // Local midnight via mktime, not ts - seconds-since-midnight: on a DST
+  // change day the two differ by the hour that was skipped or repeated.
+  time_t t = (time_t) ts;
+  struct tm tm_local;
+  localtime_r(&t, &tm_local);
+  tm_local.tm_hour = 0;
+  tm_local.tm_min = 0;
+  tm_local.tm_sec = 0;
+  tm_local.tm_isdst = -1;
+  time_t midnight = mktime(&tm_local);
+  return midnight > 0 ? (uint32_t) midnight : ts - ts % 86400;
+}
+
+// First bucket after `bucket`. A local day is 23, 24 or 25 hours long, so 25 h
+// on from a midnight always lands inside the next day.
+uint32_t TigoHistory::rollup_next_bucket_(size_t tier_idx, uint32_t bucket) {
+  return tier_idx == 0 ? bucket + 3600 : rollup_bucket_(tier_idx, bucket + 25 * 3600);
+}
+
+bool TigoHistory::init_rollup_dbs_() {
+  for (size_t t = 0; t < kNumRollupTiers; ++t) {
+    tsdb_config_t cfg = {};
+    cfg.filepath = kRollupPaths[t];
+    cfg.num_params = kRollupNumParams;
+    cfg.param_names = kRollupParamNames;
+    cfg.max_records = TSDB_CALC_MAX_RECORDS(sizes_.rollup[t], kRollupNumParams);
+    cfg.index_stride = 380;
+    // Queries read a few hundred rows at most; 4 KB covers it.
+    cfg.buffer_pool_size = 4 * 1024;
+    cfg.alloc_strategy = TSDB_ALLOC_PSRAM;
+    cfg.use_paged_allocation = false;
+    cfg.page_size = 0;
+
+    rollup_db_[t] = tsdb_open(&cfg);
+    if (rollup_db_[t] == nullptr) {
+      ESP_LOGW(TAG, "tsdb_open for %s failed — %s queries read raw rows", kRollupPaths[t],
+               history_tier_str((HistoryTier) (t + 1)));
+      continue;
+    }
+    ESP_LOGI(TAG, "tsdb opened: %s (capacity ~%lu buckets)", kRollupPaths[t],
+             (unsigned long) cfg.max_records);
+  }
+  return rollup_db_[0] != nullptr || rollup_db_[1] != nullptr;
+}
+
+void TigoHistory::rebuild_rollups_() {
+  tsdb_stats_t st{};
+  if (tsdb_get_stats_h(system_db_, &st) != ESP_OK || st.total_records == 0) return;
+
+  // The bucket holding the newest raw row has not been written yet — a bucket
+  // is only written once a row from the next one arrives — so those rows are
+  // exactly what the accumulator held before the reboot. At most a day of rows.
+  const PowerTierCb discard = [](uint32_t, float, float, float, float) {};
+  for (size_t t = 0; t < kNumRollupTiers; ++t) {
+    if (rollup_db_[t] == nullptr) continue;
+    uint32_t bucket = rollup_bucket_(t, st.newest_timestamp);
+    rollup_acc_[t].start(bucket);
+    if (fold_raw_range_(t, bucket, st.newest_timestamp, rollup_acc_[t], discard) < 0) {
+      rollup_acc_[t].start(0);
+      continue;
+    }
+    ESP_LOGI(TAG, "%s rollup resumed at %lu with %lu snapshot(s)", history_tier_str((HistoryTier) (t + 1)),
+             (unsigned long) bucket, (unsigned long) rollup_acc_[t].n);
+  }
+}
+
+void TigoHistory::fold_rollups_(uint32_t ts, float p_w, float e_kwh) {
+  for (size_t t = 0; t < kNumRollupTiers; ++t) {
+    if (rollup_db_[t] == nullptr) continue;
+    RollupAcc &acc = rollup_acc_[t];
+    const uint32_t bucket = rollup_bucket_(t, ts);
+    if (acc.n > 0 && bucket != acc.bucket) {
+      // A clock stepped backwards restarts the bucket instead of writing an
+      // out-of-order row; the same for a bucket the DB already has.
+      if (bucket > acc.bucket && acc.bucket > rollup_last_ts_[t].load()) {
+        int16_t values[kRollupNumParams] = {
+            enc_w_(acc.p_min), enc_w_((float) (acc.p_sum / acc.n)), enc_w_(acc.p_max),
+            enc_clamp_((float) acc.e_kwh * kRollupEnergyScale[t])};
+        esp_err_t err = tsdb_write_h(rollup_db_[t], acc.bucket, values);
+        if (err == ESP_OK) {
+          if (rollup_first_ts_[t].load() == 0) rollup_first_ts_[t].store(acc.bucket);
+          rollup_last_ts_[t].store(acc.bucket);
+        } else {
+          ESP_LOGW(TAG, "%s rollup write @ %lu failed: %s", history_tier_str((HistoryTier) (t + 1)),
+                   (unsigned long) acc.bucket, esp_err_to_name(err));
+        }
+      }
+      acc.n = 0;
+    }
+    if (acc.n == 0) acc.start(bucket);
+    acc.add(p_w, e_kwh);
+  }
+}
+
+int TigoHistory::fold_raw_range_(size_t tier_idx, uint32_t start_ts, uint32_t end_ts, RollupAcc &acc,
+                                 const PowerTierCb &cb) {
+  if (end_ts < start_ts) return 0;
+  uint8_t cols[] = {0, 1};
+  tsdb_query_t q;
+  esp_err_t err = tsdb_query_init_h(system_db_, &q, start_ts, end_ts, cols, 2);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "rollup fold: tsdb_query_init_h failed: %s", esp_err_to_name(err));
+    return -1;
+  }
+  int rows = 0;
+  uint32_t ts = 0;
+  int16_t values[kSystemNumParams] = {0};
+  while (tsdb_query_next(&q, &ts, values) == ESP_OK) {
+    const uint32_t bucket = rollup_bucket_(tier_idx, ts);
+    if (acc.n > 0 && bucket != acc.bucket) {
+      cb(acc.bucket, (float) (acc.p_sum / acc.n), acc.p_min, acc.p_max, (float) acc.e_kwh);
+      acc.n = 0;
+    }
+    if (acc.n == 0) acc.start(bucket);
+    acc.add((float) values[0], values[1] / 100.0f);
+    ++rows;
+  }
+  tsdb_query_close(&q);
+  return rows;
+}
+
+HistoryTier TigoHistory::pick_tier(uint32_t window_s, uint32_t points) const {
+  if (points == 0) points = kDefaultHistoryPoints;
+  const uint32_t target_s = window_s / points;
+  if (rollup_db_[TIER_DAILY - 1] != nullptr && target_s >= history_tier_seconds(TIER_DAILY))
+    return TIER_DAILY;
+  if (rollup_db_[TIER_HOURLY - 1] != nullptr && target_s >= history_tier_seconds(TIER_HOURLY))
+    return TIER_HOURLY;
+  return TIER_RAW;
+}
+
+int TigoHistory::iterate_power_tier(HistoryTier tier, uint32_t start_ts, uint32_t end_ts,
+                                    const PowerTierCb &cb) {
+  if (!initialized()) return -1;
+  if (end_ts < start_ts) return 0;
+  if (tier != TIER_RAW && rollup_db_[tier - 1] == nullptr) tier = TIER_RAW;
+  // Align before the cache sees it, as iterate_power_tier_uncached_ does:
+  // the entry's window, covers() and the hit path's start filter then all
+  // agree with a miss on whether the first bucket is in the answer.
+  if (tier != TIER_RAW) start_ts = rollup_bucket_(tier - 1, start_ts);
+  // See iterate_panel: the ring already answers these without flash.
+  if (tier == TIER_RAW && recent_covers_(start_ts)) return iterate_power_tier_uncached_(tier, start_ts, end_ts, cb);
+  return query_cache_.query(
+      HistoryQueryCache::kSeriesSystem, tier, start_ts, end_ts, commit_gen_.load(std::memory_order_acquire),
+      newest_commit_ts_.load(), kFsLockReaderWaitMs,
+      [&](const HistoryQueryCache::Row &r) { cb(r.ts, r.avg, r.lo, r.hi, r.e_kwh); },
+      [&](auto &&sink) {
+        return iterate_power_tier_uncached_(tier, start_ts, end_ts,
+                                            [&](uint32_t ts, float avg, float lo, float hi, float e_kwh) {
+                                              sink(HistoryQueryCache::Row{ts, avg, lo, hi, e_kwh});
+                                            });
+      });
+}
+
+int TigoHistory::iterate_power_tier_uncached_(HistoryTier tier, uint32_t start_ts, uint32_t end_ts,
+                                              const PowerTierCb &cb) {
+  if (tier == TIER_RAW || rollup_db_[tier - 1] == nullptr) {
+    return iterate_power(start_ts, end_ts, [&](uint32_t ts, int16_t p, int16_t e_x100) {
+      cb(ts, (float) p, (float) p, (float) p, e_x100 / 100.0f);
+    });
+  }
+  if (!initialized()) return -1;
+  if (ota_active_.load(std::memory_order_relaxed)) return -1;  // see iterate_power
+  if (end_ts < start_ts) return 0;
+
+  const size_t t = tier - 1;
+  // Start on a bucket boundary. Otherwise the bucket holding start_ts is
+  // neither in the stored range (its timestamp is before start_ts) nor whole
+  // in the raw fold, which would emit a partial bucket in its place.
+  start_ts = rollup_bucket_(t, start_ts);
+  // See iterate_power: same httpd-task flash reads, same lock.
+  FlashLock lock(this, kFsLockReaderWaitMs);
+  if (!lock.held()) {
+    ESP_LOGW(TAG, "iterate_power_tier: timed out waiting for flash lock");
+    return -1;
+  }
+
+  int count = 0;
+  const PowerTierCb emit = [&](uint32_t ts, float avg, float lo, float hi, float e) {
+    cb(ts, avg, lo, hi, e);
+    ++count;
+  };
+  auto flush = [&](RollupAcc &acc) {
+    if (acc.n > 0) emit(acc.bucket, (float) (acc.p_sum / acc.n), acc.p_min, acc.p_max, (float) acc.e_kwh);
+  };
+  const uint32_t first = rollup_first_ts_[t].load();
+  const uint32_t last = rollup_last_ts_[t].load();
+
+  // Older than anything the tier holds — every row, on a tier still empty.
+  if (first == 0 || start_ts < first) {
+    RollupAcc acc;
+    uint32_t head_end = (first == 0) ? end_ts : std::min(end_ts, first - 1);
+    if (fold_raw_range_(t, start_ts, head_end, acc, emit) < 0) return -1;
+    flush(acc);
+    if (first == 0) return count;
+  }
+
+  // The stored buckets.
+  uint32_t mid_start = std::max(start_ts, first);
+  uint32_t mid_end = std::min(end_ts, last);
+  if (mid_start <= mid_end) {
+    uint8_t cols[] = {0, 1, 2, 3};
+    tsdb_query_t q;
+    esp_err_t err = tsdb_query_init_h(rollup_db_[t], &q, mid_start, mid_end, cols, kRollupNumParams);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "%s tsdb_query_init_h failed: %s", history_tier_str(tier), esp_err_to_name(err));
+      return -1;
+    }
+    uint32_t ts = 0;
+    int16_t values[kRollupNumParams] = {0};
+    while (tsdb_query_next(&q, &ts, values) == ESP_OK) {
+      emit(ts, (float) values[1], (float) values[0], (float) values[2], values[3] / kRollupEnergyScale[t]);
+    }
+    tsdb_query_close(&q);
+  }
+
+  // Newer than the last stored bucket: the one still accumulating.
+  uint32_t tail_start = std::max(start_ts, rollup_next_bucket_(t, last));
+  if (tail_start <= end_ts) {
+    RollupAcc acc;
+    if (fold_raw_range_(t, tail_start, end_ts, acc, emit) < 0) return -1;
+    flush(acc);
+  }
+  return count;
+}
+
 void TigoHistory::refresh_stats_snapshot_() {
   // Build into a local first: tsdb_get_stats_h can block on the per-DB mutex
   // for up to 5 s, and holding stats_mutex_ across that would make a reader
@@ -641,6 +1716,10 @@ void TigoHistory::refresh_stats_snapshot_() {
   }
   snap.slot_count = slot_map_.size();
   snap.next_free_slot = next_free_slot_;
+  {
+    std::lock_guard<std::mutex> guard(series_mutex_);
+    for (size_t g = 0; g < kNumSeriesGroups; ++g) snap.series_count[g] = series_maps_[g].columns.size();
+  }
 
   auto grab = [](tsdb_t *db, StatsSnapshot::Db &out) {
     if (db == nullptr) return;  // lazily-unopened panel DB: no row at all
@@ -649,7 +1728,20 @@ void TigoHistory::refresh_stats_snapshot_() {
     out.available = (out.error == ESP_OK);
   };
   grab(system_db_, snap.system);
-  for (size_t i = 0; i < kNumPanelDbs; ++i) grab(panel_db_[i], snap.panels[i]);
+  for (size_t f = 0; f < kNumPanelFamilies; ++f) {
+    for (size_t i = 0; i < kNumPanelDbs; ++i) grab(panel_db_[f][i], snap.panels[f][i]);
+  }
+  for (size_t g = 0; g < kNumSeriesGroups; ++g) grab(series_db_[g], snap.series[g]);
+  for (size_t t = 0; t < kNumRollupTiers; ++t) {
+    grab(rollup_db_[t], snap.rollups[t]);
+    // Eviction moves the oldest bucket forward; queries fold anything older
+    // from raw rows, so they have to know where the tier now starts.
+    if (snap.rollups[t].available) {
+      const tsdb_stats_t &st = snap.rollups[t].stats;
+      rollup_first_ts_[t].store(st.total_records > 0 ? st.oldest_timestamp : 0);
+      rollup_last_ts_[t].store(st.total_records > 0 ? st.newest_timestamp : 0);
+    }
+  }
 
   std::lock_guard<std::mutex> guard(stats_mutex_);
   stats_snapshot_ = snap;
@@ -665,20 +1757,47 @@ void TigoHistory::writer_task_entry_(void *arg) {
 }
 
 void TigoHistory::writer_task_loop_() {
+  // The mount and the DB opens run here rather than in setup(): the first
+  // LittleFS mount of a full partition walks its metadata for seconds, and a
+  // format-on-failure erases the whole thing. Snapshots queued meanwhile are
+  // drained below once it is done.
+  uint32_t t_mount = (uint32_t) (esp_timer_get_time() / 1000);
+  if (this->init()) {
+    ESP_LOGI(TAG, "History ready after %lu ms in the background",
+             (unsigned long) ((uint32_t) (esp_timer_get_time() / 1000) - t_mount));
+  } else {
+    // Keep running so flush_and_close still gets its handshake; every row is
+    // dropped below.
+    state_.store(STATE_FAILED, std::memory_order_release);
+    ESP_LOGW(TAG, "Time-series history disabled — sensor data still publishes normally");
+  }
+
   EncodedRow row;
   for (;;) {
     if (xQueueReceive(queue_, &row, portMAX_DELAY) != pdTRUE) {
       continue;
     }
     // Sentinel: flush_and_close enqueues a row with timestamp = UINT32_MAX
-    // to tell the writer to shut down cleanly. After signaling, the writer
-    // self-deletes; the close path then runs fclose with no race possible
-    // because this task is gone before we get back to flush_and_close.
-    if (row.timestamp == 0xFFFFFFFFu) {
+    // to tell the writer to shut down cleanly. Rows still held for a group
+    // commit go to flash first. After signaling, the writer self-deletes; the
+    // close path then runs fclose with no race possible because this task is
+    // gone before we get back to flush_and_close.
+    if (row.timestamp == kWriterStopTs) {
+      if (pending_count_ > 0 && this->initialized()) this->commit_rows_(pending_rows_, pending_count_);
+      pending_count_ = 0;
       if (writer_done_ != nullptr) xSemaphoreGive(writer_done_);
       vTaskDelete(nullptr);
       return;  // not reached
     }
+    // flush_pending(): commit what the group holds now, then acknowledge.
+    if (row.timestamp == kWriterFlushTs) {
+      if (pending_count_ > 0 && this->initialized() && !ota_active_.load(std::memory_order_relaxed))
+        this->commit_rows_(pending_rows_, pending_count_);
+      pending_count_ = 0;
+      if (flush_done_ != nullptr) xSemaphoreGive(flush_done_);
+      continue;
+    }
+    if (!this->initialized()) continue;
 
     // While an OTA is running, skip this snapshot's flash writes entirely — the
     // writer's littlefs fsync (lfs_bd_read) otherwise collides with the OTA
@@ -691,76 +1810,210 @@ void TigoHistory::writer_task_loop_() {
       continue;
     }
 
-    // Everything from here to the end of the iteration touches flash: the
-    // system write, each panel write, and the journal commit. Take the lock
-    // once for the whole batch rather than per call — a reader slipping in
-    // between two writes is just as fatal as one landing mid-write.
-    //
-    // Deliberately scoped BELOW xQueueReceive: holding this across the
-    // portMAX_DELAY receive would block every reader for the whole
-    // inter-snapshot gap. It releases when the iteration ends.
-    //
-    // portMAX_DELAY, not a timeout: dropping a snapshot loses data, and the
-    // only holders are bounded (a query, a slot save).
+    // Group commit: hold rows until the group is full. Without it (the
+    // default, group of 1) every row commits as soon as it arrives.
+    pending_rows_[pending_count_++] = row;
+    if (pending_count_ < group_commit_) {
+      ESP_LOGD(TAG, "tsdb row @ %lu held for group commit (%u/%u)", (unsigned long) row.timestamp,
+               (unsigned) pending_count_, (unsigned) group_commit_);
+      continue;
+    }
+    this->commit_rows_(pending_rows_, pending_count_);
+    pending_count_ = 0;
+  }
+}
+
+void TigoHistory::commit_rows_(const EncodedRow *rows, size_t n) {
+  // The commit runs as a series of phases — the system writes, each panel DB,
+  // the string and inverter DBs, the rollups, the journal commit (+ trend
+  // save), the stats refresh — each under its own FlashLock. It used to be one
+  // lock held for the lot, ~21 s with the panel rings full, so a chart request
+  // or an OTA quiesce that arrived just after it started waited the whole
+  // commit out.
+  //
+  // Between phases the lock is released and anyone waiting for it (a
+  // history query, set_ota_active) goes first, so they wait one phase at
+  // most — a panel DB write, ~5 s on the reference rig. Nothing is
+  // interleaved with a flash operation: each phase still holds the lock for
+  // its whole duration, which is all the fault analysis on fs_mutex_ needs.
+  // Readers may see the system row before the panel rows of the same
+  // snapshot; each DB is consistent on its own, and queries never assumed
+  // more.
+  //
+  // With group commit, each phase writes all `n` rows to its DB and the
+  // journal, trend save and stats refresh run once for the group — those
+  // are the per-commit costs the group amortizes.
+  //
+  // An OTA that starts mid-commit preempts it at the next boundary: the
+  // remaining phases are dropped, and the rows are incomplete in the DBs it
+  // did not reach (the device reboots into the new image anyway).
+  //
+  // portMAX_DELAY per phase, not a timeout: dropping a snapshot loses data,
+  // and the only other holders are bounded (a query, a slot save).
+  auto phase = [this](auto &&work) -> bool {
+    this->yield_to_flash_waiters_();
+    if (ota_active_.load(std::memory_order_relaxed)) return false;
     FlashLock lock(this, 0);
+    // Raised while we waited for the lock: set_ota_active() was ahead of us.
+    if (ota_active_.load(std::memory_order_relaxed)) return false;
+    work();
+    return true;
+  };
 
+  esp_err_t err = ESP_OK;
+  uint32_t t_sys = 0;
+  uint32_t panel_total_ms = 0;
+  uint32_t series_ms = 0;
+  // kRecentSystem / kRecentPanelDb(f, i) per row: what reached flash.
+  uint64_t written[kMaxGroupCommit] = {0};
+  bool complete = phase([&]() {
     uint32_t t0 = (uint32_t) (esp_timer_get_time() / 1000);
+    for (size_t r = 0; r < n; ++r) {
+      esp_err_t e = tsdb_write_h(system_db_, rows[r].timestamp, rows[r].system_values);
+      if (e == ESP_OK)
+        written[r] |= kRecentSystem;
+      else
+        err = e;
+    }
+    t_sys = (uint32_t) (esp_timer_get_time() / 1000) - t0;
+  });
+
+  // One phase per panel DB, metric families after power. A single failure
+  // on one DB shouldn't skip the others — keep going so we lose at most one
+  // DB's data per row.
+  for (size_t f = 0; complete && f < kNumPanelFamilies; ++f) {
+    const char *stem = kPanelMetricInfo[panel_family_metric(f)].file_stem;
+    for (size_t i = 0; complete && i < kNumPanelDbs; ++i) {
+      tsdb_t *db = panel_db_[f][i];
+      if (db == nullptr) continue;
+      complete = phase([&]() {
+        uint32_t ti = (uint32_t) (esp_timer_get_time() / 1000);
+        for (size_t r = 0; r < n; ++r) {
+          if (!rows[r].panels_valid) continue;
+          esp_err_t perr =
+              tsdb_write_h(db, rows[r].timestamp, rows[r].panel_values + f * kMaxPanelSlots + i * kPanelsPerDb);
+          if (perr != ESP_OK) {
+            ESP_LOGW(TAG, "%s%zu write @ %lu failed: %s", stem, i, (unsigned long) rows[r].timestamp,
+                     esp_err_to_name(perr));
+          } else {
+            written[r] |= kRecentPanelDb(f, i);
+          }
+        }
+        panel_total_ms += (uint32_t) (esp_timer_get_time() / 1000) - ti;
+      });
+    }
+  }
 
-    esp_err_t err = tsdb_write_h(system_db_, row.timestamp, row.system_values);
-    uint32_t t_sys = (uint32_t) (esp_timer_get_time() / 1000) - t0;
-
-    // Panel writes happen back-to-back. A single failure on one DB shouldn't
-    // skip the others — keep going so we lose at most one DB's data per row.
-    uint32_t panel_total_ms = 0;
-    for (size_t i = 0; i < kNumPanelDbs; ++i) {
-      if (panel_db_[i] == nullptr) continue;
+  // The string and inverter rows, one phase per DB like the panels. Gated on
+  // panels_valid too: that is what says the series maps were loaded.
+  for (size_t g = 0; complete && g < kNumSeriesGroups; ++g) {
+    tsdb_t *db = series_db_[g];
+    if (db == nullptr) continue;
+    complete = phase([&]() {
       uint32_t ti = (uint32_t) (esp_timer_get_time() / 1000);
-      esp_err_t perr = tsdb_write_h(panel_db_[i], row.timestamp,
-                                    row.panel_values + i * kPanelsPerDb);
-      uint32_t dt = (uint32_t) (esp_timer_get_time() / 1000) - ti;
-      panel_total_ms += dt;
-      if (perr != ESP_OK) {
-        ESP_LOGW(TAG, "panels%zu write @ %lu failed after %u ms: %s", i,
-                 (unsigned long) row.timestamp, (unsigned) dt,
-                 esp_err_to_name(perr));
+      for (size_t r = 0; r < n; ++r) {
+        if (!rows[r].panels_valid) continue;
+        esp_err_t serr = tsdb_write_h(db, rows[r].timestamp, rows[r].series_values[g]);
+        if (serr != ESP_OK) {
+          ESP_LOGW(TAG, "%s write @ %lu failed: %s", kSeriesGroupInfo[g].db_path,
+                   (unsigned long) rows[r].timestamp, esp_err_to_name(serr));
+        } else {
+          written[r] |= kRecentSeries(g);
+        }
       }
-    }
+      series_ms += (uint32_t) (esp_timer_get_time() / 1000) - ti;
+    });
+  }
 
-    // Force LittleFS to commit the block-allocation journal for everything just
-    // written, so the data survives a reboot without relying on the clean-shutdown
-    // unmount (which on this rig isn't sticking).
+  // Rollup buckets that these rows close. Raw first, so a reboot between the
+  // two loses at most one bucket rather than writing it twice
+  // (rebuild_rollups_ re-folds from the raw rows). A row whose system write
+  // failed is not folded either: the rollups must summarize what the raw DB
+  // holds, or a re-fold after reboot would disagree with them.
+  complete = complete && phase([&]() {
+    for (size_t r = 0; r < n; ++r) {
+      if (!(written[r] & kRecentSystem)) continue;
+      this->fold_rollups_(rows[r].timestamp, (float) rows[r].system_values[0], rows[r].system_values[1] / 100.0f);
+    }
+  });
+
+  // Force LittleFS to commit the block-allocation journal for everything just
+  // written, so the data survives a reboot without relying on the
+  // clean-shutdown unmount (which on this rig isn't sticking). The degradation
+  // trends are persisted every kTrendSaveIntervalS in the same phase, so they
+  // add no flash window of their own.
+  const uint32_t newest_ts = rows[n - 1].timestamp;
+  complete = complete && phase([&]() {
     this->commit_journal_();
+    if (newest_ts - last_trend_save_ts_ >= kTrendSaveIntervalS) {
+      if (this->save_trends_()) last_trend_save_ts_ = newest_ts;
+    }
+  });
 
-    // Refresh the diagnostics snapshot here, while we are still holding
-    // FlashLock and the flash is already hot. This is the ONLY place the
-    // numbers behind /api/tsdb/stats are read from flash — doing it from the
-    // HTTP task is what crashed the device (see StatsSnapshot in the header).
-    this->refresh_stats_snapshot_();
+  // Refresh the diagnostics snapshot as the last phase, with the flash
+  // already hot. This is the ONLY place the numbers behind /api/tsdb/stats
+  // are read from flash — doing it from the HTTP task is what crashed the
+  // device (see StatsSnapshot in the header).
+  complete = complete && phase([&]() { this->refresh_stats_snapshot_(); });
 
-    UBaseType_t hwm = uxTaskGetStackHighWaterMark(nullptr);
-    if (err != ESP_OK) {
-      ESP_LOGW(TAG, "tsdb_write @ %lu failed after %u ms: %s (stack hwm %u B)",
-               (unsigned long) row.timestamp, (unsigned) t_sys,
-               esp_err_to_name(err), (unsigned) (hwm * sizeof(StackType_t)));
-    } else {
-      // INFO, not DEBUG: this duration is the single most useful number this
-      // component produces. Every mid-file write makes LittleFS copy from the
-      // write offset to EOF, a byte at a time (lfs.c:3376 in lfs_file_flush),
-      // and esp_tsdb rewrites the header at offset 0 on EVERY record — so a
-      // commit drags most of each file through that loop. Both decoded crash
-      // PCs sit inside it. How long this takes IS the crash exposure, and at
-      // the default INFO log level it was invisible.
-      ESP_LOGI(TAG,
-               "tsdb_write @ %lu ok (sys %u ms, panels %u ms, stack hwm %u B)",
-               (unsigned long) row.timestamp, (unsigned) t_sys,
-               (unsigned) panel_total_ms,
-               (unsigned) (hwm * sizeof(StackType_t)));
+  if (!complete) {
+    ESP_LOGW(TAG, "OTA started mid-commit — stopped tsdb write @ %lu at a phase boundary",
+             (unsigned long) newest_ts);
+  }
+
+  // Outside every phase: a RAM-served query holds recent_mutex_ while it
+  // copies rows out, and that must never hold up the flash lock.
+  bool any = false;
+  for (size_t r = 0; r < n; ++r) {
+    this->recent_push_(rows[r], written[r]);
+    if (written[r] != 0) {
+      newest_commit_ts_.store(rows[r].timestamp, std::memory_order_relaxed);
+      any = true;
     }
   }
+  // Cached query results from before these rows are now stale.
+  if (any) commit_gen_.fetch_add(1, std::memory_order_release);
+
+  UBaseType_t hwm = uxTaskGetStackHighWaterMark(nullptr);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "tsdb_write @ %lu failed after %u ms: %s (stack hwm %u B)",
+             (unsigned long) newest_ts, (unsigned) t_sys,
+             esp_err_to_name(err), (unsigned) (hwm * sizeof(StackType_t)));
+  } else {
+    // INFO, not DEBUG: this duration is the single most useful number this
+    // component produces. Every mid-file write makes LittleFS copy from the
+    // write offset to EOF, a byte at a time (lfs.c:3376 in lfs_file_flush),
+    // and esp_tsdb rewrites the header at offset 0 on EVERY record — so a
+    // commit drags most of each file through that loop. Both decoded crash
+    // PCs sit inside it. How long this takes IS the crash exposure, and at
+    // the default INFO log level it was invisible.
+    ESP_LOGI(TAG,
+             "tsdb_write @ %lu ok (%u row(s), sys %u ms, panels %u ms, series %u ms, stack hwm %u B)",
+             (unsigned long) newest_ts, (unsigned) n, (unsigned) t_sys,
+             (unsigned) panel_total_ms, (unsigned) series_ms,
+             (unsigned) (hwm * sizeof(StackType_t)));
+  }
+}
+
+bool TigoHistory::flush_pending(uint32_t wait_ms) {
+  if (queue_ == nullptr || flush_done_ == nullptr || group_commit_ <= 1) return true;
+  // Drop an acknowledgement nobody waited for (a night-mode flush), so the
+  // take below is ours.
+  xSemaphoreTake(flush_done_, 0);
+  EncodedRow marker{};
+  marker.timestamp = kWriterFlushTs;
+  if (xQueueSend(queue_, &marker, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "flush_pending: writer queue full");
+    return false;
+  }
+  if (wait_ms == 0) return true;
+  return xSemaphoreTake(flush_done_, pdMS_TO_TICKS(wait_ms)) == pdTRUE;
 }
 
 void TigoHistory::flush_and_close() {
-  if (!initialized_) return;
+  // Not initialized(): a writer that is still mounting, or failed to, is
+  // running and owns the queue, and still needs the stop handshake below.
+  if (state_.load(std::memory_order_acquire) == STATE_OFF) return;
 
   // Drain whatever's already enqueued (best effort, 800 ms cap). Anything
   // already received by the writer task will have run tsdb_write_h before
@@ -790,7 +2043,7 @@ void TigoHistory::flush_and_close() {
   // late ack via writer_done_ and completes the close cleanly.
   if (queue_ != nullptr && task_ != nullptr && writer_done_ != nullptr) {
     EncodedRow sentinel{};
-    sentinel.timestamp = 0xFFFFFFFFu;
+    sentinel.timestamp = kWriterStopTs;
     if (xQueueSend(queue_, &sentinel, pdMS_TO_TICKS(200)) != pdTRUE) {
       ESP_LOGW(TAG, "flush_and_close: could not enqueue writer-stop sentinel; "
                     "skipping close — writer still owns the tsdb handles");
@@ -799,10 +2052,12 @@ void TigoHistory::flush_and_close() {
     // 5 s cap: the realistic worst case is not the writes themselves but a
     // littlefs GC / deorphan pass on a well-filled ring, which can run
     // multi-second. Delaying the OTA reboot a few seconds is cheaper than
-    // closing under a live writer.
-    if (xSemaphoreTake(writer_done_, pdMS_TO_TICKS(5000)) != pdTRUE) {
-      ESP_LOGW(TAG, "flush_and_close: writer did not exit within 5000 ms; "
-                    "skipping close — flash is consistent (every write is fsync'd)");
+    // closing under a live writer. A group commit's held rows are written
+    // before the writer exits, so allow ~1 s per row on top.
+    const uint32_t stop_wait_ms = 5000 + 1000 * group_commit_;
+    if (xSemaphoreTake(writer_done_, pdMS_TO_TICKS(stop_wait_ms)) != pdTRUE) {
+      ESP_LOGW(TAG, "flush_and_close: writer did not exit within %u ms; "
+                    "skipping close — flash is consistent (every write is fsync'd)", (unsigned) stop_wait_ms);
       return;
     }
     task_ = nullptr;
@@ -833,8 +2088,12 @@ void TigoHistory::flush_and_close() {
   // leak is irrelevant) — a racing /api/tsdb/stats then sees "no DB" instead
   // of touching a torn-down handle, and since we never free there is no UAF.
   system_db_ = nullptr;
-  for (size_t i = 0; i < kNumPanelDbs; ++i) panel_db_[i] = nullptr;
-  initialized_ = false;
+  for (auto &family : panel_db_) {
+    for (auto &db : family) db = nullptr;
+  }
+  for (auto &db : series_db_) db = nullptr;
+  for (auto &db : rollup_db_) db = nullptr;
+  state_.store(STATE_OFF, std::memory_order_release);
 }
 
 }  // namespace tigo_monitor
@@ -13,12 +13,18 @@
 
 #include "esp_tsdb.h"
 #include "esp_littlefs.h"
+#include "esphome/core/defines.h"  // TIGO_HISTORY_PANEL_DBS
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
+#include "tigo_query_cache.h"
+#include "tigo_trend.h"
+
+#include <algorithm>
 #include <atomic>
+#include <bitset>
 #include <cstdint>
 #include <functional>
 #include <mutex>
@@ -46,9 +52,9 @@ namespace tigo_monitor {
 //
 // Two costs still scale with it, and neither was fixed by that flag:
 //
-//   * A commit stalls the writer ~21 s and holds the flash lock the whole time,
-//     so history queries queue behind it (sys 5349 ms + panels 17269 ms,
-//     esp_tsdb 2.3.0, panel rings full).
+//   * A commit stalls the writer ~21 s (sys 5349 ms + panels 17269 ms,
+//     esp_tsdb 2.3.0, panel rings full). It takes the flash lock per DB now,
+//     so a history query waits out one DB write rather than all of them.
 //   * Flash wear scales with 1/interval, since the write volume per commit is
 //     roughly fixed. The absolute figure has not been measured; don't quote one.
 //
@@ -63,9 +69,10 @@ namespace tigo_monitor {
 //
 // Retention scales with the interval too, since each DB holds a fixed record
 // count: the 5404-record panel rings span ~112 days at 30 min, ~37.5 at 10;
-// system.tsdb spans ~2.2 yr at 30 min. period_e_kwh is energy-since-last-
-// snapshot, so it is interval-agnostic and lifetime totals stay correct across
-// a change — you can retune this without invalidating stored history.
+// system.tsdb spans ~1.5 yr at 30 min (longer in a file created at the old
+// 1 MB size). period_e_kwh is energy-since-last-snapshot, so it is
+// interval-agnostic and lifetime totals stay correct across a change — you
+// can retune this without invalidating stored history.
 //
 // Default only — the effective value is `history_interval` in YAML, held on
 // TigoMonitorComponent and readable via get_snapshot_interval_min(). 30 min is
@@ -74,20 +81,136 @@ namespace tigo_monitor {
 static constexpr uint32_t kDefaultSnapshotIntervalMin = 30;
 
 // Bounds enforced by the Python schema; restated here because the retention and
-// duty-cycle maths below depend on them. A commit currently holds the flash
-// ~21 s (see tigo_history.cpp write path), so 5 min is already ~7% duty and
-// anything shorter approaches a writer that is never idle.
+// duty-cycle maths below depend on them. With group commit (below) the floor
+// applies to the commit cadence, interval × group, rather than the interval. A
+// commit currently holds the flash ~21 s (see tigo_history.cpp write path), so
+// 5 min is already ~7% duty and anything shorter approaches a writer that is
+// never idle.
 static constexpr uint32_t kMinSnapshotIntervalMin = 5;
 static constexpr uint32_t kMaxSnapshotIntervalMin = 1440;
 
-// esp_tsdb caps base params per DB at 16. We cover up to 48 panels by
-// striping across three DB instances (panels0.tsdb, panels1.tsdb, panels2.tsdb).
-// Sized for the user's 36->40 panel rig with 8 slots of growth headroom; bump
-// kNumPanelDbs to 4 if a 64-panel install ever shows up (will require larger
-// flash — see kPanelFileBytes math in tigo_history.cpp).
+// Group commit (`history_group_commit`): the writer holds this many snapshots
+// and commits them together — one pass of the phased commit, one journal
+// commit, one stats refresh — instead of one commit per snapshot. Held rows
+// are written at the group size, on night-mode entry, before an OTA and on
+// shutdown; a crash or power loss drops them, so the loss window is
+// group × interval. That is what lets `history_interval` go below
+// kMinSnapshotIntervalMin: the schema requires the commit cadence
+// (interval × group) to stay at or above it. esp_tsdb still writes each
+// record (and its header) individually — it has no batch write — so this
+// amortizes the per-commit work, not the per-record work.
+static constexpr uint32_t kMaxGroupCommit = 12;
+
+// esp_tsdb caps base params per DB at 16, so panels are striped across
+// several DB instances (panels0.tsdb, panels1.tsdb, ...), 16 slots each. The
+// count is `history_panel_dbs` in YAML, arriving here as
+// TIGO_HISTORY_PANEL_DBS; left out, it is sized from `number_of_devices` with a
+// floor of 3 — the original fixed layout, so existing installs keep their
+// files. It is a build constant rather than a runtime one on purpose: every
+// row, snapshot and slot table is a fixed array sized from it, the writer
+// queue stays a plain FreeRTOS queue of equal items, and a YAML change
+// rebuilds anyway. Capped at kMaxPanelDbs (128 slots), past the 100-device
+// limit on `number_of_devices`. The DBs share one flash budget, so more of
+// them means fewer records each — see kPanelBudgetBytes in tigo_history.cpp.
+#ifndef TIGO_HISTORY_PANEL_DBS
+#define TIGO_HISTORY_PANEL_DBS 3
+#endif
 static constexpr size_t kPanelsPerDb = 16;
-static constexpr size_t kNumPanelDbs = 3;
+static constexpr size_t kMaxPanelDbs = 8;
+static constexpr size_t kNumPanelDbs = TIGO_HISTORY_PANEL_DBS;
+static_assert(kNumPanelDbs >= 1 && kNumPanelDbs <= kMaxPanelDbs, "history_panel_dbs out of range");
 static constexpr size_t kMaxPanelSlots = kPanelsPerDb * kNumPanelDbs;
+static_assert(kMaxPanelSlots < 0xFF, "slots are uint8_t, with 0xFF as the table-full return");
+// A set of panel slots, as iterate_panels() takes and reports them.
+using PanelSlotMask = std::bitset<kMaxPanelSlots>;
+
+// Per-panel metric families. Power is always recorded; the others are opted
+// into with `history_panel_metrics` in YAML, arriving here as the bitmask
+// TIGO_HISTORY_PANEL_METRICS (bit n = PanelMetric n). Each enabled family is
+// striped exactly like power — kNumPanelDbs DBs of 16 columns, one column per
+// slot — in its own files (panels_vin0.tsdb, ...), so a query for one metric
+// reads only that family. Values are stored as int16 at the family's scale
+// (panel_metric_scale): volts ×100, °C ×10, watts and dBm as is.
+//
+// Build-time for the same reason as the DB count: rows and snapshots carry
+// one kMaxPanelSlots block per enabled family, so a build without extras pays
+// nothing for them. The families share the panel flash budget (see
+// plan_file_sizes_ in tigo_history.cpp), so each one enabled shortens power's
+// retention too.
+enum PanelMetric : uint8_t { PANEL_POWER = 0, PANEL_VIN, PANEL_VOUT, PANEL_TEMP, PANEL_RSSI };
+static constexpr size_t kPanelMetricCount = 5;
+#ifndef TIGO_HISTORY_PANEL_METRICS
+#define TIGO_HISTORY_PANEL_METRICS 0
+#endif
+static constexpr uint32_t kPanelMetricMask = (TIGO_HISTORY_PANEL_METRICS) | (1u << PANEL_POWER);
+static_assert(kPanelMetricMask < (1u << kPanelMetricCount), "unknown bit in history_panel_metrics");
+
+constexpr bool panel_metric_enabled(PanelMetric m) { return (kPanelMetricMask >> m) & 1u; }
+// Position of `m` among the enabled families (power is 0), or -1 if disabled.
+constexpr int panel_metric_family(PanelMetric m) {
+  if (!panel_metric_enabled(m)) return -1;
+  int f = 0;
+  for (uint8_t i = 0; i < m; ++i) f += (kPanelMetricMask >> i) & 1u;
+  return f;
+}
+// The metric recorded by family `f`.
+constexpr PanelMetric panel_family_metric(size_t f) {
+  for (uint8_t i = 0; i < kPanelMetricCount; ++i) {
+    if (panel_metric_enabled((PanelMetric) i) && f-- == 0) return (PanelMetric) i;
+  }
+  return PANEL_POWER;
+}
+constexpr size_t count_panel_families() {
+  size_t n = 0;
+  for (uint8_t i = 0; i < kPanelMetricCount; ++i) n += (kPanelMetricMask >> i) & 1u;
+  return n;
+}
+static constexpr size_t kNumPanelFamilies = count_panel_families();
+
+// "power", "vin", "vout", "temp", "rssi" — the `metric=` values and YAML names.
+const char *panel_metric_str(PanelMetric m);
+bool parse_panel_metric(const char *s, PanelMetric &out);
+// Stored int16 = value × scale.
+float panel_metric_scale(PanelMetric m);
+const char *panel_metric_unit(PanelMetric m);
+
+// Per-string and per-inverter series. system.tsdb has room for four inverters
+// and nothing per string, so each group gets a DB of its own, written in the
+// same commit as the panels: strings.tsdb holds one power column per string,
+// inverters.tsdb a power and an energy column per inverter. As with panel
+// slots, columns are handed out on first sight by a persistent map keyed by
+// the canonical label (string_map.json, inverter_map.json) and never recycled,
+// so a column is the same string or inverter for the life of its file.
+// system.tsdb keeps its inv1..inv4 columns for existing tools and installs.
+enum SeriesGroup : uint8_t { GROUP_STRING = 0, GROUP_INVERTER };
+static constexpr size_t kNumSeriesGroups = 2;
+static constexpr size_t kSeriesDbColumns = 16;  // esp_tsdb's base-param cap
+static constexpr size_t kMaxStringSeries = kSeriesDbColumns;
+static constexpr size_t kMaxInverterSeries = kSeriesDbColumns / 2;
+// "string" / "inverter", for logs and the JSON API.
+const char *series_group_str(SeriesGroup group);
+size_t series_group_capacity(SeriesGroup group);
+
+// One entry of a string or inverter map: the canonical label and its column.
+struct SeriesSlot {
+  std::string label;
+  uint8_t column;
+};
+
+// Rollup tiers for the system power series. The writer folds every raw
+// snapshot into an hourly and a daily bucket (min/avg/max power, energy) and
+// writes the finished bucket to hourly.tsdb / daily.tsdb when the next
+// snapshot crosses its boundary. Long-range queries read those instead of
+// every raw row: a year is ~365 daily rows rather than ~17,500 snapshots, and
+// the flash lock is held for a few hundred reads instead of all of them.
+enum HistoryTier : uint8_t { TIER_RAW = 0, TIER_HOURLY, TIER_DAILY };
+static constexpr size_t kNumRollupTiers = 2;  // hourly, daily
+// Point budget a history query is sized to when the caller names none.
+static constexpr uint32_t kDefaultHistoryPoints = 300;
+
+const char *history_tier_str(HistoryTier tier);
+// Bucket width in seconds (raw: 0 — it is whatever history_interval is).
+uint32_t history_tier_seconds(HistoryTier tier);
 
 // One raw snapshot. The history layer encodes these to int16_t and writes.
 // Caller fills this under the TigoMonitorComponent state lock.
@@ -102,10 +225,30 @@ struct SystemSnapshot {
   uint16_t frames_lost;        // missed frames in this window
   int16_t wifi_rssi_dbm;       // 0 if unavailable
 
-  // Per-panel power indexed by stable slot. Unused slots stay at 0.0f and
-  // encode to int16_t 0 — distinguishable from valid panels in queries
-  // because the slot map only ever points at really-seen barcodes.
-  float panel_p_w[kMaxPanelSlots];
+  // Per-panel values indexed by family, then stable slot: [0] is power in
+  // watts, then each enabled metric in panel_family_metric() order, in its
+  // own unit (V, °C, dBm). Unused slots stay at 0.0f and encode to int16_t 0
+  // — distinguishable from valid panels in queries because the slot map only
+  // ever points at really-seen barcodes.
+  float panel_values[kNumPanelFamilies][kMaxPanelSlots];
+
+  // Per-panel output power over its string's mean output power, fed to the
+  // degradation trend (tigo_trend.h). NaN = no usable reference this time
+  // (dark, string unknown); the slot's trend is left alone.
+  float panel_ratio[kMaxPanelSlots];
+
+  // Per-string output power and per-inverter power / energy since the last
+  // snapshot, indexed by the column get_or_assign_series() gave the label.
+  // Unused columns stay at 0.
+  float string_p_w[kMaxStringSeries];
+  float inverter_p_w[kMaxInverterSeries];
+  float inverter_e_kwh[kMaxInverterSeries];
+
+  // False for a snapshot taken while the history was still mounting: the slot
+  // and series maps were not loaded, so panel_values and the string/inverter
+  // columns are all zeros rather than real readings. The writer then records
+  // the system row only.
+  bool panels_valid;
 };
 
 // One entry of the persistent slot map. `barcode_last6` is the matching key
@@ -116,6 +259,9 @@ struct PanelSlot {
   uint8_t slot;
 };
 
+struct EncodedRow;
+struct RecentRow;
+
 class TigoHistory {
  public:
   // RAII guard over the component-wide flash lock (see fs_mutex_ below).
@@ -141,13 +287,37 @@ class TigoHistory {
     bool held_;
   };
 
-  // Mounts LittleFS on the `tsdb` partition and opens system + panel DBs.
-  // Loads /tsdb/panel_map.json if present. Returns true on success.
+  // Lifecycle, as seen from other tasks. MOUNTING covers the window between
+  // start_writer_task() and the writer finishing init(): the queue already
+  // accepts snapshots, but nothing can be read yet.
+  enum State : uint8_t { STATE_OFF = 0, STATE_MOUNTING, STATE_READY, STATE_FAILED };
+
+  // Mounts LittleFS on the `tsdb` partition and opens system + panel DBs. Loads
+  // /tsdb/panel_map.json and the string/inverter maps if present. Returns true
+  // on success. Runs on the writer task (see start_writer_task); not called
+  // from setup any more.
   bool init();
 
-  // Spawns the dedicated FreeRTOS writer task. Must be called after init().
+  // Creates the queue and the flash lock and spawns the dedicated FreeRTOS
+  // writer task, which then runs init() before it drains anything. Returns as
+  // soon as the task exists — on a full 3 MB partition the mount alone takes
+  // seconds, and that no longer sits on the boot path. Snapshots enqueued
+  // meanwhile wait in the queue; initialized() turns true once the mount and
+  // the slot map load have finished.
   bool start_writer_task();
 
+  // Snapshots per flash commit, 1 (default) to kMaxGroupCommit. Set before
+  // start_writer_task().
+  void set_group_commit(uint32_t rows) { group_commit_ = std::max<uint32_t>(1, std::min(rows, kMaxGroupCommit)); }
+  uint32_t group_commit() const { return group_commit_; }
+  // `history_interval`, which sizes the recent-rows cache. Set before
+  // start_writer_task().
+  void set_snapshot_interval_min(uint32_t minutes) { snapshot_interval_min_ = std::max<uint32_t>(1, minutes); }
+  // Commits any rows held for a group commit now. Waits up to wait_ms for the
+  // writer to finish (0 = don't wait); returns false on timeout or a full
+  // queue. A no-op without group commit.
+  bool flush_pending(uint32_t wait_ms);
+
   // Look up (or assign) the slot for a panel barcode. Idempotent: subsequent
   // calls with the same key return the same slot. New assignments persist
   // panel_map.json synchronously. Returns 0xFF if the table is full.
@@ -156,6 +326,15 @@ class TigoHistory {
   // Read-only snapshot of current slot assignments (for the JSON API).
   std::vector<PanelSlot> snapshot_slot_map() const;
 
+  // Column of a string label or inverter name in its group's DB, assigned on
+  // first sight like get_or_assign_slot (map saved, DB opened lazily). Loop
+  // task only. Returns 0xFF if the group is full, the label cannot be stored,
+  // or the history is not ready.
+  uint8_t get_or_assign_series(SeriesGroup group, const std::string &label);
+  // Lookup only, safe from any task: 0xFF for a label never recorded.
+  uint8_t find_series(SeriesGroup group, const std::string &label);
+  std::vector<SeriesSlot> snapshot_series_map(SeriesGroup group);
+
   // Encode + push a snapshot onto the writer queue. Non-blocking; drops the
   // sample (with a (W) log) if the queue is full.
   void enqueue_snapshot(const SystemSnapshot &snap);
@@ -164,29 +343,69 @@ class TigoHistory {
   // receives (timestamp, total_p in watts, total_e_kwh × 100 — divide by 100).
   // Returns number of rows yielded, or -1 on error.
   // Runs synchronously on the caller's task — fine to invoke from an HTTP
-  // handler since esp_http_server runs on its own task.
+  // handler since esp_http_server runs on its own task. The callback runs
+  // with the flash lock or the recent-rows mutex held, for this and every
+  // iterate_* below: it must copy and return, never send or block.
   using PowerRowCb = std::function<void(uint32_t /*ts*/, int16_t /*total_p_w*/,
                                         int16_t /*total_e_kwh_x100*/)>;
   int iterate_power(uint32_t start_ts, uint32_t end_ts, const PowerRowCb &cb);
 
-  // Iterates a single panel's power series. Picks the right DB based on slot.
-  using PanelRowCb = std::function<void(uint32_t /*ts*/, int16_t /*power_w*/)>;
+  // Iterates a single panel's series for `metric`, reading only that
+  // family's DB for the slot. Values are the stored int16 — divide by
+  // panel_metric_scale(metric). -1 for a metric this build does not record.
+  using PanelRowCb = std::function<void(uint32_t /*ts*/, int16_t /*value*/)>;
   int iterate_panel(uint8_t slot, uint32_t start_ts, uint32_t end_ts,
-                    const PanelRowCb &cb);
-
-  bool initialized() const { return initialized_; }
+                    const PanelRowCb &cb, PanelMetric metric = PANEL_POWER);
+
+  // Iterates several panels' power series in one pass. Each panel DB holding a
+  // slot in `slot_mask` (bit n = slot n) is queried once with all 16 columns,
+  // under one FlashLock, and the DBs are merged by timestamp. The callback gets
+  // every slot's value indexed by slot (kMaxPanelSlots entries) and a mask of
+  // the slots that have one at this timestamp — a DB opened later than another
+  // has no rows before that. Returns rows yielded, or -1 on error.
+  using PanelsRowCb = std::function<void(uint32_t /*ts*/, const int16_t * /*values by slot*/,
+                                         const PanelSlotMask & /*present*/)>;
+  int iterate_panels(const PanelSlotMask &slot_mask, uint32_t start_ts, uint32_t end_ts, const PanelsRowCb &cb);
+
+  // Iterates one string's or inverter's series — a single-column read (two
+  // for an inverter) of its group DB. The callback gets power in watts and
+  // energy since the previous row in kWh × 100 (always 0 for a string).
+  // Returns rows yielded, or -1 on error or an unassigned column.
+  using SeriesRowCb = std::function<void(uint32_t /*ts*/, int16_t /*p_w*/, int16_t /*e_kwh_x100*/)>;
+  int iterate_series(SeriesGroup group, uint8_t column, uint32_t start_ts, uint32_t end_ts, const SeriesRowCb &cb);
+
+  // The coarsest tier whose bucket still fits `points` times into the window,
+  // falling back to finer tiers when a rollup DB is not open. A day at any
+  // budget stays raw; a year at the default budget reads daily rows.
+  HistoryTier pick_tier(uint32_t window_s, uint32_t points) const;
+
+  // Iterates the system power series at `tier`. Raw rows report avg = min =
+  // max. For a rollup tier, the part of the range the tier does not hold yet —
+  // older than its first bucket (e.g. history recorded before this firmware),
+  // or the bucket still accumulating — is folded from raw rows on the fly, so
+  // the result is the same series either way. Returns rows yielded, or -1.
+  using PowerTierCb = std::function<void(uint32_t /*ts*/, float /*p_avg_w*/, float /*p_min_w*/,
+                                         float /*p_max_w*/, float /*e_kwh*/)>;
+  int iterate_power_tier(HistoryTier tier, uint32_t start_ts, uint32_t end_ts, const PowerTierCb &cb);
+
+  bool initialized() const { return state_.load(std::memory_order_acquire) == STATE_READY; }
+  // True between start_writer_task() and the end of the background mount.
+  bool warming_up() const { return state_.load(std::memory_order_acquire) == STATE_MOUNTING; }
+  // "off" | "warming_up" | "ready" | "failed", for the JSON API.
+  const char *state_str() const;
 
   // Pause/resume the writer's flash writes around an OTA. Set true on OTA start
   // so the writer skips its littlefs writes (which otherwise collide with the
   // OTA image write on the same flash chip and fault); cleared on OTA abort.
   // Written from the OTA task, read from the writer task — hence atomic.
   //
-  // Setting it true BLOCKS until any in-flight commit has finished, and that is
-  // the whole point. The flag alone is advisory: the writer tests it once, then
-  // spends 10-21 s inside tsdb_write_h erasing and syncing. Raising the flag
-  // during that window changed nothing, so an OTA starting mid-commit wrote the
-  // app partition while the writer was still erasing the littlefs partition on
-  // the same chip — which faults:
+  // Setting it true BLOCKS until the in-flight commit phase has finished (the
+  // writer then stops at that phase boundary), and that is the whole point. The
+  // flag alone is advisory: the writer tests it once, then spends 10-21 s
+  // inside tsdb_write_h erasing and syncing. Raising the flag during that
+  // window changed nothing, so an OTA starting mid-commit wrote the app
+  // partition while the writer was still erasing the littlefs partition on the
+  // same chip — which faults:
   //
   //   tsdb_write_h -> tsdb_write_header -> fsync -> lfs_ctz_extend
   //     -> lfs_bd_erase -> esp_flash_erase_region -> esp_rom_delay_us  (Fault)
@@ -208,10 +427,11 @@ class TigoHistory {
   // Direct handle access for diagnostic endpoints (e.g. /api/tsdb/stats).
   // Caller must not close these — TigoHistory owns the lifecycle.
   tsdb_t *system_db() const { return system_db_; }
-  tsdb_t *panel_db(size_t idx) const {
-    return idx < kNumPanelDbs ? panel_db_[idx] : nullptr;
+  tsdb_t *panel_db(size_t idx, size_t family = 0) const {
+    return idx < kNumPanelDbs && family < kNumPanelFamilies ? panel_db_[family][idx] : nullptr;
   }
   size_t panel_db_count() const { return kNumPanelDbs; }
+  tsdb_t *series_db(SeriesGroup group) const { return group < kNumSeriesGroups ? series_db_[group] : nullptr; }
   size_t slot_count() const { return slot_map_.size(); }
   uint8_t next_free_slot() const { return next_free_slot_; }
 
@@ -239,12 +459,46 @@ class TigoHistory {
     size_t slot_count{0};
     uint8_t next_free_slot{0};
     Db system;
-    Db panels[kNumPanelDbs];
+    Db panels[kNumPanelFamilies][kNumPanelDbs];  // [0] = power
+    Db rollups[kNumRollupTiers];  // hourly, daily
+    Db series[kNumSeriesGroups];  // strings, inverters
+    size_t series_count[kNumSeriesGroups]{};  // columns assigned
   };
 
   // Thread-safe copy for HTTP handlers. Touches NO flash — that is the point.
   void copy_stats_snapshot(StatsSnapshot &out);
 
+  // File sizes init() planned from the `tsdb` partition (plan_file_sizes_ in
+  // the .cpp). Files created before keep the capacity in their header. Set
+  // once before initialized() turns true and constant after.
+  struct FileSizes {
+    size_t partition{0};
+    size_t system{0};
+    size_t panel{0};   // each power DB
+    size_t metric{0};  // each DB of an extra metric family
+    size_t rollup[kNumRollupTiers]{};
+    size_t series[kNumSeriesGroups]{};  // strings.tsdb, inverters.tsdb
+  };
+  const FileSizes &file_sizes() const { return sizes_; }
+
+  // Recent-rows cache occupancy and how many queries it answered, for
+  // /api/tsdb/stats. RAM only.
+  struct RecentCacheInfo {
+    size_t rows{0};
+    size_t capacity{0};   // 0 = no PSRAM, cache off
+    uint32_t floor_ts{0};  // queries starting after this are served from RAM
+    uint32_t hits{0};
+    uint32_t misses{0};
+  };
+  RecentCacheInfo recent_cache_info();
+
+  // Result-cache counters (tigo_query_cache.h), for /api/tsdb/stats.
+  HistoryQueryCache::Info query_cache_info() { return query_cache_.info(); }
+
+  // Thread-safe copy of every slot's degradation trend (tigo_trend.h), for
+  // /api/panels. RAM only, like copy_stats_snapshot.
+  void copy_trends(std::vector<PanelTrend> &out);
+
  private:
   static void writer_task_entry_(void *arg);
   void writer_task_loop_();
@@ -259,21 +513,38 @@ class TigoHistory {
   // ever called from a context that is already inside a flash batch, so it
   // adds no new flash access to the system — see StatsSnapshot above.
   void refresh_stats_snapshot_();
+  void plan_file_sizes_();
   bool init_system_db_();
-  // Opens panel_db_[idx] if not already open. Lazy: panel DBs only land on
-  // flash when the rig actually has a panel mapped into that 16-slot range.
+  // Opens stripe `idx` of every enabled family (panel_db_[f][idx]) if not
+  // already open. Lazy: panel DBs only land on flash when the rig actually has
+  // a panel mapped into that 16-slot range. Returns whether power's opened.
   bool open_panel_db_(size_t idx);
+  bool open_panel_family_db_(size_t family, size_t idx);
   bool load_slot_map_();
   bool save_slot_map_();
-
-  bool initialized_{false};
+  // strings.tsdb / inverters.tsdb, opened on the group's first assignment.
+  bool open_series_db_(SeriesGroup group);
+  // string_map.json / inverter_map.json, same format as panel_map.json.
+  // CALLER MUST HOLD FlashLock.
+  bool load_series_map_(SeriesGroup group);
+  bool save_series_map_(SeriesGroup group);
+  // panel_trend.bin beside panel_map.json. CALLER MUST HOLD FlashLock.
+  bool load_trends_();
+  bool save_trends_();
+
+  // Written by the writer task (init) and flush_and_close, read from every
+  // task. READY is stored with release after the slot map and trends are
+  // loaded, so a reader that sees it also sees them.
+  std::atomic<uint8_t> state_{STATE_OFF};
   // True while an OTA is running — makes the writer task skip flash writes.
   std::atomic<bool> ota_active_{false};
   // Per-instance handles from the v2.1 multi-DB API. system_db_ holds the
-  // 14-param rollups; panel_db_[i] each hold 16 panel powers. Striping across
-  // multiple panel DBs sidesteps esp_tsdb's 16-base-param limit.
+  // 14-param rollups; panel_db_[f][i] each hold 16 panels' values of family
+  // f (0 = power). Striping across multiple panel DBs sidesteps esp_tsdb's
+  // 16-base-param limit.
   tsdb_t *system_db_{nullptr};
-  tsdb_t *panel_db_[kNumPanelDbs] = {};
+  tsdb_t *panel_db_[kNumPanelFamilies][kNumPanelDbs] = {};
+  FileSizes sizes_;
 
   // Written by refresh_stats_snapshot_() (writer/loop task, under FlashLock),
   // read by HTTP handlers via copy_stats_snapshot(). stats_mutex_ guards only
@@ -290,6 +561,122 @@ class TigoHistory {
   // their position in history forever.
   uint8_t next_free_slot_{0};
 
+  // String and inverter columns, one map per SeriesGroup. Assigned on the
+  // loop task but looked up by the history worker for /api/history/string,
+  // so series_mutex_ guards the maps — never flash, which the assignment
+  // takes FlashLock for separately, as get_or_assign_slot does.
+  struct SeriesMap {
+    std::unordered_map<std::string, uint8_t> columns;
+    std::string labels[kSeriesDbColumns];  // column -> label, empty = free
+    uint8_t next_free{0};
+  };
+  SeriesMap series_maps_[kNumSeriesGroups];
+  std::mutex series_mutex_;
+  tsdb_t *series_db_[kNumSeriesGroups] = {};
+
+  // Degradation trend per slot. Fed by enqueue_snapshot() on the loop task,
+  // saved by the writer task inside its flash batch, read by HTTP handlers —
+  // trend_mutex_ guards the array only, never flash (same split as stats_).
+  PanelTrend trends_[kMaxPanelSlots];
+  std::mutex trend_mutex_;
+  uint32_t last_trend_save_ts_{0};
+  // Rollup accumulation for one bucket of one tier. The writer's copies are
+  // only touched on the writer task; queries fold their own.
+  struct RollupAcc {
+    uint32_t bucket{0};
+    uint32_t n{0};
+    float p_min{0.0f};
+    float p_max{0.0f};
+    double p_sum{0.0};
+    double e_kwh{0.0};
+    void start(uint32_t b) {
+      bucket = b;
+      n = 0;
+      p_sum = 0.0;
+      e_kwh = 0.0;
+    }
+    void add(float p, float e) {
+      if (n == 0 || p < p_min) p_min = p;
+      if (n == 0 || p > p_max) p_max = p;
+      p_sum += p;
+      e_kwh += e;
+      n++;
+    }
+  };
+  // Start of the tier's bucket holding `ts`: the UTC hour, or local midnight
+  // (TZ as set by the time component) so a day's bar is a solar day.
+  static uint32_t rollup_bucket_(size_t tier_idx, uint32_t ts);
+  static uint32_t rollup_next_bucket_(size_t tier_idx, uint32_t bucket);
+  bool init_rollup_dbs_();
+  // Re-folds the newest raw rows into rollup_acc_ after a reboot, so the
+  // bucket that was accumulating is not cut short. CALLER MUST HOLD FlashLock.
+  void rebuild_rollups_();
+  // Writer task, inside its FlashLock batch.
+  void fold_rollups_(uint32_t ts, float p_w, float e_kwh);
+  // Folds raw rows in [start_ts, end_ts] into `tier_idx` buckets through
+  // `acc`, emitting each bucket the range closes; the last one stays in `acc`.
+  // Returns raw rows read, or -1. CALLER MUST HOLD FlashLock.
+  int fold_raw_range_(size_t tier_idx, uint32_t start_ts, uint32_t end_ts, RollupAcc &acc,
+                      const PowerTierCb &cb);
+
+  tsdb_t *rollup_db_[kNumRollupTiers] = {};
+  RollupAcc rollup_acc_[kNumRollupTiers];
+  // Bucket start of the oldest / newest row each rollup DB holds (0 = empty).
+  // Set at init and refreshed with the stats snapshot; read by queries.
+  std::atomic<uint32_t> rollup_first_ts_[kNumRollupTiers] = {};
+  std::atomic<uint32_t> rollup_last_ts_[kNumRollupTiers] = {};
+
+  // Write-behind cache of the newest rows, in PSRAM. Most history traffic is
+  // the day chart, and every row it wants was written by this process within
+  // the last day. The writer copies each row here after its flash batch; a
+  // query whose window starts after recent_floor_ts_ is answered from the ring
+  // without taking FlashLock — so it can neither wait out a 21 s commit nor
+  // overlap one, which is the collision behind kFsLockReaderWaitMs and the
+  // flash faults documented on fs_mutex_. Anything older reads flash as before.
+  //
+  // recent_floor_ts_ is the newest row on flash at boot, raised to each row
+  // the ring overwrites, so every row after it is known to be in the ring.
+  // UINT32_MAX until init() sets it. recent_mutex_ guards the ring only and is
+  // held while a RAM-served query runs its callback (as FlashLock is for a
+  // flash one); the writer takes it after releasing FlashLock.
+  void recent_push_(const EncodedRow &row, uint64_t written);
+  // Calls fn(const RecentRow &) oldest-first for each cached row in
+  // [start_ts, end_ts], or returns false without calling it if the window
+  // reaches back past the floor. CALLER MUST HOLD recent_mutex_.
+  template<typename Fn> bool recent_for_each_(uint32_t start_ts, uint32_t end_ts, Fn &&fn);
+  RecentRow *recent_rows_{nullptr};
+  size_t recent_capacity_{0};  // rows; set with the allocation, fixed after
+  uint32_t snapshot_interval_min_{kDefaultSnapshotIntervalMin};
+  size_t recent_head_{0};
+  size_t recent_count_{0};
+  uint32_t recent_floor_ts_{UINT32_MAX};
+  std::mutex recent_mutex_;
+  std::atomic<uint32_t> recent_hits_{0};
+  std::atomic<uint32_t> recent_misses_{0};
+
+  // True when a window starting at start_ts would be served from the ring.
+  bool recent_covers_(uint32_t start_ts);
+
+  // The flash (or ring) reads behind iterate_power_tier / iterate_panel,
+  // which put query_cache_ in front of them.
+  int iterate_power_tier_uncached_(HistoryTier tier, uint32_t start_ts, uint32_t end_ts, const PowerTierCb &cb);
+  int iterate_panel_uncached_(uint8_t slot, size_t family, uint32_t start_ts, uint32_t end_ts,
+                              const PanelRowCb &cb);
+  int iterate_series_uncached_(SeriesGroup group, uint8_t column, uint32_t start_ts, uint32_t end_ts,
+                               const SeriesRowCb &cb);
+  // Repeat and concurrent history queries share one read (tigo_query_cache.h).
+  // Entries are valid for one commit generation: the writer bumps commit_gen_
+  // after every batch that wrote a row, having first stored that row's time in
+  // newest_commit_ts_.
+  HistoryQueryCache query_cache_;
+  std::atomic<uint32_t> commit_gen_{0};
+  std::atomic<uint32_t> newest_commit_ts_{0};
+
+  // Staging copy for load_trends_/save_trends_, so file I/O never runs under
+  // trend_mutex_ and 2.3 KB stays off the writer and loop stacks. Only
+  // touched under FlashLock.
+  PanelTrend trend_io_[kMaxPanelSlots];
+
   // Serializes EVERY littlefs/SPI-flash access this component makes, across all
   // three tasks that reach flash: the writer task (tsdb_write_h + journal
   // commit), the ESPHome loop task (slot assignment -> tsdb_open +
@@ -313,6 +700,19 @@ class TigoHistory {
   // A month-range history query holds the bus for ~2.3 s, so an open web UI
   // reliably overlaps the snapshot commit.
   SemaphoreHandle_t fs_mutex_{nullptr};
+  // Group commit (see kMaxGroupCommit). pending_rows_ holds group_commit_
+  // rows and is only touched by the writer task; flush_done_ acknowledges a
+  // flush_pending() request.
+  void commit_rows_(const EncodedRow *rows, size_t n);
+  uint32_t group_commit_{1};
+  EncodedRow *pending_rows_{nullptr};
+  size_t pending_count_{0};
+  SemaphoreHandle_t flush_done_{nullptr};
+
+  // Tasks other than the writer currently blocked in FlashLock. The writer
+  // commits in phases and lets these in between them.
+  std::atomic<uint32_t> flash_waiters_{0};
+  void yield_to_flash_waiters_();
 
   QueueHandle_t queue_{nullptr};
   TaskHandle_t task_{nullptr};
@@ -27,6 +27,10 @@ namespace tigo_monitor {
 
 static const char *const TAG = "tigo_monitor";
 
+// With no power frame by then (night, or a disconnected bus), deferred_init_()
+// runs anyway.
+static const uint32_t kDeferredInitTimeoutMs = 5000;
+
 #ifdef USE_ESP_IDF
 // Helper function to allocate from PSRAM if available, falls back to regular heap.
 //
@@ -251,6 +255,7 @@ void TigoMonitorComponent::setup() {
   // environmental reset (brownout) from a firmware one (panic, task_wdt) —
   // see reset_reason_str() for why /api/status carries this too.
   ESP_LOGI(TAG, "Reset reason: %s", reset_reason_str());
+  boot_mark("setup_start");
 
   // Every cJSON_Parse from here on allocates from PSRAM (node import, CCA sync, cloud layout).
   tigo_cjson_use_psram();
@@ -264,13 +269,9 @@ void TigoMonitorComponent::setup() {
   }
 #endif
 
-#ifdef USE_TIGO_CLOUD
-  // Restore any persisted Tigo cloud token so the import works after a reboot.
-  tigo_cloud_load_creds();
-#endif
-
   // Capture the YAML-provided config as defaults, then overlay any user overrides from NVS.
   tigo_config_load();
+  boot_mark("config");
 
 #ifdef USE_ESP_IDF
   // Log PSRAM availability
@@ -285,6 +286,12 @@ void TigoMonitorComponent::setup() {
     // and fit the internal heap comfortably. The web server is what needs PSRAM.
     ESP_LOGI(TAG, "No PSRAM - using internal heap for device/node storage (%zu KB free)",
              heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024);
+    // The recent-sample rings are PSRAM-only (see tigo_recent.h); switch them
+    // off once here rather than failing an allocation per device.
+    if (recent_samples_ > 0) {
+      ESP_LOGI(TAG, "No PSRAM - frame-rate recent history (/api/recent) disabled");
+      recent_samples_ = 0;
+    }
   }
 #endif
 
@@ -312,30 +319,16 @@ void TigoMonitorComponent::setup() {
 #endif
   
   load_node_table();
+  boot_mark("node_table");
   load_energy_data();
   load_daily_energy_history();
+  boot_mark("energy");
+  warm_start_restore_();
+  boot_mark("warm_start");
 
-#ifdef TIGO_TSDB_AVAILABLE
-  // Open the time-series database. Mounts LittleFS on the `tsdb` partition
-  // and creates system.tsdb if absent. On success, start the writer task and
-  // schedule the snapshot interval.
-  //
-  // Cadence comes from `history_interval` (default kDefaultSnapshotIntervalMin);
-  // tigo_history.h documents what lowering it costs in flash wear and in the
-  // odds of a history request colliding with a ~21 s commit.
-  if (history_.init() && history_.start_writer_task()) {
-    last_snapshot_total_e_kwh_ = total_energy_in_kwh_;
-    for (size_t i = 0; i < 4; ++i)
-      last_snapshot_inv_e_kwh_[i] = (i < inverters_.size()) ? inverters_[i].total_energy : 0.0f;
-    last_snapshot_frames_lost_ = missed_frame_count_;
-    this->set_interval("tsdb_snapshot", snapshot_interval_min_ * 60UL * 1000UL,
-                       [this]() { this->snapshot_to_history_(); });
-    ESP_LOGI(TAG, "tsdb snapshot interval armed (every %lu min)",
-             (unsigned long) snapshot_interval_min_);
-  } else {
-    ESP_LOGW(TAG, "Time-series history disabled — sensor data still publishes normally");
-  }
-#endif
+  // The TSDB mount and open, the cloud credential read and the CCA sync used
+  // to run here, ahead of the first UART byte; they now wait for
+  // deferred_init_() so ingest starts as soon as setup() returns.
   
   // Check if we have existing CCA data and rebuild string groups
   bool has_cca_data = false;
@@ -358,6 +351,8 @@ void TigoMonitorComponent::setup() {
   } else {
     ESP_LOGI(TAG, "No CCA data found in node table - UI will show barcodes until CCA sync occurs");
   }
+  warm_start_restore_rollups_();
+  boot_mark("strings");
   
   // Initialize night mode tracking
   last_data_received_ = millis();
@@ -376,15 +371,67 @@ void TigoMonitorComponent::setup() {
   if (missed_frame_sensor_ != nullptr) {
     missed_frame_sensor_->publish_state(0);
   }
-  
+
+  setup_done_ms_ = millis();
+  boot_mark("setup_done");
+}
+
+void TigoMonitorComponent::deferred_init_() {
+  deferred_init_done_ = true;
+
+#ifdef USE_TIGO_CLOUD
+  // Restore any persisted Tigo cloud token so the import works after a reboot.
+  // Only the cloud import and its status page read it.
+  tigo_cloud_load_creds();
+#endif
+
+#ifdef TIGO_TSDB_AVAILABLE
+  // Start the time-series writer. The task itself mounts LittleFS on the
+  // `tsdb` partition and opens system.tsdb, so nothing here waits on flash;
+  // the snapshot interval is armed straight away and any snapshot taken
+  // before the mount finishes waits in the writer queue. Meanwhile the
+  // history endpoints answer 503 "warming_up", and if the mount fails they
+  // keep answering 503 as they do with no partition.
+  //
+  // The cadence is `history_interval` (default kDefaultSnapshotIntervalMin);
+  // tigo_history.h documents what lowering it costs in flash wear and in the
+  // odds of a history request colliding with a ~21 s commit.
+  history_.set_group_commit(history_group_commit_);
+  history_.set_snapshot_interval_min(snapshot_interval_min_);
+  if (history_.start_writer_task()) {
+    last_snapshot_total_e_kwh_ = total_energy_in_kwh_;
+    for (size_t i = 0; i < 4; ++i)
+      last_snapshot_inv_e_kwh_[i] = (i < inverters_.size()) ? inverters_[i].total_energy : 0.0;
+    last_snapshot_frames_lost_ = missed_frame_count_;
+    this->set_interval("tsdb_snapshot", snapshot_interval_min_ * 60UL * 1000UL,
+                       [this]() { this->snapshot_to_history_(); });
+    ESP_LOGI(TAG, "tsdb snapshot interval armed (every %lu min)",
+             (unsigned long) snapshot_interval_min_);
+  } else {
+    ESP_LOGW(TAG, "Time-series history disabled — sensor data still publishes normally");
+  }
+  boot_mark("tsdb");
+#endif
+
   // Query CCA on boot if IP is configured and sync_cca_on_startup is enabled
   if (!cca_ip_.empty() && sync_cca_on_startup_) {
     ESP_LOGI(TAG, "CCA IP configured: %s - will sync configuration on boot", cca_ip_.c_str());
-    // Delay sync to allow WiFi to connect and stabilize (15 seconds after setup)
+    // Delay sync to allow WiFi to connect and stabilize (15 seconds from here)
     this->set_timeout("cca_sync", 15000, [this]() { this->sync_from_cca(); });
   } else if (!cca_ip_.empty() && !sync_cca_on_startup_) {
     ESP_LOGI(TAG, "CCA IP configured: %s - automatic sync disabled (use 'Sync from CCA' button)", cca_ip_.c_str());
   }
+  boot_.deferred_done_us = micros();
+}
+
+void TigoMonitorComponent::boot_mark(const char *phase) {
+  StateLock lock(state_mutex_);
+  if (boot_.count < BootTimeline::kMaxPhases) boot_.phases[boot_.count++] = {phase, micros()};
+}
+
+void TigoMonitorComponent::snapshot_boot_timeline(BootTimeline &out) const {
+  StateLock lock(state_mutex_);
+  out = boot_;
 }
   
 
@@ -412,7 +459,13 @@ psram_vector<InverterData> TigoMonitorComponent::snapshot_inverters() const {
 
 void TigoMonitorComponent::loop() {
   StateLock lock(state_mutex_);
+  if (boot_.first_loop_us == 0) boot_.first_loop_us = micros();
   process_serial_data();
+  persist_commit_(false);
+  if (!deferred_init_done_ &&
+      (boot_.first_frame_us != 0 || millis() - setup_done_ms_ >= kDeferredInitTimeoutMs)) {
+    deferred_init_();
+  }
   
 #ifdef USE_ESP_IDF
   // Periodic heap and stack monitoring (every 60 seconds) to detect memory leaks/stack issues
@@ -496,6 +549,7 @@ void TigoMonitorComponent::update() {
   check_midnight_reset();
   mark_stale_devices_();
   publish_sensor_data();
+  warm_start_store_();
 }
 
 void TigoMonitorComponent::mark_stale_devices_() {
@@ -533,6 +587,9 @@ void TigoMonitorComponent::dump_config() {
 
 void TigoMonitorComponent::on_shutdown() {
   ESP_LOGI(TAG, "System shutdown detected - saving persistent data to flash...");
+  // Energy integrated since the last update() would otherwise be lost even
+  // across a soft restart.
+  warm_start_store_();
   save_persistent_data();
 #ifdef TIGO_TSDB_AVAILABLE
   history_.flush_and_close();
@@ -591,6 +648,8 @@ void TigoMonitorComponent::process_serial_data() {
   size_t bytes_processed = 0;
 #endif
   
+  if (boot_.first_byte_us == 0 && available()) boot_.first_byte_us = micros();
+
   while (available()) {
 #ifdef USE_ESP_IDF
     // Yield to watchdog if we've processed too much data
@@ -1052,6 +1111,7 @@ void TigoMonitorComponent::process_27_frame(const frame_string &hex_frame, size_
       // Update existing node with Frame 27 long address
       if (node->long_address != long_addr) {
         node->long_address = long_addr;
+        barcode_index_dirty_ = true;
         ESP_LOGD(TAG, "Updated Frame 27 long address for node %s: %s", addr.c_str(), long_addr.c_str());
         table_changed = true;
       }
@@ -1067,6 +1127,7 @@ void TigoMonitorComponent::process_27_frame(const frame_string &hex_frame, size_
         new_node.sensor_index = -1;  // Will be assigned when device becomes active
         new_node.is_persistent = true;
         node_table_.push_back(new_node);
+        barcode_index_dirty_ = true;
         ESP_LOGI(TAG, "Created new node entry for Frame 27: addr=%s, long_addr=%s (table size now %zu)", 
                  addr.c_str(), long_addr.c_str(), node_table_.size());
         table_changed = true;
@@ -1101,7 +1162,9 @@ void TigoMonitorComponent::process_27_frame(const frame_string &hex_frame, size_
       for (auto dev_it = devices_.begin(); dev_it != devices_.end(); ++dev_it) {
         if (dev_it->addr == dup.addr) { devices_.erase(dev_it); break; }
       }
+      recent_rings_.erase(dup.addr);
       node_table_.erase(node_table_.begin() + di);
+      barcode_index_dirty_ = true;
       --di;
       table_changed = true;
       dedup_merged = true;
@@ -1156,6 +1219,7 @@ void TigoMonitorComponent::update_device_data(const DeviceData &data) {
   
   // Track when data is received
   last_data_received_ = millis();
+  if (boot_.first_frame_us == 0) boot_.first_frame_us = micros();
   if (in_night_mode_) {
     ESP_LOGI(TAG, "Exiting night mode - data received from %s", data.addr.c_str());
     in_night_mode_ = false;
@@ -1167,10 +1231,51 @@ void TigoMonitorComponent::update_device_data(const DeviceData &data) {
   // Find existing device or add new one
   DeviceData *device = find_device_by_addr(data.addr);
   if (device != nullptr) {
-    // Preserve peak_power when updating device data
+    // Preserve peak_power and the energy accumulators when updating device data
     float saved_peak_power = device->peak_power;
+    double saved_energy_in = device->energy_in_kwh;
+    double saved_energy_out = device->energy_out_kwh;
+    PanelHealth saved_health = device->health;
+    uint32_t saved_peer_window = device->peer_window;
+    unsigned long prev_update = device->last_update;
+    float prev_power_in = device->power_in;
+    float prev_power_out = device->power_out;
     *device = data;
     device->peak_power = saved_peak_power;
+    device->energy_in_kwh = saved_energy_in;
+    device->energy_out_kwh = saved_energy_out;
+    device->health = saved_health;
+    device->peer_window = saved_peer_window;
+
+    // Trapezoidal step between the previous frame and this one, timed by frame
+    // arrival rather than by publish_sensor_data(), so a late or jittery
+    // update() cannot stretch or shrink the integration window. A device marked
+    // stale went at least the configured stale_timeout without a frame. With
+    // the default 10 minutes that gap is past MAX_ENERGY_GAP_MS and nothing is
+    // integrated across it; with a shorter stale_timeout the gap may still be
+    // integrated, but mark_stale_devices_() zeroed the previous power, so the
+    // step ramps up from zero instead of bridging with the last-seen value.
+    StringData *string = string_for_device_(data.addr);
+    unsigned long dt_ms = data.last_update - prev_update;
+    if (prev_update > 0 && dt_ms > 0 && dt_ms <= MAX_ENERGY_GAP_MS) {
+      double dt_h = dt_ms / 3600000.0;
+      double in_kwh = 0.5 * (prev_power_in + data.power_in) * dt_h / 1000.0;
+      double out_kwh = 0.5 * (prev_power_out + data.power_out) * dt_h / 1000.0;
+      accumulate_frame_energy_(*device, string, in_kwh, out_kwh);
+    }
+    if (string != nullptr) {
+      string->power_sketch.add(data.power_out);
+      string->voltage_sketch.add(data.voltage_in);
+      string->temperature_sketch.add(data.temperature);
+    }
+    array_power_sketch_.add(data.power_out);
+    if (device->peer_window != peer_window_) {
+      device->peer_window = peer_window_;
+      if (string != nullptr && string->window_panels < UINT16_MAX) string->window_panels++;
+      if (array_window_panels_ < UINT16_MAX) array_window_panels_++;
+    }
+    update_panel_health_(*device, string);
+    record_recent_sample_(*device);
     ESP_LOGD(TAG, "Updated existing device: %s (preserved peak: %.0fW)", data.addr.c_str(), saved_peak_power);
   } else if (devices_.size() < number_of_devices_) {
     devices_.push_back(data);
@@ -1181,12 +1286,12 @@ void TigoMonitorComponent::update_device_data(const DeviceData &data) {
     DeviceData* new_device = &devices_.back();
     std::string pref_key = "peak_" + to_std_string(data.addr);
     uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto load = this->cached_pref_<float>(hash);
     float saved_peak = 0.0f;
-    if (load.load(&saved_peak) && saved_peak > 0.0f) {
+    if (this->persist_load_(hash, pref_key.c_str(), &saved_peak) && saved_peak > 0.0f) {
       new_device->peak_power = saved_peak;
       ESP_LOGI(TAG, "Restored peak power for %s: %.0fW", data.addr.c_str(), saved_peak);
     }
+    record_recent_sample_(*new_device);
     
     // Track device discovery for node table management
     if (created_devices_.find(data.addr) == created_devices_.end()) {
@@ -1226,6 +1331,100 @@ void TigoMonitorComponent::update_device_data(const DeviceData &data) {
   }
 }
 
+StringData *TigoMonitorComponent::string_for_device_(const node_string &addr) {
+  // Membership comes from the node table, which rebuild_string_groups() also
+  // groups by, so a device with no CCA string label belongs to no string.
+  NodeTableData *node = find_node_by_addr(addr);
+  if (node == nullptr || node->cca_string_label.empty()) return nullptr;
+  auto it = strings_.find(node->cca_string_label);
+  return (it == strings_.end()) ? nullptr : &it->second;
+}
+
+void TigoMonitorComponent::update_panel_health_(DeviceData &device, const StringData *string) {
+  // A string median needs peers to mean anything; with fewer than
+  // kMinPeerPanels distinct panels reporting in the last window, fall back to
+  // the whole array. Counting frames instead would let one panel that sent
+  // three frames be its own reference.
+  float reference = NAN;
+  HealthReference source = HealthReference::NONE;
+  if (string != nullptr && string->reporting_panels >= kMinPeerPanels) {
+    reference = string->power_quartiles.median;
+    source = HealthReference::STRING;
+  } else if (array_reporting_panels_ >= kMinPeerPanels) {
+    reference = array_power_quartiles_.median;
+    source = HealthReference::ARRAY;
+  }
+
+  if (!update_panel_health(device.health, health_params_, device.last_update, device.power_out,
+                           reference, source))
+    return;
+  if (device.health.alerting) {
+    ESP_LOGW(TAG, "Panel %s underperforming: %.0f%% of %s median for %lu min", device.addr.c_str(),
+             device.health.ratio * 100.0f, health_reference_str(device.health.reference),
+             (unsigned long) ((device.last_update - device.health.below_since_ms) / 60000));
+  } else {
+    ESP_LOGI(TAG, "Panel %s recovered: %.0f%% of %s median", device.addr.c_str(),
+             device.health.ratio * 100.0f, health_reference_str(device.health.reference));
+  }
+}
+
+void TigoMonitorComponent::accumulate_frame_energy_(DeviceData &device, StringData *string,
+                                                    double in_kwh, double out_kwh) {
+  if (in_kwh <= 0.0 && out_kwh <= 0.0) return;
+
+  device.energy_in_kwh += in_kwh;
+  device.energy_out_kwh += out_kwh;
+  pending_energy_in_kwh_ += in_kwh;
+  pending_energy_out_kwh_ += out_kwh;
+
+  // Roll the same step up into the device's string and that string's
+  // inverter. A device outside any string only counts toward the system total.
+  if (string == nullptr) return;
+  string->total_energy += out_kwh;
+
+  for (auto &inverter : inverters_) {
+    for (const auto &mppt_label : inverter.mppt_labels) {
+      if (mppt_label == string->inverter_label) {
+        inverter.total_energy += out_kwh;
+        return;
+      }
+    }
+  }
+}
+
+void TigoMonitorComponent::record_recent_sample_(const DeviceData &device) {
+  if (recent_samples_ == 0) return;
+  auto it = recent_rings_.find(device.addr);
+  if (it == recent_rings_.end()) {
+    // Allocated on first frame rather than at setup: number_of_devices is a
+    // ceiling, and most installs run well under it.
+    RecentRing ring;
+    if (!ring.init(recent_samples_)) {
+      ESP_LOGW(TAG, "No PSRAM for %u recent samples of %s - recent history off for this device",
+               (unsigned) recent_samples_, device.addr.c_str());
+    }
+    // Kept even when disabled, so the allocation isn't retried on every frame.
+    it = recent_rings_.emplace(device.addr, std::move(ring)).first;
+  }
+  it->second.push((uint32_t) device.last_update, device.power_in, device.voltage_in,
+                  device.current_in, device.temperature);
+}
+
+bool TigoMonitorComponent::copy_recent_samples(const std::string &addr, uint32_t window_ms,
+                                               node_vector<RecentPoint> &out, uint32_t &now_ms,
+                                               size_t &capacity) const {
+  StateLock lock(state_mutex_);
+  now_ms = millis();
+  capacity = recent_samples_;
+  out.clear();
+  auto it = recent_rings_.find(to_node_string(addr));
+  if (it == recent_rings_.end()) return false;
+  const RecentRing &ring = it->second;
+  out.reserve(ring.size());
+  ring.for_each_since(now_ms - window_ms, [&](const RecentPoint &p) { out.push_back(p); });
+  return true;
+}
+
 DeviceData* TigoMonitorComponent::find_device_by_addr(const node_string &addr) {
   for (auto &device : devices_) {
     if (device.addr == addr) {
@@ -1250,10 +1449,12 @@ void TigoMonitorComponent::rebuild_string_groups() {
   }
   ESP_LOGI(TAG, "%d nodes have CCA validation", cca_validated_count);
   
-  // Clear existing string data but preserve peak power
+  // Clear existing string data but preserve peak power and energy
   std::map<node_string, float> saved_peaks;
+  std::map<node_string, double> saved_energy;
   for (const auto &pair : strings_) {
     saved_peaks[pair.first] = pair.second.peak_power;
+    saved_energy[pair.first] = pair.second.total_energy;
   }
   strings_.clear();
   
@@ -1275,9 +1476,8 @@ void TigoMonitorComponent::rebuild_string_groups() {
         char pref_key[80];
         snprintf(pref_key, sizeof(pref_key), "str_dn:%s", string_label.c_str());
         uint32_t hash = esphome::fnv1_hash(pref_key);
-        auto pref = this->cached_pref_<char[64]>(hash);
         char dn_buf[64] = {};
-        if (pref.load(&dn_buf) && dn_buf[0] != '\0') {
+        if (this->persist_load_(hash, pref_key, &dn_buf) && dn_buf[0] != '\0') {
           string_data.display_label = dn_buf;
         }
 
@@ -1285,9 +1485,8 @@ void TigoMonitorComponent::rebuild_string_groups() {
         // stored as uint16. 0 means "not set" → UI ignores it.
         snprintf(pref_key, sizeof(pref_key), "str_rt:%s", string_label.c_str());
         uint32_t rt_hash = esphome::fnv1_hash(pref_key);
-        auto rt_pref = this->cached_pref_<uint16_t>(rt_hash);
         uint16_t rt_val = 0;
-        if (rt_pref.load(&rt_val) && rt_val > 0) {
+        if (this->persist_load_(rt_hash, pref_key, &rt_val) && rt_val > 0) {
           string_data.panel_rating_w = rt_val;
         }
 
@@ -1297,6 +1496,9 @@ void TigoMonitorComponent::rebuild_string_groups() {
         if (saved_peaks.count(string_label) > 0) {
           strings_[string_label].peak_power = saved_peaks[string_label];
         }
+        if (saved_energy.count(string_label) > 0) {
+          strings_[string_label].total_energy = saved_energy[string_label];
+        }
 
         if (string_data.display_label.empty()) {
           ESP_LOGI(TAG, "Created string group: %s (Inverter: %s)",
@@ -1321,6 +1523,17 @@ void TigoMonitorComponent::rebuild_string_groups() {
 }
 
 void TigoMonitorComponent::update_string_data() {
+  // Array-wide window for panels outside any string (update_panel_health_).
+  array_power_quartiles_ = array_power_sketch_.summary();
+  array_power_sketch_.reset();
+  array_reporting_panels_ = array_window_panels_;
+  array_window_panels_ = 0;
+  for (auto &pair : strings_) {
+    pair.second.reporting_panels = pair.second.window_panels;
+    pair.second.window_panels = 0;
+  }
+  peer_window_++;
+
   if (strings_.empty()) {
     return;  // No string groups configured
   }
@@ -1388,6 +1601,14 @@ void TigoMonitorComponent::update_string_data() {
       string_data.max_efficiency = 0.0f;
     }
 
+    // Publish this window's quartiles and start the next one (tigo_quantile.h).
+    string_data.power_quartiles = string_data.power_sketch.summary();
+    string_data.voltage_quartiles = string_data.voltage_sketch.summary();
+    string_data.temperature_quartiles = string_data.temperature_sketch.summary();
+    string_data.power_sketch.reset();
+    string_data.voltage_sketch.reset();
+    string_data.temperature_sketch.reset();
+
     // Publish the per-string power sensor, if one is configured for this
     // label. total_power was freshly aggregated above (0 with no active
     // devices), so HA stays in lockstep with the web UI.
@@ -1411,9 +1632,8 @@ void TigoMonitorComponent::add_inverter(const std::string &name, const std::vect
   char pref_key[80];
   snprintf(pref_key, sizeof(pref_key), "inv_dn:%s", name.c_str());
   uint32_t hash = esphome::fnv1_hash(pref_key);
-  auto pref = this->cached_pref_<char[64]>(hash);
   char dn_buf[64] = {};
-  if (pref.load(&dn_buf) && dn_buf[0] != '\0') {
+  if (this->persist_load_(hash, pref_key, &dn_buf) && dn_buf[0] != '\0') {
     inverter.display_name = dn_buf;
     ESP_LOGCONFIG(TAG, "Loaded display name '%s' for inverter '%s'", dn_buf, name.c_str());
   }
@@ -1436,11 +1656,10 @@ bool TigoMonitorComponent::set_inverter_display_name(const std::string &canonica
     char pref_key[80];
     snprintf(pref_key, sizeof(pref_key), "inv_dn:%s", canonical.c_str());
     uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto pref = this->cached_pref_<char[64]>(hash);
     char dn_buf[64] = {};
     // Truncate at 63 chars; UI enforces a similar limit but be defensive.
     strncpy(dn_buf, display_name.c_str(), sizeof(dn_buf) - 1);
-    pref.save(&dn_buf);
+    this->persist_save_(hash, pref_key, dn_buf, kPersistNowMs);
     ESP_LOGI(TAG, "Renamed inverter '%s' -> '%s' (saved to NVS)",
              canonical.c_str(), display_name.c_str());
     return true;
@@ -1461,8 +1680,7 @@ bool TigoMonitorComponent::set_string_panel_rating(const std::string &canonical,
   char pref_key[80];
   snprintf(pref_key, sizeof(pref_key), "str_rt:%s", canonical.c_str());
   uint32_t hash = esphome::fnv1_hash(pref_key);
-  auto pref = this->cached_pref_<uint16_t>(hash);
-  pref.save(&rating_w);
+  this->persist_save_(hash, pref_key, rating_w, kPersistNowMs);
   ESP_LOGI(TAG, "Set panel rating for string '%s' = %u W (saved to NVS)",
            canonical.c_str(), (unsigned) rating_w);
   return true;
@@ -1480,21 +1698,20 @@ bool TigoMonitorComponent::set_string_display_label(const std::string &canonical
   char pref_key[80];
   snprintf(pref_key, sizeof(pref_key), "str_dn:%s", canonical.c_str());
   uint32_t hash = esphome::fnv1_hash(pref_key);
-  auto pref = this->cached_pref_<char[64]>(hash);
   char dn_buf[64] = {};
   strncpy(dn_buf, display_label.c_str(), sizeof(dn_buf) - 1);
-  pref.save(&dn_buf);
+  this->persist_save_(hash, pref_key, dn_buf, kPersistNowMs);
   ESP_LOGI(TAG, "Renamed string '%s' -> '%s' (saved to NVS)",
            canonical.c_str(), display_label.c_str());
   return true;
 }
 
 void TigoMonitorComponent::update_inverter_data() {
-  // Reset all inverter aggregates
+  // Reset all inverter aggregates. total_energy is deliberately left alone: it
+  // accumulates per frame in accumulate_frame_energy_(), not here.
   for (auto &inverter : inverters_) {
     inverter.total_power = 0.0f;
     inverter.peak_power = 0.0f;
-    inverter.total_energy = 0.0f;
     inverter.active_device_count = 0;
     inverter.total_device_count = 0;
   }
@@ -1523,6 +1740,22 @@ void TigoMonitorComponent::update_inverter_data() {
   }
 }
 
+void TigoMonitorComponent::apply_frame_energy_() {
+  // Fold the energy integrated per frame since the last publish into the
+  // system totals. The integration itself happened in update_device_data(),
+  // so how long it has been since the previous update() no longer matters.
+  float energy_in_increment_kwh = (float) pending_energy_in_kwh_;
+  float energy_out_increment_kwh = (float) pending_energy_out_kwh_;
+  pending_energy_in_kwh_ = 0.0;
+  pending_energy_out_kwh_ = 0.0;
+  total_energy_in_kwh_ += energy_in_increment_kwh;
+  total_energy_out_kwh_ += energy_out_increment_kwh;
+
+  ESP_LOGD(TAG, "Energy from frames: Ein +%.6f kWh (%.3f), Eout +%.6f kWh (%.3f)",
+           energy_in_increment_kwh, total_energy_in_kwh_,
+           energy_out_increment_kwh, total_energy_out_kwh_);
+}
+
 StringData* TigoMonitorComponent::find_string_by_label(const std::string &label) {
   auto it = strings_.find(to_node_string(label));
   if (it != strings_.end()) {
@@ -1548,6 +1781,11 @@ void TigoMonitorComponent::publish_sensor_data() {
     ESP_LOGI(TAG, "Night mode: Saving energy data to flash (in: %.3f kWh, out: %.3f kWh, baseline: %.3f kWh)", 
          total_energy_in_kwh_, total_energy_out_kwh_, energy_at_day_start_);
     save_energy_data();
+    persist_commit_(true);
+#ifdef TIGO_TSDB_AVAILABLE
+    // Nothing new arrives overnight; don't leave a group commit's rows in RAM.
+    history_.flush_pending(0);
+#endif
   }
   
   // In night mode, publish zeros every 10 minutes
@@ -1781,6 +2019,13 @@ void TigoMonitorComponent::publish_sensor_data() {
       load_factor_it->second->publish_state(device.load_factor);
       ESP_LOGD(TAG, "Published load factor for %s: %.3f", device.addr.c_str(), device.load_factor);
     }
+
+    // Underperformance flag (tigo_health.h). Evaluated per frame; publishing
+    // here only forwards the latest state, and HA drops unchanged values.
+    auto underperforming_it = underperforming_sensors_.find(device.addr);
+    if (underperforming_it != underperforming_sensors_.end()) {
+      underperforming_it->second->publish_state(device.health.alerting);
+    }
     
     // Check if this device has a combined Tigo sensor
     auto tigo_power_it = power_in_sensors_.find(device.addr);
@@ -1897,24 +2142,7 @@ void TigoMonitorComponent::publish_sensor_data() {
     if (energy_in_sum_sensor_ != nullptr || energy_out_sum_sensor_ != nullptr) {
       unsigned long current_time = millis();
       
-      if (last_energy_update_ > 0) {
-        // Calculate time difference in hours
-        unsigned long time_diff_ms = current_time - last_energy_update_;
-        float time_diff_hours = time_diff_ms / 3600000.0f;
-        
-        // Calculate energy increment in kWh (power in watts * time in hours / 1000)
-        float energy_in_increment_kwh = (total_power_in * time_diff_hours) / 1000.0f;
-        float energy_out_increment_kwh = (total_power_out * time_diff_hours) / 1000.0f;
-        total_energy_in_kwh_ += energy_in_increment_kwh;
-        total_energy_out_kwh_ += energy_out_increment_kwh;
-        
-        ESP_LOGD(TAG, "Energy calculation: Pin %.0fW, Pout %.0fW for %.4fh => Ein +%.6f kWh (%.3f), Eout +%.6f kWh (%.3f)", 
-           total_power_in, total_power_out, time_diff_hours,
-                 energy_in_increment_kwh, total_energy_in_kwh_,
-                 energy_out_increment_kwh, total_energy_out_kwh_);
-      }
-      
-      last_energy_update_ = current_time;
+      apply_frame_energy_();
       if (energy_in_sum_sensor_ != nullptr) {
         energy_in_sum_sensor_->publish_state(total_energy_in_kwh_);
         ESP_LOGD(TAG, "Published energy in sum: %.3f kWh", total_energy_in_kwh_);
@@ -1939,35 +2167,10 @@ void TigoMonitorComponent::publish_sensor_data() {
       }
     }
   } else if (energy_in_sum_sensor_ != nullptr || energy_out_sum_sensor_ != nullptr) {
-    // Energy sensor configured but no power sum sensor - calculate power directly
-    float total_power_in = 0.0f;
-    float total_power_out = 0.0f;
-    
-    for (const auto &device : devices_) {
-      total_power_in += device.power_in;
-      total_power_out += device.power_out;
-    }
-    
+    // Energy sensor configured but no power sum sensor
     unsigned long current_time = millis();
     
-    if (last_energy_update_ > 0) {
-      // Calculate time difference in hours
-      unsigned long time_diff_ms = current_time - last_energy_update_;
-      float time_diff_hours = time_diff_ms / 3600000.0f;
-      
-      // Calculate energy increment in kWh
-      float energy_in_increment_kwh = (total_power_in * time_diff_hours) / 1000.0f;
-      float energy_out_increment_kwh = (total_power_out * time_diff_hours) / 1000.0f;
-      total_energy_in_kwh_ += energy_in_increment_kwh;
-      total_energy_out_kwh_ += energy_out_increment_kwh;
-      
-      ESP_LOGD(TAG, "Energy calculation: Pin %.0fW, Pout %.0fW for %.4fh => Ein +%.6f kWh (%.3f), Eout +%.6f kWh (%.3f)", 
-           total_power_in, total_power_out, time_diff_hours,
-               energy_in_increment_kwh, total_energy_in_kwh_,
-               energy_out_increment_kwh, total_energy_out_kwh_);
-    }
-    
-    last_energy_update_ = current_time;
+    apply_frame_energy_();
     if (energy_in_sum_sensor_ != nullptr) {
       energy_in_sum_sensor_->publish_state(total_energy_in_kwh_);
       ESP_LOGD(TAG, "Published energy in sum: %.3f kWh", total_energy_in_kwh_);
@@ -2016,9 +2219,8 @@ void TigoMonitorComponent::publish_sensor_data() {
     // Try to load saved peak power for this node
     std::string pref_key = "peak_" + to_std_string(node.addr);
     uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto load = this->cached_pref_<float>(hash);
     float saved_peak = 0.0f;
-    load.load(&saved_peak);
+    this->persist_load_(hash, pref_key.c_str(), &saved_peak);
     
     // Publish zeros for all sensors except peak power (which uses saved value)
     auto voltage_in_it = voltage_in_sensors_.find(node.addr);
@@ -2413,162 +2615,6 @@ void TigoMonitorComponent::print_device_mappings() {
   ESP_LOGI(TAG, "=== END UNIFIED NODE TABLE ===");
 }
 
-void TigoMonitorComponent::load_node_table() {
-  ESP_LOGI(TAG, "Loading persistent node table...");
-  
-  // Pre-allocate string buffer to avoid repeated allocations
-  static std::string pref_key;
-  pref_key.reserve(32);
-  
-  int loaded_count = 0;
-  // Load node table entries up to the configured number of devices
-  for (int i = 0; i < number_of_devices_; i++) {
-    pref_key = "node_";
-    pref_key += std::to_string(i);
-    uint32_t hash = esphome::fnv1_hash(pref_key);
-    
-    // Use char array for ESPHome preferences
-    auto restore = this->cached_pref_<char[256]>(hash);
-    char node_data[256] = {0};
-    
-    if (restore.load(&node_data) && strlen(node_data) > 0) {
-      // Format: "addr|long_addr|checksum|barcode|sensor_index"
-      std::string node_str(node_data);
-      std::vector<std::string> parts;
-      size_t start = 0, end = 0;
-      
-      // Split by '|' delimiter
-      while ((end = node_str.find('|', start)) != std::string::npos) {
-        parts.push_back(node_str.substr(start, end - start));
-        start = end + 1;
-      }
-      parts.push_back(node_str.substr(start)); // Last part
-      
-      // Current format (9 fields): addr|long_address|checksum|sensor_index|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
-      // Old format (10 fields): addr|long_address|checksum|frame09_barcode|sensor_index|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
-      // Legacy format (4 fields): addr|long_address|checksum|sensor_index
-      if (parts.size() >= 4) {
-        NodeTableData node;
-        node.addr = parts[0];
-        node.long_address = parts[1];
-        node.checksum = parts[2];
-        
-        // Determine sensor index position based on format
-        int sensor_idx_pos = (parts.size() >= 10) ? 4 : 3;  // Old format with frame09 at position 3
-        if (sensor_idx_pos < parts.size()) {
-          node.sensor_index = std::stoi(parts[sensor_idx_pos]);
-          node.is_persistent = true;
-        } else {
-          continue;  // Skip malformed entry
-        }
-        
-        // Load CCA fields if available
-        if (parts.size() >= 10) {
-          // Old format: addr|long_addr|checksum|frame09|sensor_idx|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
-          node.cca_label = parts[5];
-          node.cca_string_label = parts[6];
-          node.cca_inverter_label = parts[7];
-          node.cca_channel = parts[8];
-          node.cca_validated = (parts[9] == "1");
-          
-          // Replace "Inverter" with "MPPT" for more accurate terminology
-          if (node.cca_inverter_label.find("Inverter ") == 0) {
-            node.cca_inverter_label.replace(0, 9, "MPPT ");
-          }
-          
-          ESP_LOGI(TAG, "Restored node (old format): %s -> Tigo %d (barcode: %s, string: %s, validated: %s)", 
-                   node.addr.c_str(), node.sensor_index + 1, node.long_address.c_str(),
-                   node.cca_string_label.c_str(), node.cca_validated ? "yes" : "no");
-        } else if (parts.size() >= 9) {
-          // Current format: addr|long_addr|checksum|sensor_idx|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
-          node.cca_label = parts[4];
-          node.cca_string_label = parts[5];
-          node.cca_inverter_label = parts[6];
-          node.cca_channel = parts[7];
-          node.cca_validated = (parts[8] == "1");
-          
-          // Replace "Inverter" with "MPPT" for more accurate terminology
-          if (node.cca_inverter_label.find("Inverter ") == 0) {
-            node.cca_inverter_label.replace(0, 9, "MPPT ");
-          }
-          
-          ESP_LOGI(TAG, "Restored node with CCA: %s -> Tigo %d (barcode: %s, string: %s, validated: %s)", 
-                   node.addr.c_str(), node.sensor_index + 1, node.long_address.c_str(),
-                   node.cca_string_label.c_str(), node.cca_validated ? "yes" : "no");
-        } else {
-          // Old format without CCA fields - initialize to defaults
-          node.cca_label = "";
-          node.cca_string_label = "";
-          node.cca_inverter_label = "";
-          node.cca_channel = "";
-          node.cca_validated = false;
-          
-          ESP_LOGI(TAG, "Restored node (legacy format): %s -> Tigo %d (barcode: %s)", 
-                   node.addr.c_str(), node.sensor_index + 1, node.long_address.c_str());
-        }
-        
-        node_table_.push_back(node);
-        loaded_count++;
-      }
-    }
-  }
-  
-  ESP_LOGI(TAG, "Loaded %d persistent node table entries (capacity: %d devices)", loaded_count, number_of_devices_);
-}
-
-void TigoMonitorComponent::save_node_table() {
-  // Use stack-allocated buffer instead of heap string to prevent memory leaks
-  char pref_key[32];
-  char empty_data[256] = {0};
-  
-  // Count persistent nodes first
-  int persistent_count = 0;
-  for (const auto &node : node_table_) {
-    if (node.is_persistent) persistent_count++;
-  }
-  
-  // Only clear slots we'll actually use (avoid creating excess preference handles)
-  int slots_needed = std::max(persistent_count, 1);  // At least 1 slot for cleanup
-  for (int i = 0; i < slots_needed && i < number_of_devices_; i++) {
-    snprintf(pref_key, sizeof(pref_key), "node_%d", i);
-    uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto save = this->cached_pref_<char[256]>(hash);
-    save.save(&empty_data);
-  }
-  
-  // Save current persistent nodes
-  int i = 0;
-  int saved_count = 0;
-  for (const auto &node : node_table_) {
-    if (i >= number_of_devices_) break;
-    if (!node.is_persistent) continue;
-    
-    snprintf(pref_key, sizeof(pref_key), "node_%d", i);
-    uint32_t hash = esphome::fnv1_hash(pref_key);
-    
-    // Format node data into buffer - use snprintf for efficiency
-    // Format: "addr|long_addr|checksum|sensor_index|cca_label|cca_string|cca_inverter|cca_channel|cca_validated"
-    char node_data[256];
-    snprintf(node_data, sizeof(node_data), "%s|%s|%s|%d|%s|%s|%s|%s|%d",
-             node.addr.c_str(),
-             node.long_address.c_str(),
-             node.checksum.c_str(),
-             node.sensor_index,
-             node.cca_label.c_str(),
-             node.cca_string_label.c_str(),
-             node.cca_inverter_label.c_str(),
-             node.cca_channel.c_str(),
-             node.cca_validated ? 1 : 0);
-    
-    auto save = this->cached_pref_<char[256]>(hash);
-    save.save(&node_data);
-    saved_count++;
-    i++;
-  }
-  
-  ESP_LOGD(TAG, "Saved %d node table entries", saved_count);
-}
-
 void TigoMonitorComponent::save_peak_power_data() {
   if (devices_.empty()) {
     ESP_LOGD(TAG, "No devices to save peak power for");
@@ -2579,18 +2625,19 @@ void TigoMonitorComponent::save_peak_power_data() {
   char pref_key[32];
   int saved_count = 0;
   
+  // Staged, not written: a peak that has not moved since the last save (or
+  // since boot) is dropped by the persistence manager.
   for (const auto &device : devices_) {
     if (device.peak_power > 0.0f) {
       // Build key in stack buffer - no heap allocations
       snprintf(pref_key, sizeof(pref_key), "peak_%s", device.addr.c_str());
       uint32_t hash = esphome::fnv1_hash(pref_key);
-      auto save = this->cached_pref_<float>(hash);
-      save.save(&device.peak_power);
+      this->persist_save_(hash, pref_key, device.peak_power, kPersistTelemetryMs);
       saved_count++;
     }
   }
   
-  ESP_LOGD(TAG, "Saved %d peak power entries", saved_count);
+  ESP_LOGD(TAG, "Staged %d peak power entries", saved_count);
 }
 
 void TigoMonitorComponent::load_peak_power_data() {
@@ -2602,10 +2649,9 @@ void TigoMonitorComponent::load_peak_power_data() {
     // Build key in stack buffer - no heap allocations
     snprintf(pref_key, sizeof(pref_key), "peak_%s", device.addr.c_str());
     uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto load = this->cached_pref_<float>(hash);
     
     float saved_peak = 0.0f;
-    if (load.load(&saved_peak) && saved_peak > 0.0f) {
+    if (this->persist_load_(hash, pref_key, &saved_peak) && saved_peak > 0.0f) {
       device.peak_power = saved_peak;
       loaded_count++;
     }
@@ -2631,8 +2677,7 @@ void TigoMonitorComponent::reset_peak_power() {
     // Build key in stack buffer - no heap allocations
     snprintf(pref_key, sizeof(pref_key), "peak_%s", device.addr.c_str());
     uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto save = this->cached_pref_<float>(hash);
-    save.save(&zero);
+    this->persist_save_(hash, pref_key, zero, kPersistNowMs);
     reset_count++;
   }
 
@@ -2662,6 +2707,8 @@ void TigoMonitorComponent::reset_total_energy() {
   
   total_energy_in_kwh_ = 0.0f;
   total_energy_out_kwh_ = 0.0f;
+  pending_energy_in_kwh_ = 0.0;
+  pending_energy_out_kwh_ = 0.0;
   
   // Publish the reset value
   if (energy_in_sum_sensor_ != nullptr) {
@@ -2715,25 +2762,7 @@ void TigoMonitorComponent::check_midnight_reset() {
     float yesterday_production = total_energy_out_kwh_ - energy_at_day_start_;
     if (yesterday_production > 0.0f) {
       DailyEnergyData yesterday = DailyEnergyData::from_key(yesterday_key);
-      yesterday.energy_kwh = yesterday_production;
-      
-      // Add to history
-      bool found = false;
-      for (auto &entry : daily_energy_history_) {
-        if (entry.to_key() == yesterday_key) {
-          entry.energy_kwh = yesterday_production;
-          found = true;
-          break;
-        }
-      }
-      if (!found) {
-        daily_energy_history_.push_back(yesterday);
-      }
-      
-      // Keep only last 7 days
-      if (daily_energy_history_.size() > MAX_DAILY_HISTORY) {
-        daily_energy_history_.erase(daily_energy_history_.begin());
-      }
+      archive_daily_energy_(yesterday_key, yesterday_production);
       
       ESP_LOGI(TAG, "Archived daily energy at midnight: %04d-%02d-%02d = %.3f kWh (total: %.3f, started: %.3f)", 
                yesterday.year, yesterday.month, yesterday.day, yesterday_production,
@@ -2746,6 +2775,8 @@ void TigoMonitorComponent::check_midnight_reset() {
     // Now reset total energy (without saving to flash yet)
     total_energy_in_kwh_ = 0.0f;
     total_energy_out_kwh_ = 0.0f;
+    pending_energy_in_kwh_ = 0.0;
+    pending_energy_out_kwh_ = 0.0;
     energy_at_day_start_ = 0.0f;
     
     if (energy_in_sum_sensor_ != nullptr) {
@@ -2792,6 +2823,9 @@ void TigoMonitorComponent::save_persistent_data() {
   save_peak_power_data();
   save_energy_data();
   save_daily_energy_history();
+  // Shutdown and midnight are the batch points: write what changed now
+  // rather than at the end of the commit window.
+  persist_commit_(true);
   ESP_LOGI(TAG, "All persistent data saved successfully");
 }
 
@@ -2803,22 +2837,17 @@ void TigoMonitorComponent::reset_node_table() {
   
   // Clear the in-memory node table
   node_table_.clear();
+  barcode_index_dirty_ = true;
   
-  // Clear all persistent storage entries
-  for (int i = 0; i < number_of_devices_; i++) {
-    std::string pref_key = "node_" + std::to_string(i);
-    uint32_t hash = esphome::fnv1_hash(pref_key);
-    auto save = this->cached_pref_<char[256]>(hash);
-    char empty_data[256] = {0};
-    save.save(&empty_data);
-  }
+  // Persist the now-empty table (one image write, tigo_node_store.cpp)
+  save_node_table();
   
   // Clear the device sensor index cache
   created_devices_.clear();
   
   ESP_LOGI(TAG, "Node table reset complete:");
   ESP_LOGI(TAG, "- Cleared %d node table entries", cleared_count);
-  ESP_LOGI(TAG, "- Cleared %d persistent storage slots", number_of_devices_);
+  ESP_LOGI(TAG, "- Cleared persistent node table image");
   ESP_LOGI(TAG, "- Reset device sensor index cache");
   ESP_LOGI(TAG, "%s", "");
   ESP_LOGI(TAG, "All device mappings have been removed. Devices will be");
@@ -2860,6 +2889,7 @@ bool TigoMonitorComponent::remove_node(uint16_t addr) {
   
   // Remove from node table
   node_table_.erase(it);
+  barcode_index_dirty_ = true;
   
   // Save updated node table to persistent storage
   save_node_table();
@@ -2874,6 +2904,7 @@ bool TigoMonitorComponent::import_node_table(const psram_vector<NodeTableData>&
 
   // Clear existing node table
   node_table_.clear();
+  barcode_index_dirty_ = true;
   created_devices_.clear();
   
   // Reserve capacity to avoid reallocations during import
@@ -3007,14 +3038,12 @@ void TigoMonitorComponent::assign_sensor_index_to_node(const node_string &addr)
 }
 
 void TigoMonitorComponent::load_energy_data() {
-  auto restore = this->cached_pref_<float>(ENERGY_DATA_HASH);
-  if (restore.load(&total_energy_in_kwh_)) {
+  if (this->persist_load_(ENERGY_DATA_HASH, "energy_in", &total_energy_in_kwh_)) {
     ESP_LOGI(TAG, "Restored total input energy: %.3f kWh", total_energy_in_kwh_);
     
     // Try to restore energy_at_day_start_ and current_day_key_
     uint32_t baseline_hash = esphome::fnv1_hash("energy_day_baseline");
-    auto restore_baseline = this->cached_pref_<float>(baseline_hash);
-    if (restore_baseline.load(&energy_at_day_start_)) {
+    if (this->persist_load_(baseline_hash, "energy_day_baseline", &energy_at_day_start_)) {
       ESP_LOGI(TAG, "Restored day start baseline: %.3f kWh", energy_at_day_start_);
     } else {
       // No baseline saved - assume we're starting fresh today (output energy baseline)
@@ -3022,8 +3051,7 @@ void TigoMonitorComponent::load_energy_data() {
       ESP_LOGI(TAG, "No baseline found, using current total as baseline: %.3f kWh", energy_at_day_start_);
     }
 
-    auto restore_out = this->cached_pref_<float>(ENERGY_DATA_OUT_HASH);
-    if (restore_out.load(&total_energy_out_kwh_)) {
+    if (this->persist_load_(ENERGY_DATA_OUT_HASH, "energy_out", &total_energy_out_kwh_)) {
       ESP_LOGI(TAG, "Restored total output energy: %.3f kWh", total_energy_out_kwh_);
     } else {
       total_energy_out_kwh_ = 0.0f;
@@ -3031,8 +3059,7 @@ void TigoMonitorComponent::load_energy_data() {
     }
     
     uint32_t day_key_hash = esphome::fnv1_hash("current_day_key");
-    auto restore_day_key = this->cached_pref_<uint32_t>(day_key_hash);
-    if (restore_day_key.load(&current_day_key_)) {
+    if (this->persist_load_(day_key_hash, "current_day_key", &current_day_key_)) {
       ESP_LOGI(TAG, "Restored current day key: %u", (unsigned) current_day_key_);
     } else {
       current_day_key_ = 0;
@@ -3048,36 +3075,19 @@ void TigoMonitorComponent::load_energy_data() {
 }
 
 void TigoMonitorComponent::save_energy_data() {
-  auto save = this->cached_pref_<float>(ENERGY_DATA_HASH);
-  if (save.save(&total_energy_in_kwh_)) {
-    ESP_LOGD(TAG, "Saved input energy data: %.3f kWh", total_energy_in_kwh_);
-  } else {
-    ESP_LOGW(TAG, "Failed to save input energy data");
-  }
-
-  auto save_out = this->cached_pref_<float>(ENERGY_DATA_OUT_HASH);
-  if (save_out.save(&total_energy_out_kwh_)) {
-    ESP_LOGD(TAG, "Saved output energy data: %.3f kWh", total_energy_out_kwh_);
-  } else {
-    ESP_LOGW(TAG, "Failed to save output energy data");
-  }
+  // Staged for the next commit window; write failures are logged (and
+  // retried) by persist_commit_().
+  this->persist_save_(ENERGY_DATA_HASH, "energy_in", total_energy_in_kwh_, kPersistTelemetryMs);
+  this->persist_save_(ENERGY_DATA_OUT_HASH, "energy_out", total_energy_out_kwh_, kPersistTelemetryMs);
   
   // Also save energy_at_day_start_ and current_day_key_ for accurate daily tracking after reboots
   uint32_t baseline_hash = esphome::fnv1_hash("energy_day_baseline");
-  auto save_baseline = this->cached_pref_<float>(baseline_hash);
-  if (save_baseline.save(&energy_at_day_start_)) {
-    ESP_LOGD(TAG, "Saved day start baseline: %.3f kWh", energy_at_day_start_);
-  } else {
-    ESP_LOGW(TAG, "Failed to save day start baseline");
-  }
+  this->persist_save_(baseline_hash, "energy_day_baseline", energy_at_day_start_, kPersistTelemetryMs);
   
   uint32_t day_key_hash = esphome::fnv1_hash("current_day_key");
-  auto save_day_key = this->cached_pref_<uint32_t>(day_key_hash);
-  if (save_day_key.save(&current_day_key_)) {
-    ESP_LOGD(TAG, "Saved current day key: %u", (unsigned) current_day_key_);
-  } else {
-    ESP_LOGW(TAG, "Failed to save current day key");
-  }
+  this->persist_save_(day_key_hash, "current_day_key", current_day_key_, kPersistTelemetryMs);
+  ESP_LOGD(TAG, "Staged energy data: in %.3f kWh, out %.3f kWh, baseline %.3f kWh, day %u",
+           total_energy_in_kwh_, total_energy_out_kwh_, energy_at_day_start_, (unsigned) current_day_key_);
 }
 
 void TigoMonitorComponent::update_daily_energy(float energy_kwh) {
@@ -3107,25 +3117,7 @@ void TigoMonitorComponent::update_daily_energy(float energy_kwh) {
         // Only archive if we had positive production yesterday
         if (yesterday_production > 0.0f) {
           DailyEnergyData yesterday = DailyEnergyData::from_key(current_day_key_);
-          yesterday.energy_kwh = yesterday_production;
-          
-          // Add to history (or update if exists)
-          bool found = false;
-          for (auto &entry : daily_energy_history_) {
-            if (entry.to_key() == current_day_key_) {
-              entry.energy_kwh = yesterday_production;
-              found = true;
-              break;
-            }
-          }
-          if (!found) {
-            daily_energy_history_.push_back(yesterday);
-          }
-          
-          // Keep only last 7 days
-          if (daily_energy_history_.size() > MAX_DAILY_HISTORY) {
-            daily_energy_history_.erase(daily_energy_history_.begin());
-          }
+          archive_daily_energy_(current_day_key_, yesterday_production);
           
           ESP_LOGI(TAG, "Archived daily energy: %04d-%02d-%02d = %.3f kWh (total was %.3f, day started at %.3f)", 
                    yesterday.year, yesterday.month, yesterday.day, yesterday_production,
@@ -3146,90 +3138,6 @@ void TigoMonitorComponent::update_daily_energy(float energy_kwh) {
 #endif
 }
 
-void TigoMonitorComponent::save_daily_energy_history() {
-  // Pack history into a simple buffer
-  // Format: count (1 byte) + array of [key (4 bytes) + energy (4 bytes)]
-  static const size_t MAX_BUFFER_SIZE = 1 + (MAX_DAILY_HISTORY * 8);
-  uint8_t buffer[MAX_BUFFER_SIZE] = {0};
-  
-  size_t count = std::min(daily_energy_history_.size(), MAX_DAILY_HISTORY);
-  buffer[0] = static_cast<uint8_t>(count);
-  
-  // Pack entries silently - excessive logging during flash write causes heap allocations
-  size_t offset = 1;
-  for (size_t i = 0; i < count; i++) {
-    uint32_t key = daily_energy_history_[i].to_key();
-    float energy = daily_energy_history_[i].energy_kwh;
-    
-    // Store key (4 bytes)
-    memcpy(&buffer[offset], &key, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    
-    // Store energy (4 bytes)
-    memcpy(&buffer[offset], &energy, sizeof(float));
-    offset += sizeof(float);
-  }
-  
-  uint32_t hash = esphome::fnv1_hash("daily_energy_history");
-  auto save = this->cached_pref_<uint8_t[MAX_BUFFER_SIZE]>(hash);
-  
-  if (save.save(&buffer)) {
-    ESP_LOGD(TAG, "Saved %zu daily energy entries to flash (hash=0x%08X)", count, (unsigned) hash);
-  } else {
-    ESP_LOGW(TAG, "Failed to save daily energy history (hash=0x%08X)", (unsigned) hash);
-  }
-}
-
-void TigoMonitorComponent::load_daily_energy_history() {
-  static const size_t MAX_BUFFER_SIZE = 1 + (MAX_DAILY_HISTORY * 8);
-  uint8_t buffer[MAX_BUFFER_SIZE] = {0};
-  
-  uint32_t hash = esphome::fnv1_hash("daily_energy_history");
-  auto load = this->cached_pref_<uint8_t[MAX_BUFFER_SIZE]>(hash);
-  
-  if (!load.load(&buffer)) {
-    ESP_LOGD(TAG, "No saved daily energy history found");
-    return;
-  }
-  
-  size_t count = buffer[0];
-  
-  if (count > MAX_DAILY_HISTORY) {
-    ESP_LOGW(TAG, "Invalid daily energy history count: %zu (max=%zu)", count, MAX_DAILY_HISTORY);
-    return;
-  }
-  
-  daily_energy_history_.clear();
-  size_t offset = 1;
-  
-  for (size_t i = 0; i < count; i++) {
-    uint32_t key;
-    float energy;
-    
-    // Load key (4 bytes)
-    memcpy(&key, &buffer[offset], sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    
-    // Load energy (4 bytes)
-    memcpy(&energy, &buffer[offset], sizeof(float));
-    offset += sizeof(float);
-    
-    DailyEnergyData entry = DailyEnergyData::from_key(key);
-    entry.energy_kwh = energy;
-    daily_energy_history_.push_back(entry);
-    
-    ESP_LOGD(TAG, "Loaded: %04d-%02d-%02d = %.3f kWh", 
-             entry.year, entry.month, entry.day, entry.energy_kwh);
-  }
-  
-  ESP_LOGI(TAG, "Loaded %zu daily energy entries from flash", count);
-}
-
-std::vector<DailyEnergyData> TigoMonitorComponent::get_daily_energy_history() const {
-  StateLock lock(state_mutex_);
-  return daily_energy_history_;
-}
-
 // ========== CCA HTTP Query Functions ==========
 
 void TigoMonitorComponent::sync_from_cca() {
@@ -3460,38 +3368,45 @@ void TigoMonitorComponent::match_cca_to_uart(const char *json_response) {
         }
       }
       
-      // Try to match with UART-discovered nodes
+      // Try to match with UART-discovered nodes. The usual case — the CCA
+      // serial contains a node's 16-digit long address (CCA might have a
+      // longer format like "ABC123456-123") — is one barcode-index lookup per
+      // hex run in the serial. Only a serial that is instead part of a long
+      // address needs the scan over the table.
       bool matched = false;
-      for (auto &node : node_table_) {
-        node_string uart_barcode = get_barcode_for_node(node);
-        if (uart_barcode.empty()) continue;
-        
-        // Match: CCA serial should contain or equal UART barcode
-        // (CCA might have longer format like "ABC123456-123")
-        if (cca_serial.find(uart_barcode) != std::string::npos ||
-            uart_barcode.find(cca_serial) != std::string::npos) {
-          
-          // Replace "Inverter" with "MPPT" for more accurate terminology
-          if (inverter_label.find("Inverter ") == 0) {
-            inverter_label.replace(0, 9, "MPPT ");
+      NodeTableData *found = find_node_in_serial_(cca_serial, 16);
+      if (found == nullptr && !cca_serial.empty()) {
+        for (auto &node : node_table_) {
+          if (node.long_address.size() != 16) continue;
+          if (cca_serial.find(node.long_address.c_str()) != std::string::npos ||
+              node.long_address.find(cca_serial.c_str()) != node_string::npos) {
+            found = &node;
+            break;
           }
-          
-          node.cca_label = cca_label_str;
-          node.cca_string_label = string_label;
-          node.cca_inverter_label = inverter_label;
-          node.cca_channel = cca_channel_str;
-          node.cca_object_id = cca_obj_id;
-          node.cca_validated = true;
-          
-          ESP_LOGI(TAG, "Matched UART device %s (%s) with CCA panel '%s' (String: %s, MPPT: %s)",
-                   node.addr.c_str(), uart_barcode.c_str(), cca_label_str.c_str(),
-                   string_label.c_str(), inverter_label.c_str());
-          
-          matched = true;
-          matched_count++;
-          break;
         }
       }
+      if (found != nullptr) {
+        NodeTableData &node = *found;
+        const node_string &uart_barcode = node.long_address;
+        // Replace "Inverter" with "MPPT" for more accurate terminology
+        if (inverter_label.find("Inverter ") == 0) {
+          inverter_label.replace(0, 9, "MPPT ");
+        }
+        
+        node.cca_label = cca_label_str;
+        node.cca_string_label = string_label;
+        node.cca_inverter_label = inverter_label;
+        node.cca_channel = cca_channel_str;
+        node.cca_object_id = cca_obj_id;
+        node.cca_validated = true;
+        
+        ESP_LOGI(TAG, "Matched UART device %s (%s) with CCA panel '%s' (String: %s, MPPT: %s)",
+                 node.addr.c_str(), uart_barcode.c_str(), cca_label_str.c_str(),
+                 string_label.c_str(), inverter_label.c_str());
+        
+        matched = true;
+        matched_count++;
+      }
       
       if (!matched) {
         ESP_LOGW(TAG, "CCA panel '%s' (serial: %s) not found in UART discovered devices",
@@ -3657,7 +3572,9 @@ float TigoMonitorComponent::get_system_peak_power() const {
 
 #ifdef TIGO_TSDB_AVAILABLE
 void TigoMonitorComponent::snapshot_to_history_() {
-  if (!history_.initialized()) return;
+  // Still mounting is fine — the row waits in the writer queue. Only a failed
+  // (or never started) history has nowhere to go.
+  if (!history_.initialized() && !history_.warming_up()) return;
 
   // Need a valid wall-clock to key the row. Skip silently before SNTP/HA sync.
   uint32_t now_ts = 0;
@@ -3672,8 +3589,14 @@ void TigoMonitorComponent::snapshot_to_history_() {
     return;
   }
 
-  SystemSnapshot snap{};
+  // Static rather than on the loop task's stack: with metric families and
+  // more panel DBs it runs to a few KB. Only the loop task gets here.
+  static SystemSnapshot snap;
+  memset(&snap, 0, sizeof(snap));
   snap.timestamp = now_ts;
+  // Read once: the slot lookups below only work after the mount, and a mount
+  // finishing halfway through the gather must not produce a half-filled row.
+  snap.panels_valid = history_.initialized();
 
   // Take the state lock for the gather. The recursive mutex guards the same
   // aggregates the web-server snapshot getters protect, and matches the pattern
@@ -3687,15 +3610,40 @@ void TigoMonitorComponent::snapshot_to_history_() {
         std::max(0.0f, total_energy_in_kwh_ - last_snapshot_total_e_kwh_);
     last_snapshot_total_e_kwh_ = total_energy_in_kwh_;
 
+    // Inverter energy is integrated per frame (accumulate_frame_energy_), so
+    // the delta since the previous snapshot is real measured energy rather
+    // than the zero it was while update_inverter_data() reset it each pass.
     for (size_t i = 0; i < 4; ++i) {
       if (i < inverters_.size()) {
         snap.inv_p_w[i] = inverters_[i].total_power;
-        snap.inv_e_kwh[i] = std::max(
-            0.0f, inverters_[i].total_energy - last_snapshot_inv_e_kwh_[i]);
+        snap.inv_e_kwh[i] = (float) std::max(
+            0.0, inverters_[i].total_energy - last_snapshot_inv_e_kwh_[i]);
         last_snapshot_inv_e_kwh_[i] = inverters_[i].total_energy;
       }
     }
 
+    // The same per string and per inverter, in strings.tsdb / inverters.tsdb,
+    // at the column each canonical label was given on first sight. Not limited
+    // to four inverters, and unaffected by renames (display labels).
+    for (const auto &kv : strings_) {
+      if (!snap.panels_valid) break;
+      uint8_t col = history_.get_or_assign_series(GROUP_STRING, to_std_string(kv.second.string_label));
+      if (col < kMaxStringSeries) snap.string_p_w[col] = kv.second.total_power;
+    }
+    for (const auto &inv : inverters_) {
+      if (!snap.panels_valid) break;
+      uint8_t col = history_.get_or_assign_series(GROUP_INVERTER, to_std_string(inv.name));
+      if (col >= kMaxInverterSeries) continue;
+      snap.inverter_p_w[col] = inv.total_power;
+      if (!inverter_e_seeded_[col]) {
+        last_snapshot_inverter_e_kwh_[col] = inv.total_energy;
+        inverter_e_seeded_[col] = true;
+      }
+      snap.inverter_e_kwh[col] =
+          (float) std::max(0.0, inv.total_energy - last_snapshot_inverter_e_kwh_[col]);
+      last_snapshot_inverter_e_kwh_[col] = inv.total_energy;
+    }
+
     float sum_t = 0.0f;
     int n = 0;
     for (const auto &d : devices_) {
@@ -3717,17 +3665,60 @@ void TigoMonitorComponent::snapshot_to_history_() {
     // Per-panel powers indexed by stable slot. Devices without a known
     // barcode (typically: just-joined nodes that haven't reported a frame 27
     // yet) are skipped — they'll get a slot assignment on the next snapshot.
+    //
+    // Alongside, each panel's output relative to its string's mean output for
+    // the degradation trend (tigo_trend.h). Panels outside any string, or alone
+    // in one, compare against the array mean. NaN leaves the trend untouched.
+    for (auto &r : snap.panel_ratio) r = NAN;
+    float array_mean = 0.0f;
+    int online = 0;
     for (const auto &d : devices_) {
-      if (d.barcode.size() < 6) continue;
-      std::string key = to_std_string(d.barcode).substr(d.barcode.size() - 6);
-      uint8_t slot = history_.get_or_assign_slot(key);
-      if (slot >= kMaxPanelSlots) continue;  // table full
-      snap.panel_p_w[slot] = d.power_in;
+      if (d.last_update > 0 && !d.is_stale) {
+        array_mean += d.power_out;
+        ++online;
+      }
+    }
+    array_mean = (online > 0) ? array_mean / online : 0.0f;
+
+    for (const auto &d : devices_) {
+      if (!snap.panels_valid) break;
+      uint8_t slot = history_slot_for_(d.barcode);
+      if (slot >= kMaxPanelSlots) continue;  // no barcode yet, or table full
+      for (size_t f = 0; f < kNumPanelFamilies; ++f) {
+        float v = 0.0f;
+        switch (panel_family_metric(f)) {
+          case PANEL_POWER: v = d.power_in; break;
+          case PANEL_VIN: v = d.voltage_in; break;
+          case PANEL_VOUT: v = d.voltage_out; break;
+          case PANEL_TEMP: v = d.temperature; break;
+          case PANEL_RSSI: v = (float) d.rssi; break;
+        }
+        snap.panel_values[f][slot] = v;
+      }
+
+      if (d.is_stale) continue;
+      const StringData *string = string_for_device_(d.addr);
+      float reference = (string != nullptr && string->active_device_count >= 2)
+                            ? string->total_power / string->active_device_count
+                            : array_mean;
+      if (reference >= kTrendMinReferenceW) snap.panel_ratio[slot] = d.power_out / reference;
     }
   }
 
   history_.enqueue_snapshot(snap);
 }
+
+uint8_t TigoMonitorComponent::history_slot_for_(const node_string &barcode) {
+  if (barcode.size() < 6) return 0xFF;
+  // A 16-digit barcode is in the index, where the slot is cached after its
+  // first lookup. Anything else (a long address that never parsed as hex)
+  // takes the string path every time, as all of them used to.
+  BarcodeEntry *entry = find_barcode_(barcode);
+  if (entry != nullptr && entry->slot != 0xFF) return entry->slot;
+  uint8_t slot = history_.get_or_assign_slot(to_std_string(barcode).substr(barcode.size() - 6));
+  if (entry != nullptr && slot < kMaxPanelSlots) entry->slot = slot;
+  return slot;
+}
 #endif  // TIGO_TSDB_AVAILABLE
 
 }  // namespace tigo_monitor
@@ -21,8 +21,13 @@
 #include <string>
 #include <limits>
 #include <new>
+#include <cstring>
+#include <bitset>
 
 #include "tigo_history.h"
+#include "tigo_recent.h"
+#include "tigo_quantile.h"
+#include "tigo_health.h"
 
 #ifdef USE_ESP_IDF
 #include <esp_heap_caps.h>
@@ -187,6 +192,19 @@ struct DeviceData {
   // production values are zeroed at the same time. Cleared implicitly when a
   // fresh frame overwrites the struct (#26).
   bool is_stale = false;
+  // Energy integrated from this device's own power frames since boot (kWh),
+  // trapezoidally over the frame arrival times. double, not float: a few mWh
+  // per frame added to a running total loses everything below ~0.5 Wh in a
+  // float once the total reaches the thousands. Carried across frames by
+  // update_device_data() the same way peak_power is.
+  double energy_in_kwh = 0.0;
+  double energy_out_kwh = 0.0;
+  // Underperformance tracking against the string median (tigo_health.h).
+  // Carried across frames like the energy accumulators.
+  PanelHealth health;
+  // Last peer window (TigoMonitorComponent::peer_window_) this device was
+  // counted in, so a panel sending many frames in one window counts once.
+  uint32_t peer_window = 0;
 };
 
 struct NodeTableData {
@@ -205,6 +223,16 @@ struct NodeTableData {
   bool cca_validated = false;     // True if matched with CCA configuration
 };
 
+// One node in the barcode index (tigo_barcode_index.cpp): a node-table long
+// address as the number it is, where that node sits in node_table_, and its
+// history slot once the snapshot has resolved it. Slots are never recycled,
+// so a resolved one stays right for as long as the node exists.
+struct BarcodeEntry {
+  uint64_t long_addr;
+  uint16_t node;              // index into node_table_
+  uint8_t slot = 0xFF;        // history slot, 0xFF until first resolved
+};
+
 struct StringData {
   node_string string_label;       // Canonical CCA string label (e.g. "String A").
                                   // Immutable identity used for lookup + NVS keys.
@@ -227,6 +255,21 @@ struct StringData {
   float min_efficiency = 100.0f;
   float max_efficiency = 0.0f;
   float peak_power = 0.0f;        // Historical peak power for this string
+  double total_energy = 0.0;      // Output energy since boot (kWh), rolled up
+                                  // per frame from the member devices
+  // Per-frame quartile sketches of the member panels (tigo_quantile.h), fed
+  // in update_device_data() and published + reset by update_string_data().
+  QuartileSketch power_sketch;
+  QuartileSketch voltage_sketch;
+  QuartileSketch temperature_sketch;
+  QuartileSummary power_quartiles;        // power_out, W
+  QuartileSummary voltage_quartiles;      // voltage_in, V
+  QuartileSummary temperature_quartiles;  // °C
+  // Distinct panels that fed power_sketch: in the window being filled, and
+  // in the one power_quartiles summarizes. The sketch counts frames, and one
+  // chatty panel can supply all of them.
+  uint16_t window_panels = 0;
+  uint16_t reporting_panels = 0;
   int active_device_count = 0;
   int total_device_count = 0;
   unsigned long last_update = 0;
@@ -239,7 +282,8 @@ struct InverterData {
   node_vector<node_string> mppt_labels;  // List of MPPT labels assigned to this inverter
   float total_power = 0.0f;
   float peak_power = 0.0f;
-  float total_energy = 0.0f;
+  double total_energy = 0.0;      // Output energy since boot (kWh), rolled up
+                                  // per frame from the strings on its MPPTs
   int active_device_count = 0;
   int total_device_count = 0;
 };
@@ -262,8 +306,25 @@ struct DailyEnergyData {
     data.day = key % 100;
     return data;
   }
+
+  // Days since kEnergyEpochYear-01-01, or -1 for a date before the epoch or
+  // one that does not exist (2025-02-30). Defined in tigo_energy_store.cpp.
+  int32_t day_number() const;
+  static DailyEnergyData from_day_number(uint32_t day);
 };
 
+// Daily energy archive (tigo_energy_store.cpp). Every archived day is one
+// packed uint32 — its day number in the top 15 bits, kWh x100 in the low 17 —
+// held in a ring indexed by day number, so archiving a day and reading any
+// date are each one array access and a record that names a different day than
+// its slot is simply an empty day. Monthly totals live beside it in a second
+// ring (month number in 12 bits, kWh x10 in 20) that outlasts the daily one.
+static constexpr uint16_t kEnergyEpochYear = 2020;
+static constexpr size_t kEnergyChunkDays = 128;  // days per NVS blob (512 B of records)
+static constexpr size_t kEnergyDayChunks = 15;
+static constexpr size_t kEnergyRingDays = kEnergyChunkDays * kEnergyDayChunks;  // 1,920 days, ~5.2 years
+static constexpr size_t kEnergyRingMonths = 240;                                 // 20 years
+
 // Why the ESP last restarted, as a short stable token ("panic", "brownout",
 // "watchdog", ...). ESP-IDF's own reset reason survives a reset in RTC memory,
 // so this is accurate for the whole boot regardless of when it is read.
@@ -276,6 +337,62 @@ struct DailyEnergyData {
 // entire uptime, which is what actually makes an unattended reset diagnosable.
 const char *reset_reason_str();
 
+// Boot timeline, reported under "boot" in /api/status: micros() since reset
+// at which each setup phase finished, when loop() first ran (UART ingest
+// starts there), and when the first byte and first power frame arrived.
+// Phase names are string literals, so marking costs no allocation.
+struct BootPhase {
+  const char *name;
+  uint32_t us;
+};
+
+struct BootTimeline {
+  static constexpr size_t kMaxPhases = 24;
+  BootPhase phases[kMaxPhases];
+  size_t count = 0;
+  uint32_t first_loop_us = 0;
+  uint32_t first_byte_us = 0;
+  uint32_t first_frame_us = 0;
+  uint32_t deferred_done_us = 0;  // TSDB, cloud credentials, CCA sync scheduled
+};
+
+// How long a staged NVS value may wait for the commit window. User edits land
+// on the next loop pass; the node table within a minute, so a discovery burst
+// is one write but a power cut soon after it loses little; energy, peaks and
+// the daily history are rewritten all day and can wait.
+static constexpr uint32_t kPersistNowMs = 0;
+static constexpr uint32_t kPersistNodeTableMs = 60UL * 1000UL;
+static constexpr uint32_t kPersistTelemetryMs = 10UL * 60UL * 1000UL;
+
+// NVS write accounting, reported under "persistence" in /api/status. See
+// tigo_persist.cpp for how writes are staged, coalesced and skipped.
+struct PersistKeyStat {
+  char key[24];
+  uint32_t writes;
+  uint32_t skipped;
+  uint16_t size;
+};
+
+struct PersistStats {
+  static constexpr size_t kTopKeys = 8;
+  uint32_t keys = 0;
+  uint32_t saves = 0;          // values offered by the save paths
+  uint32_t writes = 0;         // values handed to NVS
+  uint32_t skipped = 0;        // identical to what NVS already holds
+  uint32_t coalesced = 0;      // replaced a pending value before it was written
+  uint32_t failed = 0;
+  uint32_t commits = 0;
+  uint32_t pending = 0;        // staged, waiting for the commit window
+  uint32_t last_commit_age_s = 0;
+  uint64_t bytes_written = 0;
+  uint64_t entries_written = 0;  // 32-byte NVS entries, the unit wear accrues in
+  uint32_t nvs_pages = 0;        // 0 if the partition could not be found
+  float page_erases = 0.0f;      // estimated erase cycles per NVS page since boot
+  float years_to_endurance = NAN;  // at this boot's write rate; NaN before any write
+  size_t top_count = 0;
+  PersistKeyStat top[kTopKeys];  // most-written keys, descending
+};
+
 class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
  public:
   TigoMonitorComponent() = default;
@@ -425,6 +542,9 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
     this->night_mode_sensor_ = sensor;
     ESP_LOGCONFIG("tigo_monitor", "Registered night mode binary sensor");
   }
+  void add_underperforming_sensor(const char *address, binary_sensor::BinarySensor *sensor) {
+    this->underperforming_sensors_[address] = sensor;
+  }
   
   // Memory monitoring sensors (ESP32 only)
   void add_internal_ram_free_sensor(sensor::Sensor *sensor) {
@@ -453,6 +573,16 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   // validated in Python; see kDefaultSnapshotIntervalMin in tigo_history.h for
   // what it costs to lower.
   void set_snapshot_interval_min(uint32_t minutes) { snapshot_interval_min_ = minutes; }
+  // Snapshots per flash commit (`history_group_commit`, 1 = commit each one).
+  // See kMaxGroupCommit in tigo_history.h.
+  void set_history_group_commit(uint32_t rows) { history_group_commit_ = rows; }
+  // Depth of the per-device frame-rate ring behind /api/recent, in samples
+  // (`recent_samples`; 0 disables). See tigo_recent.h for the memory cost.
+  void set_recent_samples(uint32_t samples) { recent_samples_ = samples; }
+  // Underperformance alerting (`underperformance_threshold`, a fraction of the
+  // string median, and `underperformance_duration`). See tigo_health.h.
+  void set_underperformance_threshold(float fraction) { health_params_.threshold = fraction; }
+  void set_underperformance_duration(uint32_t ms) { health_params_.hold_ms = ms; }
   void add_inverter(const std::string &name, const std::vector<std::string> &mppt_labels);
 
   // Set the user-friendly display name for an inverter (looked up by canonical
@@ -539,10 +669,35 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   uint32_t get_command_frame_count() const { return command_frame_count_; }
   float get_power_calibration() const { return power_calibration_; }
   uint32_t get_snapshot_interval_min() const { return snapshot_interval_min_; }
+  uint32_t get_recent_samples() const { return recent_samples_; }
+  const HealthParams &get_health_params() const { return health_params_; }
+  // NVS write counters and wear estimate, copied under the state lock.
+  void snapshot_persist_stats(PersistStats &out) const;
+  // "restored", "invalid" (soft reset, no usable image) or "cold" (power-up).
+  const char *get_warm_start_state() const { return warm_start_state_; }
+  // Records that a boot phase just finished (tigo_server marks its own).
+  void boot_mark(const char *phase);
+  void snapshot_boot_timeline(BootTimeline &out) const;
+
+  // Copies the last window_ms of one device's frame-rate samples (oldest first)
+  // under the state lock, so the caller can format them after releasing it.
+  // now_ms is the millis() the window was measured against; capacity is the
+  // configured ring depth. Returns false if the device has no ring.
+  bool copy_recent_samples(const std::string &addr, uint32_t window_ms,
+                           node_vector<RecentPoint> &out, uint32_t &now_ms,
+                           size_t &capacity) const;
   bool is_in_night_mode() const { return in_night_mode_; }
   
-  // Daily energy history access
-  std::vector<DailyEnergyData> get_daily_energy_history() const;
+  // Archived daily totals for every date in [from_key, to_key] (YYYYMMDD),
+  // oldest first, 0 kWh where nothing was archived. The range is clipped to
+  // the epoch and to the last kEnergyRingDays ending at to_key. Today is never
+  // archived; callers add it from the live energy counter.
+  node_vector<DailyEnergyData> get_daily_energy_history(uint32_t from_key, uint32_t to_key) const;
+  // Same contract per calendar month (entries have day == 0), clipped to the
+  // last kEnergyRingMonths.
+  node_vector<DailyEnergyData> get_monthly_energy_history(uint32_t from_key, uint32_t to_key) const;
+  // Oldest archived day as YYYYMMDD, 0 while the archive is empty.
+  uint32_t get_energy_history_first_key() const;
   
   // Fast display helper methods (cached, no iteration)
   int get_device_count() const { return devices_.size(); }
@@ -556,6 +711,10 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
 #ifdef TIGO_TSDB_AVAILABLE
   TigoHistory *get_history() { return &history_; }
 #endif
+  // Node whose long address ends in the 6 hex digits `last6` — a history slot
+  // key — through the barcode index, without copying the node table. Call
+  // inside with_state_lock(); the pointer is only good until it returns.
+  const NodeTableData *find_node_by_barcode_suffix(const char *last6) const;
   
   // Public methods for web server access
   void reset_peak_power();  // Reset all peak power values to 0
@@ -644,6 +803,11 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   
   // Device management
   void update_device_data(const DeviceData &data);
+  StringData *string_for_device_(const node_string &addr);
+  void accumulate_frame_energy_(DeviceData &device, StringData *string, double in_kwh,
+                                double out_kwh);
+  void apply_frame_energy_();
+  void record_recent_sample_(const DeviceData &device);
   void publish_sensor_data();
   void mark_stale_devices_();
   DeviceData* find_device_by_addr(const node_string &addr);
@@ -657,16 +821,50 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   StringData* find_string_by_label(const std::string &label);
   
   // Unified node table management (combines Frame 27, Frame 09, and device mappings)
+  // Node-table persistence lives in tigo_node_store.cpp: one CRC-checked
+  // binary image in a few NVS blobs, migrated from the per-slot text layout.
   void load_node_table();
   void save_node_table();
+  bool load_node_table_image_();
+  bool read_node_image_set_(uint8_t set, node_vector<uint8_t> &payload, uint16_t &node_count, uint8_t &generation,
+                            uint8_t &count);
+  int load_node_table_legacy_(node_vector<uint16_t> &slots_read);
+  uint32_t node_image_crc_ = 0;     // CRC of the last image loaded or saved
+  size_t node_image_len_ = 0;
+  bool node_image_known_ = false;   // false until one has been loaded or saved
+  // Chunk set (0 = A, 1 = B) and generation of that image. B, so that the
+  // first image ever written goes to A.
+  uint8_t node_image_set_ = 1;
+  uint8_t node_image_generation_ = 0;
   void save_peak_power_data();
   void load_peak_power_data();
   void save_daily_energy_history();
   void load_daily_energy_history();
+  bool load_daily_energy_legacy_();
+  void archive_daily_energy_(uint32_t day_key, float energy_kwh);
   void update_daily_energy(float energy_kwh);
-  void save_persistent_data();  // Save all persistent data (node table + peak power + energy)
+  void save_persistent_data();  // Save all persistent data (node table + peak power + energy) and commit
   int get_next_available_sensor_index();
   NodeTableData* find_node_by_addr(const node_string &addr);
+
+  // Barcode index (tigo_barcode_index.cpp): every 16-hex-digit long address in
+  // node_table_ as a uint64, sorted, plus the same entries ordered by their
+  // low 24 bits (the 6-digit suffix history slots and cloud serials use).
+  // Lookups are a binary search with no string work; the index is rebuilt
+  // from node_table_ on the first lookup after a change, and a lookup that
+  // finds it out of step with the table rebuilds it rather than trusting it.
+  // StateLock guards it like the table itself.
+  mutable node_vector<BarcodeEntry> barcode_index_;    // by long_addr, then node
+  mutable node_vector<uint16_t> barcode_suffixes_;     // positions in barcode_index_, by suffix
+  mutable bool barcode_index_dirty_ = true;            // set wherever node_table_ changes
+  mutable size_t barcode_index_nodes_ = 0;             // node_table_.size() at the last rebuild
+  void rebuild_barcode_index_() const;
+  BarcodeEntry *find_barcode_(uint64_t long_addr) const;
+  BarcodeEntry *find_barcode_(const node_string &long_address) const;  // nullptr unless 16 hex digits
+  const BarcodeEntry *find_barcode_suffix_(uint32_t suffix) const;
+  // First run of `digits` hex digits (16: a long address, 6: its suffix) in
+  // `serial` that names a node; nullptr if none does.
+  NodeTableData *find_node_in_serial_(const std::string &serial, size_t digits);
   void assign_sensor_index_to_node(const node_string &addr);
   
   // CCA HTTP query and matching
@@ -718,6 +916,23 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   // Energy persistence
   void load_energy_data();
   void save_energy_data();
+
+  // Warm-start cache in RTC memory (tigo_warm_start.cpp): live state that
+  // survives a soft reset without touching flash. Stored after every update(),
+  // restored in setup() after the NVS loads.
+  void warm_start_store_();
+  void warm_start_restore_();
+  void warm_start_restore_rollups_();  // string/inverter totals, once the string groups exist
+  const char *warm_start_state_ = "cold";
+
+  // Boot work that UART ingest does not depend on: mounting and opening the
+  // TSDB, the cloud credential read and scheduling the CCA sync. Run from
+  // loop() after the first power frame, or kDeferredInitTimeoutMs after
+  // setup() when the bus is silent (night).
+  void deferred_init_();
+  bool deferred_init_done_ = false;
+  uint32_t setup_done_ms_ = 0;
+  BootTimeline boot_;
   
  private:
 #ifdef USE_ESP_IDF
@@ -773,6 +988,64 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
     return it->second;
   }
 
+  // Persistence manager (tigo_persist.cpp). Save paths no longer write NVS
+  // directly: persist_save_() stages the value, drops it if the bytes match
+  // what NVS already holds, and persist_commit_() writes everything staged in
+  // one pass once the earliest entry's delay is up. delay_ms is how long a
+  // value may wait — 0 for user edits, minutes for telemetry that is rewritten
+  // anyway. persist_load_() reads through the staging area and records the
+  // loaded bytes, so the first save of an unchanged value is also skipped.
+  struct PersistEntry {
+    char key[24] = {};
+    uint16_t size = 0;
+    bool dirty = false;
+    bool committed_known = false;  // `committed` mirrors NVS
+    uint32_t due_ms = 0;
+    uint32_t writes = 0;
+    uint32_t skipped = 0;
+    node_vector<uint8_t> committed;
+    node_vector<uint8_t> pending;
+    bool (*write)(ESPPreferenceObject &, const uint8_t *) = nullptr;
+  };
+#ifdef USE_ESP_IDF
+  psram_map<uint32_t, PersistEntry> persist_;
+#else
+  std::map<uint32_t, PersistEntry> persist_;
+#endif
+  PersistStats persist_totals_;  // counters only; the derived fields are filled on snapshot
+  uint32_t persist_next_due_ms_ = 0;
+  uint32_t persist_last_commit_ms_ = 0;
+
+  template<typename T> static bool persist_write_as_(ESPPreferenceObject &pref, const uint8_t *bytes) {
+    return pref.save(reinterpret_cast<const T *>(bytes));
+  }
+  template<typename T> void persist_save_(uint32_t hash, const char *key, const T &value, uint32_t delay_ms) {
+    StateLock lock(state_mutex_);
+    this->cached_pref_<T>(hash);
+    PersistEntry &e = persist_entry_(hash, key, sizeof(T));
+    e.write = &persist_write_as_<T>;
+    persist_stage_(e, reinterpret_cast<const uint8_t *>(&value), delay_ms);
+  }
+  template<typename T> bool persist_load_(uint32_t hash, const char *key, T *out) {
+    StateLock lock(state_mutex_);
+    PersistEntry &e = persist_entry_(hash, key, sizeof(T));
+    if (e.dirty) {
+      memcpy(out, e.pending.data(), sizeof(T));
+      return true;
+    }
+    if (!this->cached_pref_<T>(hash).load(out)) return false;
+    const auto *bytes = reinterpret_cast<const uint8_t *>(out);
+    e.committed.assign(bytes, bytes + sizeof(T));
+    e.committed_known = true;
+    return true;
+  }
+  PersistEntry &persist_entry_(uint32_t hash, const char *key, size_t size);
+  void persist_stage_(PersistEntry &e, const uint8_t *bytes, uint32_t delay_ms);
+  void persist_commit_(bool force);
+  // Removes a key from NVS outright and forgets it here. Only for keys no
+  // longer part of any layout (the legacy node slots).
+  bool persist_erase_(uint32_t hash);
+
 #ifdef USE_ESP_IDF
   // Use PSRAM-backed containers for large data structures
   psram_vector<DeviceData> devices_;
@@ -797,6 +1070,7 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   psram_map<node_string, sensor::Sensor*> power_factor_sensors_;
   psram_map<node_string, sensor::Sensor*> load_factor_sensors_;
   psram_map<node_string, sensor::Sensor*> string_power_sensors_;  // key = canonical string label
+  psram_map<node_string, binary_sensor::BinarySensor*> underperforming_sensors_;
 #else
   // Fallback to standard containers on Arduino
   std::vector<DeviceData> devices_;
@@ -820,6 +1094,7 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   std::map<node_string, sensor::Sensor*> power_factor_sensors_;
   std::map<node_string, sensor::Sensor*> load_factor_sensors_;
   std::map<node_string, sensor::Sensor*> string_power_sensors_;  // key = canonical string label
+  std::map<node_string, binary_sensor::BinarySensor*> underperforming_sensors_;
 #endif
   sensor::Sensor* power_in_sum_sensor_ = nullptr;
   sensor::Sensor* power_out_sum_sensor_ = nullptr;
@@ -841,11 +1116,44 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   // Energy calculation variables
   float total_energy_in_kwh_ = 0.0f;
   float total_energy_out_kwh_ = 0.0f;
-  unsigned long last_energy_update_ = 0;
+  // Frame-integrated energy not yet folded into the totals above. Filled per
+  // power frame by accumulate_frame_energy_(), drained by apply_frame_energy_()
+  // on each publish, so the totals no longer depend on update_interval.
+  double pending_energy_in_kwh_ = 0.0;
+  double pending_energy_out_kwh_ = 0.0;
+  // Longest frame-to-frame gap still integrated. Past this the device was
+  // silent (shade, night, bus trouble) and bridging the gap with a straight
+  // line between two samples would invent energy that was never measured.
+  static const unsigned long MAX_ENERGY_GAP_MS = 300000;  // 5 minutes
+
+  // Frame-rate recent history, a PSRAM ring per device address (tigo_recent.h).
+  uint32_t recent_samples_ = kDefaultRecentSamples;
+#ifdef USE_ESP_IDF
+  psram_map<node_string, RecentRing> recent_rings_;
+#else
+  std::map<node_string, RecentRing> recent_rings_;
+#endif
+
+  // Underperformance detection (tigo_health.h). The array-wide median is the
+  // reference for panels outside any string; windowed like the per-string
+  // sketches and published alongside them in update_string_data().
+  HealthParams health_params_;
+  QuartileSketch array_power_sketch_;
+  QuartileSummary array_power_quartiles_;
+  // Window counter and distinct-panel counts for the array sketch; see
+  // StringData::window_panels.
+  uint32_t peer_window_ = 1;
+  uint16_t array_window_panels_ = 0;
+  uint16_t array_reporting_panels_ = 0;
+  void update_panel_health_(DeviceData &device, const StringData *string);
   
-  // Daily energy history (keep last 7 days)
-  static const size_t MAX_DAILY_HISTORY = 7;
-  std::vector<DailyEnergyData> daily_energy_history_;
+  // Daily energy archive (tigo_energy_store.cpp). Both rings are allocated at
+  // load, in PSRAM where there is some; StateLock guards them.
+  node_vector<uint32_t> energy_days_;    // kEnergyRingDays records, slot = day % kEnergyRingDays
+  node_vector<uint32_t> energy_months_;  // kEnergyRingMonths records, slot = month % kEnergyRingMonths
+  uint16_t energy_dirty_chunks_ = 0;     // bit n: day chunk n changed since it was last staged
+  bool energy_months_dirty_ = false;
+  int32_t energy_first_day_ = -1;        // oldest day number held, -1 while empty
   uint32_t current_day_key_ = 0;  // YYYYMMDD format
   float energy_at_day_start_ = 0.0f;  // Energy value at the start of current day
   
@@ -885,8 +1193,10 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   float power_calibration_ = 1.0f;
 #ifdef TIGO_TSDB_AVAILABLE
   uint32_t snapshot_interval_min_ = kDefaultSnapshotIntervalMin;
+  uint32_t history_group_commit_ = 1;
 #else
   uint32_t snapshot_interval_min_ = 30;
+  uint32_t history_group_commit_ = 1;
 #endif
   
 #ifdef USE_ESP_IDF
@@ -927,9 +1237,19 @@ class TigoMonitorComponent : public PollingComponent, public uart::UARTDevice {
   // Captures cumulative readings at the previous snapshot so each tsdb row
   // stores the per-snapshot energy delta rather than running totals.
   float last_snapshot_total_e_kwh_ = 0.0f;
-  float last_snapshot_inv_e_kwh_[4] = {0, 0, 0, 0};
+  double last_snapshot_inv_e_kwh_[4] = {0, 0, 0, 0};
+  // Same, by inverters.tsdb column (TigoHistory::get_or_assign_series).
+  // Columns are only known once the mount has loaded the series map, so each
+  // one is seeded from its inverter's total the first snapshot it appears in
+  // this boot, rather than at writer start; until then a restored lifetime
+  // total would read as one period's energy.
+  double last_snapshot_inverter_e_kwh_[kMaxInverterSeries] = {};
+  std::bitset<kMaxInverterSeries> inverter_e_seeded_;
   uint32_t last_snapshot_frames_lost_ = 0;
   void snapshot_to_history_();
+  // History slot for a device's barcode, cached in the barcode index after the
+  // first TigoHistory::get_or_assign_slot(). 0xFF if none (yet).
+  uint8_t history_slot_for_(const node_string &barcode);
 #endif
 };
 
@@ -0,0 +1,532 @@
+// Node-table persistence — the addr -> barcode -> sensor index -> CCA label
+// mapping that has to survive a reboot for panels to keep their entities.
+//
+// It used to be one `char[256]` NVS preference per node slot, holding
+// pipe-delimited text: a save cleared then rewrote up to number_of_devices_
+// keys, and a boot probed every one of them and re-split each string with
+// find/substr/stoi. Now the whole table is one binary image: a 4-character
+// short address and a 16-character long address become a uint16 and a uint64,
+// labels are length-prefixed, and the image is CRC-32 checked as a whole. It is
+// stored across as few fixed-size NVS blobs as it needs (NodeTableChunk; a
+// 40-panel install with CCA labels fits in two), so a save is one or two writes
+// and a boot one or two reads and one parse.
+//
+// There are two sets of those blobs, A and B, and saves alternate between
+// them with a generation number that counts up. NVS commits blob by blob, so
+// a reset halfway through a multi-chunk save leaves that set mixing two
+// images; its CRC fails and the boot takes the other set, one save older,
+// instead of falling through to the legacy slots that migration has erased.
+// A save only moves on to the other set once the last one has reached flash
+// (the persist layer holds chunks for minutes), so the set it overwrites is
+// never the only complete image.
+//
+// Migration is automatic: when no valid image is found, the old text slots are
+// read (all three historical layouts, see load_node_table_legacy_), written
+// back once as an image, and the slots that held anything are erased.
+
+#include "tigo_monitor.h"
+
+#include "esphome/core/log.h"
+#include "esphome/core/helpers.h"
+#include "esp_rom_crc.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace tigo_monitor {
+
+static const char *const NODE_TAG = "tigo_monitor.nodes";
+
+static constexpr uint32_t kNodeImageMagic = 0x544E4754;  // "TGNT"
+static constexpr uint8_t kNodeImageVersion = 1;
+// Upper bound on chunks. 16 x ~2 KB holds 100 nodes even with every label at
+// its 63-byte cap, with room to spare.
+static constexpr uint8_t kNodeImageMaxChunks = 16;
+// Labels longer than this are truncated on save. CCA labels are short
+// ("East Roof Panel 3"); the cap only exists so the worst case is bounded.
+static constexpr size_t kNodeLabelMax = 63;
+
+// Per-record flags.
+enum : uint8_t {
+  NODE_VALIDATED = 1u << 0,  // cca_validated
+  NODE_ADDR_TEXT = 1u << 1,  // addr did not round-trip as 4 hex digits; stored as text
+  NODE_LONG_TEXT = 1u << 2,  // long_address did not round-trip as 16 hex digits (or is empty)
+  NODE_HEX_LOWER = 1u << 3,  // the hex identities were lowercase
+};
+
+// One NVS blob. Every chunk repeats the image header so any one of them can be
+// validated on its own; `crc` covers the concatenated payload of all chunks.
+struct NodeTableChunk {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t index;        // this chunk's position, 0-based
+  uint8_t count;        // chunks in the image
+  uint8_t generation;   // counts up per save, alternating sets; 0 before A/B
+  uint16_t len;         // payload bytes used in this chunk
+  uint16_t node_count;  // records in the whole image
+  uint32_t total_len;   // payload bytes across all chunks
+  uint32_t crc;
+  uint8_t payload[2048 - 20];
+};
+static_assert(sizeof(NodeTableChunk) == 2048, "NodeTableChunk must stay 2 KB");
+
+// Set A keeps the keys of the single-set layout, so an image written before
+// the sets existed loads as set A, generation 0.
+static constexpr uint8_t kNodeImageSets = 2;
+
+static uint32_t node_chunk_hash_(uint8_t set, uint8_t index, char (&key)[24]) {
+  snprintf(key, sizeof(key), set == 0 ? "node_table_v1_%u" : "node_table_v1b_%u", (unsigned) index);
+  return fnv1_hash(key);
+}
+
+// Generations wrap; with two sets they are one apart, so serial-number
+// comparison is enough.
+static bool node_generation_newer_(uint8_t a, uint8_t b) { return (int8_t) (uint8_t) (a - b) > 0; }
+
+// CRC-32 (IEEE) from ROM, as the warm image and the trend sidecar use. Seeded
+// with 0 it is the standard value, so images written before this still check.
+static uint32_t node_crc32_(const uint8_t *data, size_t len) { return esp_rom_crc32_le(0, data, len); }
+
+// --- encoding ---------------------------------------------------------------
+
+// Parses exactly `digits` hex characters. Returns false on anything else, or
+// on mixed case, which would not survive the round trip.
+static bool parse_hex_id_(const node_string &s, size_t digits, uint64_t &out, bool &lower) {
+  if (s.size() != digits) return false;
+  bool has_upper = false, has_lower = false;
+  uint64_t v = 0;
+  for (char c : s) {
+    uint8_t d;
+    if (c >= '0' && c <= '9') {
+      d = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      d = c - 'A' + 10;
+      has_upper = true;
+    } else if (c >= 'a' && c <= 'f') {
+      d = c - 'a' + 10;
+      has_lower = true;
+    } else {
+      return false;
+    }
+    v = (v << 4) | d;
+  }
+  if (has_upper && has_lower) return false;
+  out = v;
+  lower = has_lower;
+  return true;
+}
+
+static void put_u16_(node_vector<uint8_t> &buf, uint16_t v) {
+  buf.push_back(v & 0xFF);
+  buf.push_back(v >> 8);
+}
+
+static void put_u64_(node_vector<uint8_t> &buf, uint64_t v) {
+  for (int i = 0; i < 8; ++i) buf.push_back((v >> (8 * i)) & 0xFF);
+}
+
+static void put_str_(node_vector<uint8_t> &buf, const node_string &s) {
+  size_t n = std::min(s.size(), kNodeLabelMax);
+  buf.push_back((uint8_t) n);
+  buf.insert(buf.end(), s.begin(), s.begin() + n);
+}
+
+static void encode_node_(node_vector<uint8_t> &buf, const NodeTableData &node) {
+  uint64_t addr = 0, long_addr = 0;
+  bool addr_lower = false, long_lower = false;
+  bool addr_hex = parse_hex_id_(node.addr, 4, addr, addr_lower);
+  bool long_hex = parse_hex_id_(node.long_address, 16, long_addr, long_lower);
+  // One case flag for both identities; if they disagree, the long address
+  // falls back to text rather than come back with its case changed.
+  if (addr_hex && long_hex && addr_lower != long_lower) long_hex = false;
+
+  uint8_t flags = 0;
+  if (node.cca_validated) flags |= NODE_VALIDATED;
+  if (!addr_hex) flags |= NODE_ADDR_TEXT;
+  if (!long_hex) flags |= NODE_LONG_TEXT;
+  if ((addr_hex && addr_lower) || (!addr_hex && long_hex && long_lower)) flags |= NODE_HEX_LOWER;
+  buf.push_back(flags);
+
+  if (addr_hex) {
+    put_u16_(buf, (uint16_t) addr);
+  } else {
+    put_str_(buf, node.addr);
+  }
+  if (long_hex) {
+    put_u64_(buf, long_addr);
+  } else {
+    put_str_(buf, node.long_address);
+  }
+  put_str_(buf, node.checksum);
+  put_u16_(buf, (uint16_t) (int16_t) node.sensor_index);
+  put_str_(buf, node.cca_label);
+  put_str_(buf, node.cca_string_label);
+  put_str_(buf, node.cca_inverter_label);
+  put_str_(buf, node.cca_channel);
+  put_str_(buf, node.cca_object_id);
+}
+
+// --- decoding ---------------------------------------------------------------
+
+struct NodeReader {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool ok = true;
+
+  bool need(size_t n) {
+    if (ok && (size_t) (end - p) >= n) return true;
+    ok = false;
+    return false;
+  }
+  uint8_t u8() { return need(1) ? *p++ : 0; }
+  uint16_t u16() {
+    if (!need(2)) return 0;
+    uint16_t v = p[0] | (p[1] << 8);
+    p += 2;
+    return v;
+  }
+  uint64_t u64() {
+    if (!need(8)) return 0;
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    p += 8;
+    return v;
+  }
+  node_string str() {
+    uint8_t n = u8();
+    if (!need(n)) return node_string();
+    node_string s(reinterpret_cast<const char *>(p), n);
+    p += n;
+    return s;
+  }
+};
+
+static node_string format_hex_id_(uint64_t v, int digits, bool lower) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), lower ? "%0*llx" : "%0*llX", digits, (unsigned long long) v);
+  return node_string(buf);
+}
+
+static bool decode_node_(NodeReader &r, NodeTableData &node) {
+  uint8_t flags = r.u8();
+  bool lower = flags & NODE_HEX_LOWER;
+  node.addr = (flags & NODE_ADDR_TEXT) ? r.str() : format_hex_id_(r.u16(), 4, lower);
+  node.long_address = (flags & NODE_LONG_TEXT) ? r.str() : format_hex_id_(r.u64(), 16, lower);
+  node.checksum = r.str();
+  node.sensor_index = (int16_t) r.u16();
+  node.cca_label = r.str();
+  node.cca_string_label = r.str();
+  node.cca_inverter_label = r.str();
+  node.cca_channel = r.str();
+  node.cca_object_id = r.str();
+  node.cca_validated = flags & NODE_VALIDATED;
+  node.is_persistent = true;
+  return r.ok;
+}
+
+// --- component ---------------------------------------------------------------
+
+void TigoMonitorComponent::load_node_table() {
+  ESP_LOGI(NODE_TAG, "Loading persistent node table...");
+  barcode_index_dirty_ = true;
+  if (load_node_table_image_()) return;
+
+  // No image yet: this is the first boot on this firmware (or the image was
+  // torn). Fall back to the per-slot text layouts and convert.
+  node_vector<uint16_t> slots_read;
+  int legacy = load_node_table_legacy_(slots_read);
+  if (legacy <= 0 && slots_read.empty()) {
+    ESP_LOGI(NODE_TAG, "No persistent node table found");
+    return;
+  }
+  if (legacy > 0) save_node_table();
+  // The image has to be on flash before the slots it replaces go, or a reset
+  // in between loses the table. If anything is still pending after a forced
+  // commit, leave the slots for now; they are never read once an image
+  // exists, they only take up space.
+  this->persist_commit_(true);
+  if (persist_totals_.pending != 0) {
+    ESP_LOGW(NODE_TAG, "Node table image not committed; keeping %u legacy slot(s)", (unsigned) slots_read.size());
+    return;
+  }
+  // Erase only the slots that held something: absent ones cost nothing, and
+  // a 256-byte blank written to every key up to number_of_devices_ would
+  // have taken more NVS than the table it replaced.
+  size_t erased = 0;
+  char pref_key[32];
+  for (uint16_t slot : slots_read) {
+    snprintf(pref_key, sizeof(pref_key), "node_%u", (unsigned) slot);
+    if (this->persist_erase_(fnv1_hash(pref_key))) erased++;
+  }
+  ESP_LOGI(NODE_TAG, "Migrated %d node table entries to the binary image, erased %zu of %zu legacy slot(s)", legacy,
+           erased, slots_read.size());
+}
+
+bool TigoMonitorComponent::read_node_image_set_(uint8_t set, node_vector<uint8_t> &payload,
+                                                uint16_t &node_count, uint8_t &generation, uint8_t &count) {
+  // Staged in PSRAM (node_vector): 2 KB per chunk is too much for the loop
+  // task's stack, and the payload is discarded as soon as it is parsed.
+  node_vector<uint8_t> staging(sizeof(NodeTableChunk));
+  auto *chunk = reinterpret_cast<NodeTableChunk *>(staging.data());
+
+  char key[24];
+  uint32_t hash = node_chunk_hash_(set, 0, key);
+  if (!this->persist_load_(hash, key, chunk)) return false;
+  if (chunk->magic != kNodeImageMagic || chunk->index != 0 || chunk->count == 0 ||
+      chunk->count > kNodeImageMaxChunks) {
+    return false;
+  }
+  if (chunk->version != kNodeImageVersion) {
+    ESP_LOGW(NODE_TAG, "Node table image version %u not understood", (unsigned) chunk->version);
+    return false;
+  }
+
+  count = chunk->count;
+  generation = chunk->generation;
+  node_count = chunk->node_count;
+  const uint32_t total_len = chunk->total_len;
+  const uint32_t crc = chunk->crc;
+  if (total_len > (uint32_t) count * sizeof(chunk->payload)) return false;
+
+  payload.clear();
+  payload.reserve(total_len);
+  for (uint8_t i = 0; i < count; ++i) {
+    if (i > 0 && !this->persist_load_(node_chunk_hash_(set, i, key), key, chunk)) {
+      ESP_LOGW(NODE_TAG, "Node table image %c chunk %u missing", 'A' + set, (unsigned) i);
+      return false;
+    }
+    if (chunk->magic != kNodeImageMagic || chunk->index != i || chunk->count != count ||
+        chunk->generation != generation || chunk->crc != crc || chunk->len > sizeof(chunk->payload)) {
+      ESP_LOGW(NODE_TAG, "Node table image %c chunk %u inconsistent", 'A' + set, (unsigned) i);
+      return false;
+    }
+    payload.insert(payload.end(), chunk->payload, chunk->payload + chunk->len);
+  }
+  if (payload.size() != total_len || node_crc32_(payload.data(), payload.size()) != crc) {
+    ESP_LOGW(NODE_TAG, "Node table image %c failed CRC", 'A' + set);
+    return false;
+  }
+  return true;
+}
+
+bool TigoMonitorComponent::load_node_table_image_() {
+  // Read both sets and keep the newest that checks out. A set that fails is
+  // most likely the one a save was writing when power went.
+  node_vector<uint8_t> payloads[kNodeImageSets];
+  uint16_t node_counts[kNodeImageSets] = {};
+  uint8_t generations[kNodeImageSets] = {};
+  uint8_t counts[kNodeImageSets] = {};
+  bool valid[kNodeImageSets] = {};
+  for (uint8_t set = 0; set < kNodeImageSets; ++set)
+    valid[set] = this->read_node_image_set_(set, payloads[set], node_counts[set], generations[set], counts[set]);
+  if (!valid[0] && !valid[1]) return false;
+  const uint8_t set = !valid[0] ? 1 : !valid[1] ? 0 : node_generation_newer_(generations[1], generations[0]) ? 1 : 0;
+
+  const node_vector<uint8_t> &payload = payloads[set];
+  NodeReader r{payload.data(), payload.data() + payload.size()};
+  node_table_.clear();
+  node_table_.reserve(node_counts[set]);
+  for (uint16_t i = 0; i < node_counts[set]; ++i) {
+    NodeTableData node;
+    if (!decode_node_(r, node)) {
+      // The CRC matched, so this is a writer bug, not flash damage. Keep
+      // what decoded rather than lose the whole table.
+      ESP_LOGE(NODE_TAG, "Node table image truncated at record %u", (unsigned) i);
+      break;
+    }
+    node_table_.push_back(node);
+  }
+  node_image_crc_ = node_crc32_(payload.data(), payload.size());
+  node_image_len_ = payload.size();
+  node_image_known_ = true;
+  node_image_set_ = set;
+  node_image_generation_ = generations[set];
+  ESP_LOGI(NODE_TAG, "Loaded %zu node table entries from image %c (generation %u, %u chunk(s), %zu bytes, "
+           "capacity: %d devices)",
+           node_table_.size(), 'A' + set, (unsigned) generations[set], (unsigned) counts[set], payload.size(),
+           number_of_devices_);
+  return true;
+}
+
+int TigoMonitorComponent::load_node_table_legacy_(node_vector<uint16_t> &slots_read) {
+  // Pre-allocate string buffer to avoid repeated allocations
+  static std::string pref_key;
+  pref_key.reserve(32);
+
+  int loaded_count = 0;
+  // Load node table entries up to the configured number of devices
+  for (int i = 0; i < number_of_devices_; i++) {
+    pref_key = "node_";
+    pref_key += std::to_string(i);
+    uint32_t hash = esphome::fnv1_hash(pref_key);
+
+    // Use char array for ESPHome preferences
+    char node_data[256] = {0};
+
+    if (this->persist_load_(hash, pref_key.c_str(), &node_data) && strlen(node_data) > 0) {
+      slots_read.push_back((uint16_t) i);
+      // Format: "addr|long_addr|checksum|barcode|sensor_index"
+      std::string node_str(node_data);
+      std::vector<std::string> parts;
+      size_t start = 0, end = 0;
+
+      // Split by '|' delimiter
+      while ((end = node_str.find('|', start)) != std::string::npos) {
+        parts.push_back(node_str.substr(start, end - start));
+        start = end + 1;
+      }
+      parts.push_back(node_str.substr(start)); // Last part
+
+      // Current format (9 fields): addr|long_address|checksum|sensor_index|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
+      // Old format (10 fields): addr|long_address|checksum|frame09_barcode|sensor_index|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
+      // Legacy format (4 fields): addr|long_address|checksum|sensor_index
+      if (parts.size() >= 4) {
+        NodeTableData node;
+        node.addr = parts[0];
+        node.long_address = parts[1];
+        node.checksum = parts[2];
+
+        // Determine sensor index position based on format
+        int sensor_idx_pos = (parts.size() >= 10) ? 4 : 3;  // Old format with frame09 at position 3
+        if (sensor_idx_pos < parts.size()) {
+          node.sensor_index = std::stoi(parts[sensor_idx_pos]);
+          node.is_persistent = true;
+        } else {
+          continue;  // Skip malformed entry
+        }
+
+        // Load CCA fields if available
+        if (parts.size() >= 10) {
+          // Old format: addr|long_addr|checksum|frame09|sensor_idx|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
+          node.cca_label = parts[5];
+          node.cca_string_label = parts[6];
+          node.cca_inverter_label = parts[7];
+          node.cca_channel = parts[8];
+          node.cca_validated = (parts[9] == "1");
+
+          // Replace "Inverter" with "MPPT" for more accurate terminology
+          if (node.cca_inverter_label.find("Inverter ") == 0) {
+            node.cca_inverter_label.replace(0, 9, "MPPT ");
+          }
+
+          ESP_LOGI(NODE_TAG, "Restored node (old format): %s -> Tigo %d (barcode: %s, string: %s, validated: %s)",
+                   node.addr.c_str(), node.sensor_index + 1, node.long_address.c_str(),
+                   node.cca_string_label.c_str(), node.cca_validated ? "yes" : "no");
+        } else if (parts.size() >= 9) {
+          // Current format: addr|long_addr|checksum|sensor_idx|cca_label|cca_string|cca_inverter|cca_channel|cca_validated
+          node.cca_label = parts[4];
+          node.cca_string_label = parts[5];
+          node.cca_inverter_label = parts[6];
+          node.cca_channel = parts[7];
+          node.cca_validated = (parts[8] == "1");
+
+          // Replace "Inverter" with "MPPT" for more accurate terminology
+          if (node.cca_inverter_label.find("Inverter ") == 0) {
+            node.cca_inverter_label.replace(0, 9, "MPPT ");
+          }
+
+          ESP_LOGI(NODE_TAG, "Restored node with CCA: %s -> Tigo %d (barcode: %s, string: %s, validated: %s)",
+                   node.addr.c_str(), node.sensor_index + 1, node.long_address.c_str(),
+                   node.cca_string_label.c_str(), node.cca_validated ? "yes" : "no");
+        } else {
+          // Old format without CCA fields - initialize to defaults
+          node.cca_label = "";
+          node.cca_string_label = "";
+          node.cca_inverter_label = "";
+          node.cca_channel = "";
+          node.cca_validated = false;
+
+          ESP_LOGI(NODE_TAG, "Restored node (legacy format): %s -> Tigo %d (barcode: %s)",
+                   node.addr.c_str(), node.sensor_index + 1, node.long_address.c_str());
+        }
+
+        node_table_.push_back(node);
+        loaded_count++;
+      }
+    }
+  }
+
+  ESP_LOGI(NODE_TAG, "Loaded %d legacy node table entries (capacity: %d devices)", loaded_count, number_of_devices_);
+  return loaded_count;
+}
+
+void TigoMonitorComponent::save_node_table() {
+  node_vector<uint8_t> payload;
+  payload.reserve(node_table_.size() * 64);
+  uint16_t node_count = 0;
+  const size_t capacity = (size_t) kNodeImageMaxChunks * sizeof(NodeTableChunk::payload);
+  for (const auto &node : node_table_) {
+    if (node_count >= number_of_devices_) break;
+    if (!node.is_persistent) continue;
+    size_t before = payload.size();
+    encode_node_(payload, node);
+    if (payload.size() > capacity) {
+      payload.resize(before);
+      ESP_LOGE(NODE_TAG, "Node table image full at %u entries; the rest are not persisted",
+               (unsigned) node_count);
+      break;
+    }
+    node_count++;
+  }
+
+  // Frame 27 and CCA refreshes call this on every pass whether or not anything
+  // moved. An identical image is not worth even a queued NVS write.
+  uint32_t crc = node_crc32_(payload.data(), payload.size());
+  if (node_image_known_ && crc == node_image_crc_ && payload.size() == node_image_len_) {
+    ESP_LOGD(NODE_TAG, "Node table unchanged (%u entries), not saving", (unsigned) node_count);
+    return;
+  }
+
+  // Write the other set from the last image, unless that image is still
+  // waiting in the persist layer: then it is not on flash yet, the other set
+  // is the only complete copy, and the new image replaces the pending one.
+  char key[24];
+  bool last_pending = false;
+  {
+    StateLock lock(state_mutex_);
+    for (uint8_t i = 0; i < kNodeImageMaxChunks && !last_pending; ++i) {
+      auto it = persist_.find(node_chunk_hash_(node_image_set_, i, key));
+      last_pending = it != persist_.end() && it->second.dirty;
+    }
+  }
+  const uint8_t set = last_pending ? node_image_set_ : (uint8_t) (1 - node_image_set_);
+  // A rewrite keeps its generation, so the two sets stay one apart.
+  const uint8_t generation = last_pending ? node_image_generation_ : (uint8_t) (node_image_generation_ + 1);
+
+  node_vector<uint8_t> staging(sizeof(NodeTableChunk));
+  auto *chunk = reinterpret_cast<NodeTableChunk *>(staging.data());
+  const size_t per_chunk = sizeof(chunk->payload);
+  uint8_t count = (uint8_t) std::max<size_t>(1, (payload.size() + per_chunk - 1) / per_chunk);
+  for (uint8_t i = 0; i < count; ++i) {
+    memset(chunk, 0, sizeof(NodeTableChunk));
+    size_t off = (size_t) i * per_chunk;
+    size_t len = std::min(per_chunk, payload.size() - std::min(off, payload.size()));
+    chunk->magic = kNodeImageMagic;
+    chunk->version = kNodeImageVersion;
+    chunk->index = i;
+    chunk->count = count;
+    chunk->generation = generation;
+    chunk->len = (uint16_t) len;
+    chunk->node_count = node_count;
+    chunk->total_len = (uint32_t) payload.size();
+    chunk->crc = crc;
+    if (len > 0) memcpy(chunk->payload, payload.data() + off, len);
+    uint32_t hash = node_chunk_hash_(set, i, key);
+    this->persist_save_(hash, key, *chunk, kPersistNodeTableMs);
+  }
+  // Chunks past `count` from a larger earlier image are left as they are:
+  // chunk 0 says how many to read, so they are never looked at.
+  node_image_crc_ = crc;
+  node_image_len_ = payload.size();
+  node_image_known_ = true;
+  node_image_set_ = set;
+  node_image_generation_ = generation;
+  ESP_LOGD(NODE_TAG, "Saved %u node table entries to image %c (generation %u, %zu bytes, %u chunk(s))",
+           (unsigned) node_count, 'A' + set, (unsigned) generation, payload.size(), (unsigned) count);
+}
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,232 @@
+// Persistence manager — the one path every NVS write in the component goes
+// through.
+//
+// Peak power, energy totals, the daily history, the node table, display
+// names, ratings, config overrides and cloud credentials each used to call
+// ESPPreferenceObject::save() on their own schedule: hourly, on night-mode
+// entry, at midnight, on shutdown, on every rename and every Frame 27 burst.
+// Unchanged values were rewritten each time (save_peak_power_data wrote every
+// device's peak on every batch whether it had moved or not), and nothing
+// recorded how often any of it happened, so flash wear on a long-running
+// install was a guess.
+//
+// Now a save only stages bytes. Per key it:
+//   - drops the value when it matches what NVS already holds (the last value
+//     written, or the one loaded at boot);
+//   - replaces a still-pending value in place, so five energy saves inside
+//     one window cost one write;
+//   - writes everything staged in one pass once the earliest entry's delay has
+//     run out, and never more often than kPersistMinCommitGapMs.
+// User edits stage with no delay and land on the next loop pass; telemetry
+// waits minutes. Shutdown, night-mode entry and the midnight batch commit
+// immediately and ask ESPHome to sync.
+//
+// Wear is estimated in NVS's own unit, the 32-byte entry: a blob costs an
+// index entry, a chunk header and one entry per 32 bytes of data, and a page
+// (126 entries) is erased once per lap of the partition's free space. Against
+// a typical 100k-cycle sector endurance that gives a years-to-wear-out figure
+// at this boot's write rate.
+
+#include "tigo_monitor.h"
+
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef USE_ESP_IDF
+#include <cinttypes>
+#include <esp_partition.h>
+#include <nvs.h>
+#endif
+
+namespace esphome {
+namespace tigo_monitor {
+
+static const char *const PERSIST_TAG = "tigo_monitor.persist";
+
+// Never run two commits closer together than this, however urgent.
+static constexpr uint32_t kPersistMinCommitGapMs = 5000;
+// A write that failed is retried after this long.
+static constexpr uint32_t kPersistRetryMs = 60000;
+// NVS layout constants (ESP-IDF nvs_flash): 32-byte entries, 126 per 4 KB page.
+static constexpr uint32_t kNvsEntryBytes = 32;
+static constexpr uint32_t kNvsEntriesPerPage = 126;
+static constexpr uint32_t kNvsPageBytes = 4096;
+static constexpr float kNvsEraseEndurance = 100000.0f;
+
+// millis() comparisons that survive the 49-day wrap.
+static bool persist_before_(uint32_t a, uint32_t b) { return (int32_t) (a - b) < 0; }
+
+TigoMonitorComponent::PersistEntry &TigoMonitorComponent::persist_entry_(uint32_t hash, const char *key,
+                                                                        size_t size) {
+  auto it = persist_.find(hash);
+  if (it == persist_.end()) {
+    it = persist_.emplace(hash, PersistEntry{}).first;
+    strncpy(it->second.key, key, sizeof(it->second.key) - 1);
+    it->second.size = (uint16_t) size;
+  }
+  return it->second;
+}
+
+void TigoMonitorComponent::persist_stage_(PersistEntry &e, const uint8_t *bytes, uint32_t delay_ms) {
+  persist_totals_.saves++;
+  const bool same_as_nvs = e.committed_known && memcmp(e.committed.data(), bytes, e.size) == 0;
+  if (same_as_nvs) {
+    e.skipped++;
+    persist_totals_.skipped++;
+    if (e.dirty) {
+      // Changed and changed back before the window opened: nothing to write.
+      e.dirty = false;
+      persist_totals_.pending--;
+    }
+    return;
+  }
+
+  const uint32_t due = millis() + delay_ms;
+  if (e.dirty) {
+    if (memcmp(e.pending.data(), bytes, e.size) != 0) persist_totals_.coalesced++;
+    memcpy(e.pending.data(), bytes, e.size);
+    if (persist_before_(due, e.due_ms)) e.due_ms = due;
+  } else {
+    e.pending.assign(bytes, bytes + e.size);
+    e.dirty = true;
+    e.due_ms = due;
+    if (persist_totals_.pending == 0 || persist_before_(due, persist_next_due_ms_)) persist_next_due_ms_ = due;
+    persist_totals_.pending++;
+    return;
+  }
+  if (persist_before_(e.due_ms, persist_next_due_ms_)) persist_next_due_ms_ = e.due_ms;
+}
+
+void TigoMonitorComponent::persist_commit_(bool force) {
+  StateLock lock(state_mutex_);
+  const uint32_t now = millis();
+  if (persist_totals_.pending == 0) {
+    if (force) global_preferences->sync();
+    return;
+  }
+  if (!force) {
+    if (persist_before_(now, persist_next_due_ms_)) return;
+    if (persist_totals_.commits > 0 && now - persist_last_commit_ms_ < kPersistMinCommitGapMs) return;
+  }
+
+  // Everything staged goes, not only what is due: the entries share the
+  // sync ESPHome does afterwards, and a deferred entry riding along with an
+  // urgent one costs no extra commit.
+  uint32_t written = 0;
+  uint32_t next_due = 0;
+  bool have_next = false;
+  for (auto &pair : persist_) {
+    PersistEntry &e = pair.second;
+    if (!e.dirty) continue;
+    auto it = pref_cache_.find(pair.first);
+    if (e.write == nullptr || it == pref_cache_.end() || !e.write(it->second, e.pending.data())) {
+      persist_totals_.failed++;
+      e.due_ms = now + kPersistRetryMs;
+      if (!have_next || persist_before_(e.due_ms, next_due)) next_due = e.due_ms;
+      have_next = true;
+      ESP_LOGW(PERSIST_TAG, "NVS write failed for '%s', retrying", e.key);
+      continue;
+    }
+    // Keep one copy per idle key, not two.
+    e.committed.swap(e.pending);
+    e.pending.clear();
+    e.pending.shrink_to_fit();
+    e.committed_known = true;
+    e.dirty = false;
+    e.writes++;
+    persist_totals_.writes++;
+    persist_totals_.pending--;
+    persist_totals_.bytes_written += e.size;
+    persist_totals_.entries_written += 2 + (e.size + kNvsEntryBytes - 1) / kNvsEntryBytes;
+    written++;
+  }
+  persist_next_due_ms_ = next_due;
+  persist_totals_.commits++;
+  persist_last_commit_ms_ = now;
+  if (force) global_preferences->sync();
+  ESP_LOGD(PERSIST_TAG, "Committed %u NVS key(s)%s, %u pending", (unsigned) written, force ? " (forced)" : "",
+           (unsigned) persist_totals_.pending);
+}
+
+bool TigoMonitorComponent::persist_erase_(uint32_t hash) {
+  StateLock lock(state_mutex_);
+  auto it = persist_.find(hash);
+  if (it != persist_.end()) {
+    if (it->second.dirty) persist_totals_.pending--;
+    persist_.erase(it);
+  }
+#ifdef USE_ESP_IDF
+  // ESPPreferences has no delete, so this goes to NVS itself: ESPHome stores
+  // each preference as a blob in its "esphome" namespace under the decimal
+  // hash. Nothing may have a save of this key queued with ESPHome, which
+  // holds for keys only ever written through persist_save_() and dropped
+  // above.
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open("esphome", NVS_READWRITE, &handle);
+  if (err != ESP_OK) return false;
+  char key[12];
+  snprintf(key, sizeof(key), "%" PRIu32, hash);
+  err = nvs_erase_key(handle, key);
+  if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+  if (err == ESP_OK) err = nvs_commit(handle);
+  nvs_close(handle);
+  if (err != ESP_OK) {
+    ESP_LOGW(PERSIST_TAG, "NVS erase failed for key %s: %s", key, esp_err_to_name(err));
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TigoMonitorComponent::snapshot_persist_stats(PersistStats &out) const {
+  static uint32_t nvs_pages = 0;
+#ifdef USE_ESP_IDF
+  if (nvs_pages == 0) {
+    const esp_partition_t *part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, nullptr);
+    if (part != nullptr) nvs_pages = part->size / kNvsPageBytes;
+  }
+#endif
+
+  StateLock lock(state_mutex_);
+  out = persist_totals_;
+  out.keys = persist_.size();
+  out.last_commit_age_s = out.commits > 0 ? (millis() - persist_last_commit_ms_) / 1000 : 0;
+  out.nvs_pages = nvs_pages;
+
+  // NVS keeps one page free for garbage collection, so a lap of the
+  // partition is (pages - 1) pages of entries.
+  if (nvs_pages > 1) {
+    out.page_erases = (float) out.entries_written / (float) (kNvsEntriesPerPage * (nvs_pages - 1));
+    float uptime_years = (float) millis() / 1000.0f / 86400.0f / 365.25f;
+    if (out.page_erases > 0.0f && uptime_years > 0.0f) {
+      out.years_to_endurance = kNvsEraseEndurance / (out.page_erases / uptime_years);
+    }
+  }
+
+  out.top_count = 0;
+  for (const auto &pair : persist_) {
+    const PersistEntry &e = pair.second;
+    if (e.writes == 0 && e.skipped == 0) continue;
+    // Insertion into a short descending array; at most a few hundred keys.
+    size_t pos = out.top_count;
+    while (pos > 0 && out.top[pos - 1].writes < e.writes) pos--;
+    if (pos >= PersistStats::kTopKeys) continue;
+    size_t last = std::min(out.top_count, PersistStats::kTopKeys - 1);
+    for (size_t i = last; i > pos; --i) out.top[i] = out.top[i - 1];
+    PersistKeyStat &k = out.top[pos];
+    memcpy(k.key, e.key, sizeof(k.key));
+    k.writes = e.writes;
+    k.skipped = e.skipped;
+    k.size = e.size;
+    if (out.top_count < PersistStats::kTopKeys) out.top_count++;
+  }
+}
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,169 @@
+#pragma once
+
+// Fixed-memory streaming quartiles for per-string panel distributions.
+//
+// The UI wants the median and spread of panel power inside each string, and
+// underperformance checks want a reference value to compare a panel against.
+// Computing either exactly means holding (or shipping to the browser) every
+// panel's latest reading. Instead each string carries one P² estimator per
+// quartile per metric (Jain & Chlamtac, CACM 1985): five markers each, updated
+// in O(1) per frame, no buffer of observations at all.
+//
+// The sketch is windowed, not lifetime. update_string_data() publishes its
+// current estimate into StringData and resets it every update interval, so the
+// numbers describe the panels *now* rather than blending the whole day — a
+// lifetime median of power would mostly be measuring the sun's position. With
+// five or fewer frames in a window P² has no markers to interpolate yet, and
+// the quantile is computed exactly from the frames it has.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace tigo_monitor {
+
+class P2Quantile {
+ public:
+  explicit P2Quantile(float p = 0.5f) { reset(p); }
+
+  void reset(float p) {
+    p_ = p;
+    count_ = 0;
+    dn_[0] = 0.0f;
+    dn_[1] = p / 2.0f;
+    dn_[2] = p;
+    dn_[3] = (1.0f + p) / 2.0f;
+    dn_[4] = 1.0f;
+  }
+  void reset() { reset(p_); }
+
+  void add(float x) {
+    if (std::isnan(x)) return;
+    if (count_ < 5) {
+      q_[count_++] = x;
+      if (count_ == 5) {
+        std::sort(q_, q_ + 5);
+        for (int i = 0; i < 5; ++i) {
+          n_[i] = i;
+          np_[i] = 4.0f * dn_[i];
+        }
+      }
+      return;
+    }
+    ++count_;
+
+    // Locate the cell x falls in, stretching the extremes if it is outside.
+    int k;
+    if (x < q_[0]) {
+      q_[0] = x;
+      k = 0;
+    } else if (x >= q_[4]) {
+      q_[4] = x;
+      k = 3;
+    } else {
+      k = 0;
+      while (k < 3 && x >= q_[k + 1]) ++k;
+    }
+    for (int i = k + 1; i < 5; ++i) ++n_[i];
+    for (int i = 0; i < 5; ++i) np_[i] += dn_[i];
+
+    // Nudge the three middle markers toward their desired positions.
+    for (int i = 1; i <= 3; ++i) {
+      float d = np_[i] - n_[i];
+      if ((d >= 1.0f && n_[i + 1] - n_[i] > 1) || (d <= -1.0f && n_[i - 1] - n_[i] < -1)) {
+        int s = (d >= 0.0f) ? 1 : -1;
+        float qp = parabolic_(i, s);
+        if (q_[i - 1] < qp && qp < q_[i + 1]) {
+          q_[i] = qp;
+        } else {
+          q_[i] += s * (q_[i + s] - q_[i]) / (float) (n_[i + s] - n_[i]);
+        }
+        n_[i] += s;
+      }
+    }
+  }
+
+  uint32_t count() const { return count_; }
+
+  // NaN when nothing has been added since the last reset.
+  float value() const {
+    if (count_ == 0) return NAN;
+    if (count_ > 5) return q_[2];
+    float sorted[5];
+    std::copy(q_, q_ + count_, sorted);
+    std::sort(sorted, sorted + count_);
+    float pos = p_ * (count_ - 1);
+    int lo = (int) pos;
+    int hi = std::min<int>(lo + 1, count_ - 1);
+    return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+  }
+
+ private:
+  float parabolic_(int i, int s) const {
+    float d = (float) s;
+    return q_[i] + d / (float) (n_[i + 1] - n_[i - 1]) *
+                       ((n_[i] - n_[i - 1] + d) * (q_[i + 1] - q_[i]) / (float) (n_[i + 1] - n_[i]) +
+                        (n_[i + 1] - n_[i] - d) * (q_[i] - q_[i - 1]) / (float) (n_[i] - n_[i - 1]));
+  }
+
+  float p_;
+  uint32_t count_;
+  float q_[5];   // marker heights (the first five raw samples until count_ > 5)
+  int32_t n_[5];  // actual marker positions
+  float np_[5];  // desired marker positions
+  float dn_[5];  // desired-position increments
+};
+
+// Published per-window result. n == 0 means no frames arrived in the window;
+// the other fields are then NaN and /api/strings emits null.
+struct QuartileSummary {
+  float q1 = NAN;
+  float median = NAN;
+  float q3 = NAN;
+  float lower_fence = NAN;  // Tukey fences: q1 - 1.5 IQR ...
+  float upper_fence = NAN;  // ... and q3 + 1.5 IQR
+  uint32_t n = 0;
+};
+
+class QuartileSketch {
+ public:
+  QuartileSketch() : q1_(0.25f), median_(0.5f), q3_(0.75f) {}
+
+  void add(float x) {
+    q1_.add(x);
+    median_.add(x);
+    q3_.add(x);
+  }
+
+  void reset() {
+    q1_.reset();
+    median_.reset();
+    q3_.reset();
+  }
+
+  QuartileSummary summary() const {
+    QuartileSummary s;
+    s.n = median_.count();
+    if (s.n == 0) return s;
+    s.q1 = q1_.value();
+    s.median = median_.value();
+    s.q3 = q3_.value();
+    // Independent estimators can cross on a handful of samples; keep the
+    // ordering the consumer will assume.
+    if (s.q1 > s.median) s.q1 = s.median;
+    if (s.q3 < s.median) s.q3 = s.median;
+    float iqr = s.q3 - s.q1;
+    s.lower_fence = s.q1 - 1.5f * iqr;
+    s.upper_fence = s.q3 + 1.5f * iqr;
+    return s;
+  }
+
+ private:
+  P2Quantile q1_;
+  P2Quantile median_;
+  P2Quantile q3_;
+};
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,230 @@
+#pragma once
+
+// Result cache and single-flight for the flash-backed history queries.
+//
+// Every viewer of the History view asks for the same thing: the system series
+// at one tier over the same few ranges. Each request used to queue behind the
+// flash lock (up to 30 s behind a commit) and then repeat the scan the request
+// before it had just done, so flash reads per refresh grew with the number of
+// open tabs. Here the first request for a series runs the query and keeps the
+// rows; identical requests that arrive while it runs wait for it instead of
+// starting their own, and later ones are answered from the copy.
+//
+// An entry is keyed by (series, tier) and remembers the window it was read
+// for. The stored rows only change when the writer commits, so an entry stays
+// valid until the commit generation moves, and it answers any window inside
+// the one it holds — a `range=day` query a few seconds later has a slightly
+// later start and simply skips the rows that dropped out. If the entry was
+// read up to the newest committed row, its window is open-ended: nothing newer
+// exists until the next commit, which invalidates it anyway.
+//
+// Rows are kept as the tier callback sees them (ts, avg, min, max, energy) in
+// PSRAM, grown as the query runs. A result larger than kMaxRows is passed
+// through and not kept; downsampling to the request's `points` stays in the
+// handler, so one entry serves every budget.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+#ifdef USE_ESP_IDF
+#include <esp_heap_caps.h>
+#endif
+
+namespace esphome {
+namespace tigo_monitor {
+
+class HistoryQueryCache {
+ public:
+  struct Row {
+    uint32_t ts;
+    float avg;
+    float lo;
+    float hi;
+    float e_kwh;
+  };
+
+  // Four entries cover the system series at raw/hourly/daily plus one panel;
+  // at 2,048 rows an entry tops out at 40 KB, 160 KB of PSRAM in all.
+  static constexpr size_t kEntries = 4;
+  static constexpr size_t kMaxRows = 2048;
+  // The system series; panel series use their slot number (with the metric
+  // above it), string and inverter series kSeriesGroupBase | group << 8 | col.
+  static constexpr uint16_t kSeriesSystem = 0xFFFF;
+  static constexpr uint16_t kSeriesGroupBase = 0x8000;
+
+  HistoryQueryCache() = default;
+  ~HistoryQueryCache() {
+    for (auto &e : entries_) release_(e);
+  }
+  HistoryQueryCache(const HistoryQueryCache &) = delete;
+  HistoryQueryCache &operator=(const HistoryQueryCache &) = delete;
+
+  // Answers [start_ts, end_ts] of (series, tier) through `emit(const Row &)`.
+  // On a miss, `fill(sink)` runs the real query, calling sink(const Row &) per
+  // row, and returns its row count or -1; rows reach `emit` as they are read.
+  // `gen` is the writer's commit generation and `newest_ts` its newest
+  // committed row, both read before calling. `wait_ms` bounds how long a
+  // duplicate waits on the request already running. Returns rows emitted, or
+  // -1 if the query failed.
+  template<typename Emit, typename Fill>
+  int query(uint16_t series, uint8_t tier, uint32_t start_ts, uint32_t end_ts, uint32_t gen, uint32_t newest_ts,
+            uint32_t wait_ms, Emit &&emit, Fill &&fill) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_ms);
+    Entry *mine = nullptr;
+    for (;;) {
+      Entry *busy = nullptr;
+      for (auto &e : entries_) {
+        if (e.state == Entry::FREE || e.series != series || e.tier != tier || e.gen != gen) continue;
+        if (!e.covers(start_ts, end_ts)) continue;
+        if (e.state == Entry::READY) {
+          // Pinned so it is not evicted or refilled while we read it unlocked.
+          e.readers++;
+          e.last_use = ++clock_;
+          hits_++;
+          lock.unlock();
+          int n = 0;
+          for (size_t i = 0; i < e.count; ++i) {
+            const Row &r = e.rows[i];
+            if (r.ts < start_ts) continue;
+            if (r.ts > end_ts) break;
+            emit(r);
+            n++;
+          }
+          lock.lock();
+          e.readers--;
+          return n;
+        }
+        busy = &e;  // FILLING
+      }
+      if (busy == nullptr) break;
+      // Single flight: the same rows are on their way. Wait, then look again —
+      // if that query failed or was too big to keep, we run our own.
+      coalesced_++;
+      if (done_.wait_until(lock, deadline) == std::cv_status::timeout) break;
+    }
+
+    // Miss. Take the least recently used entry that nobody is reading.
+    for (auto &e : entries_) {
+      if (e.readers > 0 || e.state == Entry::FILLING) continue;
+      if (mine == nullptr || e.state == Entry::FREE || (mine->state != Entry::FREE && e.last_use < mine->last_use))
+        mine = &e;
+    }
+    misses_++;
+    if (mine != nullptr) {
+      mine->state = Entry::FILLING;
+      mine->series = series;
+      mine->tier = tier;
+      mine->gen = gen;
+      mine->start_ts = start_ts;
+      mine->end_ts = end_ts;
+      mine->open_ended = end_ts >= newest_ts;
+      mine->count = 0;
+      mine->overflow = false;
+    }
+    lock.unlock();
+
+    int n = fill([&](const Row &r) {
+      emit(r);
+      if (mine != nullptr) store_(*mine, r);
+    });
+
+    if (mine != nullptr) {
+      lock.lock();
+      mine->state = (n >= 0 && !mine->overflow) ? Entry::READY : Entry::FREE;
+      mine->last_use = ++clock_;
+      if (mine->state == Entry::FREE) release_(*mine);
+      lock.unlock();
+      done_.notify_all();
+    }
+    return n;
+  }
+
+  struct Info {
+    uint32_t hits{0};
+    uint32_t misses{0};
+    uint32_t coalesced{0};
+    size_t entries{0};  // READY entries
+    size_t rows{0};     // rows held across them
+  };
+  Info info() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    Info out;
+    out.hits = hits_;
+    out.misses = misses_;
+    out.coalesced = coalesced_;
+    for (const auto &e : entries_) {
+      if (e.state != Entry::READY) continue;
+      out.entries++;
+      out.rows += e.count;
+    }
+    return out;
+  }
+
+ private:
+  struct Entry {
+    enum State : uint8_t { FREE, FILLING, READY };
+    State state{FREE};
+    uint16_t series{0};
+    uint8_t tier{0};
+    bool open_ended{false};
+    bool overflow{false};
+    uint32_t gen{0};
+    uint32_t start_ts{0};
+    uint32_t end_ts{0};
+    uint32_t last_use{0};
+    uint32_t readers{0};
+    Row *rows{nullptr};
+    size_t count{0};
+    size_t cap{0};
+
+    bool covers(uint32_t s, uint32_t e) const { return s >= start_ts && (e <= end_ts || open_ended); }
+  };
+
+  // Only the filling request touches an entry's rows, so no lock here.
+  static void store_(Entry &e, const Row &r) {
+    if (e.overflow) return;
+    if (e.count == e.cap) {
+      size_t cap = e.cap == 0 ? 256 : e.cap * 2;
+      if (cap > kMaxRows) cap = kMaxRows;
+      if (cap == e.cap) {
+        e.overflow = true;
+        return;
+      }
+#ifdef USE_ESP_IDF
+      Row *grown = static_cast<Row *>(heap_caps_realloc(e.rows, cap * sizeof(Row), MALLOC_CAP_SPIRAM));
+#else
+      Row *grown = static_cast<Row *>(realloc(e.rows, cap * sizeof(Row)));
+#endif
+      if (grown == nullptr) {
+        e.overflow = true;
+        return;
+      }
+      e.rows = grown;
+      e.cap = cap;
+    }
+    e.rows[e.count++] = r;
+  }
+
+  static void release_(Entry &e) {
+    free(e.rows);  // heap_caps_realloc memory is free()-able
+    e.rows = nullptr;
+    e.count = 0;
+    e.cap = 0;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable done_;
+  Entry entries_[kEntries];
+  uint32_t clock_{0};
+  uint32_t hits_{0};
+  uint32_t misses_{0};
+  uint32_t coalesced_{0};
+};
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,191 @@
+#pragma once
+
+// Frame-rate recent history, one RAM ring per device.
+//
+// The on-flash history (tigo_history.h) stores one row per `history_interval`,
+// 30 min by default, so anything shorter than that — a cloud edge, a shading
+// pass, an optimizer dropping out for ninety seconds — never reaches it. The
+// only way to see it there is to turn the interval down, which costs flash wear
+// and retention. This ring keeps the last N raw power frames per device in
+// PSRAM instead, and /api/recent serves it without going near flash.
+//
+// Samples are 10 bytes: the time since the previous sample plus int16 power,
+// voltage, current and temperature in fixed-point. At 720 samples that is ~7 KB
+// a device; 48 panels cost ~340 KB, which an 8 MB PSRAM board does not notice,
+// and a 32 MB P4 can hold a day at frame resolution for every panel.
+//
+// Timestamps are millis() deltas, so the ring needs no wall clock and survives
+// an SNTP step untouched. Deltas are whole deciseconds and the newest time
+// advances by exactly the stored delta, so every sample comes back within
+// 100 ms of its arrival however long the ring is. A gap longer than the delta
+// can express (~109 min, i.e. overnight) saturates, and only samples older
+// than that gap come out shifted.
+//
+// Not thread-safe on its own. Written from the main loop under the component
+// state lock; readers copy out under the same lock (copy_recent_samples).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+#ifdef USE_ESP_IDF
+#include <esp_heap_caps.h>
+#endif
+
+namespace esphome {
+namespace tigo_monitor {
+
+// Default ring depth per device, in samples. Overridden by `recent_samples`.
+static constexpr uint32_t kDefaultRecentSamples = 720;
+
+struct RecentSample {
+  uint16_t dt_ds;   // deciseconds since the previous sample (saturating)
+  int16_t p_dw;     // input power, 0.1 W
+  int16_t v_cv;     // input voltage, 0.01 V
+  int16_t i_ma;     // input current, mA
+  int16_t t_dc;     // temperature, 0.1 °C
+};
+
+// One decoded sample as handed to the web server: absolute millis() plus the
+// raw fixed-point fields, so the copy made under the state lock stays 12 bytes.
+struct RecentPoint {
+  uint32_t ts_ms;
+  int16_t p_dw;
+  int16_t v_cv;
+  int16_t i_ma;
+  int16_t t_dc;
+};
+
+class RecentRing {
+ public:
+  RecentRing() = default;
+  ~RecentRing() { release_(); }
+
+  RecentRing(const RecentRing &) = delete;
+  RecentRing &operator=(const RecentRing &) = delete;
+  RecentRing(RecentRing &&o) noexcept { take_(o); }
+  RecentRing &operator=(RecentRing &&o) noexcept {
+    if (this != &o) {
+      release_();
+      take_(o);
+    }
+    return *this;
+  }
+
+  // PSRAM only, deliberately no internal-heap fallback: on a board without
+  // PSRAM a few KB per device is exactly the fragmentation this component goes
+  // out of its way to avoid. Returns false (ring stays disabled) on failure.
+  bool init(size_t capacity) {
+    release_();
+    if (capacity == 0) return false;
+#ifdef USE_ESP_IDF
+    buf_ = static_cast<RecentSample *>(
+        heap_caps_malloc(capacity * sizeof(RecentSample), MALLOC_CAP_SPIRAM));
+#else
+    buf_ = static_cast<RecentSample *>(malloc(capacity * sizeof(RecentSample)));
+#endif
+    if (buf_ == nullptr) return false;
+    cap_ = capacity;
+    return true;
+  }
+
+  bool enabled() const { return buf_ != nullptr; }
+  size_t size() const { return count_; }
+  size_t capacity() const { return cap_; }
+
+  void push(uint32_t now_ms, float power_w, float voltage_v, float current_a, float temp_c) {
+    if (buf_ == nullptr) return;
+    RecentSample s;
+    uint32_t dt_ds = (count_ == 0) ? 0 : (now_ms - newest_ms_) / 100;
+    s.dt_ds = (uint16_t) (dt_ds > UINT16_MAX ? UINT16_MAX : dt_ds);
+    s.p_dw = enc_(power_w, 10.0f);
+    s.v_cv = enc_(voltage_v, 100.0f);
+    s.i_ma = enc_(current_a, 1000.0f);
+    s.t_dc = enc_(temp_c, 10.0f);
+    buf_[head_] = s;
+    head_ = (head_ + 1) % cap_;
+    // Advance by what was stored, not to now_ms: the sub-decisecond remainder
+    // stays in the next delta instead of being dropped every frame, which at
+    // ~1 frame/s would pull reconstructed timestamps back by up to a minute
+    // over a full ring. Only a saturated gap resynchronises to the clock.
+    if (count_ == 0 || dt_ds > UINT16_MAX) {
+      newest_ms_ = now_ms;
+    } else {
+      newest_ms_ += dt_ds * 100u;
+    }
+    if (count_ < cap_) ++count_;
+  }
+
+  // Calls fn(const RecentPoint &) oldest-first for every sample no older than
+  // since_ms (millis() domain, rollover-safe against newest). Returns count.
+  template<typename Fn> size_t for_each_since(uint32_t since_ms, Fn &&fn) const {
+    if (count_ == 0) return 0;
+    // A device that has been silent for the whole window has nothing in it.
+    if ((int32_t) (newest_ms_ - since_ms) < 0) return 0;
+    const uint32_t window = newest_ms_ - since_ms;
+
+    // Walk back from the newest sample to the oldest one inside the window.
+    size_t idx = (head_ + cap_ - 1) % cap_;
+    uint32_t ts = newest_ms_;
+    size_t n = 1;
+    while (n < count_) {
+      uint32_t step = (uint32_t) buf_[idx].dt_ds * 100u;
+      if (newest_ms_ - (ts - step) > window) break;
+      ts -= step;
+      idx = (idx + cap_ - 1) % cap_;
+      ++n;
+    }
+    // idx/ts now address the oldest sample in the window; emit forwards.
+    for (size_t k = 0; k < n; ++k) {
+      const RecentSample &s = buf_[idx];
+      if (k > 0) ts += (uint32_t) s.dt_ds * 100u;
+      RecentPoint p{ts, s.p_dw, s.v_cv, s.i_ma, s.t_dc};
+      fn(p);
+      idx = (idx + 1) % cap_;
+    }
+    return n;
+  }
+
+ private:
+  static int16_t enc_(float v, float scale) {
+    if (std::isnan(v)) return 0;
+    float x = v * scale;
+    if (x > 32767.0f) return 32767;
+    if (x < -32768.0f) return -32768;
+    return (int16_t) lroundf(x);
+  }
+
+  void release_() {
+    if (buf_ != nullptr) {
+#ifdef USE_ESP_IDF
+      heap_caps_free(buf_);
+#else
+      free(buf_);
+#endif
+    }
+    buf_ = nullptr;
+    cap_ = head_ = count_ = 0;
+    newest_ms_ = 0;
+  }
+
+  void take_(RecentRing &o) {
+    buf_ = o.buf_;
+    cap_ = o.cap_;
+    head_ = o.head_;
+    count_ = o.count_;
+    newest_ms_ = o.newest_ms_;
+    o.buf_ = nullptr;
+    o.cap_ = o.head_ = o.count_ = 0;
+    o.newest_ms_ = 0;
+  }
+
+  RecentSample *buf_{nullptr};
+  size_t cap_{0};
+  size_t head_{0};   // next write position
+  size_t count_{0};
+  uint32_t newest_ms_{0};
+};
+
+}  // namespace tigo_monitor
+}  // namespace esphome
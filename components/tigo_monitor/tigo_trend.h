@@ -0,0 +1,87 @@
+#pragma once
+
+// Long-term per-panel degradation trend, fed once per history snapshot.
+//
+// Estimating a panel's degradation from the flash history means scanning a
+// year of its power series and regressing it against its neighbours' — too
+// slow for a request handler, and the panel rings only hold ~112 days anyway.
+// Instead each panel slot carries the running sums of an ordinary least-squares
+// fit of
+//
+//     y = panel output power / mean output power of its string
+//
+// against time, updated in O(1) at each snapshot. The slope over the mean
+// level is the panel's degradation relative to its string, in %/year. Plain
+// output power would mostly fit the seasons; dividing by the string mean
+// cancels irradiance, temperature and season, and leaves what is specific to
+// the panel (soiling, a failing cell, creeping shade). Degradation that the
+// whole string shares cancels too — this finds the panel that ages faster
+// than its peers, not the array's absolute decline.
+//
+// A slow EWMA of the same ratio sits beside the fit as a current-level
+// indicator that forgets old snapshots, for panels whose trend is not yet
+// long enough to mean anything.
+//
+// Snapshots where the string mean is below kTrendMinReferenceW are skipped:
+// at dawn and dusk the ratio is noise, and overnight it is 0/0.
+//
+// The whole table is a flat array of PODs, persisted as one CRC-checked blob
+// (/tsdb/panel_trend.bin, see TigoHistory::save_trends_). Time is stored as
+// days since the slot's first accepted sample, in double, so the sums keep
+// full precision over decades.
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace tigo_monitor {
+
+// String mean output power below which a snapshot is not fed (W).
+static constexpr float kTrendMinReferenceW = 50.0f;
+// Weight of one snapshot in the level EWMA. At 30-min snapshots and ~20
+// daylight rows a day this spans a couple of weeks.
+static constexpr float kTrendEwmaAlpha = 0.005f;
+// Don't report a rate until the fit spans this long; a few weeks of slope is
+// dominated by seasonal shading geometry, not ageing.
+static constexpr float kTrendMinSpanDays = 30.0f;
+static constexpr uint32_t kTrendMinSamples = 100;
+
+struct PanelTrend {
+  uint32_t t0 = 0;      // unix seconds of the first accepted sample (0 = empty)
+  uint32_t n = 0;       // accepted samples
+  double sum_t = 0.0;   // days since t0
+  double sum_y = 0.0;
+  double sum_tt = 0.0;
+  double sum_ty = 0.0;
+  float ewma = NAN;     // current relative level
+  float span_days = 0.0f;
+
+  void add(uint32_t ts, float ratio) {
+    if (std::isnan(ratio)) return;
+    if (n == 0) t0 = ts;
+    double t = ts >= t0 ? (double) (ts - t0) / 86400.0 : 0.0;
+    ++n;
+    sum_t += t;
+    sum_y += ratio;
+    sum_tt += t * t;
+    sum_ty += t * ratio;
+    if ((float) t > span_days) span_days = (float) t;
+    ewma = std::isnan(ewma) ? ratio : ewma + kTrendEwmaAlpha * (ratio - ewma);
+  }
+
+  // Relative change per year of the fitted level, in percent (negative =
+  // losing ground to its string). NaN until the fit spans kTrendMinSpanDays.
+  float rate_pct_per_year() const {
+    if (n < kTrendMinSamples || span_days < kTrendMinSpanDays) return NAN;
+    double dn = (double) n;
+    double denom = dn * sum_tt - sum_t * sum_t;
+    if (denom <= 0.0) return NAN;
+    double slope = (dn * sum_ty - sum_t * sum_y) / denom;  // ratio per day
+    double mean_y = sum_y / dn;
+    if (mean_y <= 0.0) return NAN;
+    return (float) (slope * 365.25 / mean_y * 100.0);
+  }
+};
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -0,0 +1,275 @@
+// Warm-start cache — live state carried across a soft reset in RTC memory.
+//
+// NVS only sees the energy totals hourly, on night-mode entry and at
+// midnight, and the peaks only at midnight and shutdown, so a panic or
+// watchdog reset lost up to an hour of energy, and every restart (OTA,
+// /api/restart included) came up with an empty device list until each panel
+// had sent a frame. RTC slow memory survives every reset except a power cycle,
+// costs nothing to write, and does not wear.
+//
+// At the end of each update() the component copies the energy integrator, the
+// day-start baseline, the frame-integrated totals of every device, string and
+// inverter, and per device its last voltages, temperature and peak into one
+// RTC_NOINIT image and CRCs it. setup() takes the image back only when the
+// magic, version, record size and CRC all match, so a cold power-up (random
+// RTC contents) or a firmware with a different layout starts cold, exactly as
+// before. A valid image overrides the NVS copy, which can only be older.
+//
+// Telemetry is stored scaled to 16 bits (10 mV, 0.1 °C, 0.1 W) so the image
+// for 100 panels stays near 3.2 KB of the 8 KB RTC slow memory. Strings and
+// inverters are matched back by a hash of their label, since the string
+// groups are rebuilt from the node table after the devices come back.
+//
+// Restored devices have no sample yet. They come back stale, production
+// zeroed and last_update 0, as mark_stale_devices_() would leave them: the
+// power they had before the reset is not current, and a first frame must not
+// integrate energy across the reset from it.
+
+#include "tigo_monitor.h"
+
+#include "esphome/core/log.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#ifdef USE_ESP_IDF
+#include <esp_attr.h>
+#include <esp_system.h>
+#include "esp_rom_crc.h"
+#endif
+
+namespace esphome {
+namespace tigo_monitor {
+
+#ifdef USE_ESP_IDF
+
+static const char *const WARM_TAG = "tigo_monitor.warm";
+
+static constexpr uint32_t kWarmMagic = 0x4D525754;  // "TWRM"
+static constexpr uint16_t kWarmVersion = 2;
+// The number_of_devices schema maximum.
+static constexpr size_t kWarmMaxDevices = 100;
+// Rollup totals kept; anything past these restarts from zero as on a cold boot.
+static constexpr size_t kWarmMaxStrings = 32;
+static constexpr size_t kWarmMaxInverters = 16;
+
+enum : uint8_t {
+  WARM_OPTIMIZER = 1u << 0,
+};
+
+struct WarmDevice {
+  char addr[4];
+  char pv_node_id[4];
+  uint8_t flags;
+  uint8_t rssi;
+  uint16_t reserved;
+  uint16_t voltage_in_cv;   // 10 mV
+  uint16_t voltage_out_cv;
+  int16_t temperature_dc;   // 0.1 °C
+  uint16_t peak_power_dw;   // 0.1 W
+  // Frame-integrated since boot. float is enough to carry a running total
+  // across a reset; it is not what the next frame's step is added to.
+  float energy_in_kwh;
+  float energy_out_kwh;
+};
+static_assert(sizeof(WarmDevice) == 28, "WarmDevice layout changed; bump kWarmVersion");
+
+struct WarmTotal {
+  uint32_t label_hash;  // fnv1_hash of the string label or inverter name
+  float energy_kwh;
+};
+
+struct WarmImage {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t crc;  // over everything after this field, up to devices[device_count]
+  uint32_t device_count;
+  float total_energy_in_kwh;
+  float total_energy_out_kwh;
+  double pending_energy_in_kwh;
+  double pending_energy_out_kwh;
+  float energy_at_day_start;
+  uint32_t current_day_key;
+  uint16_t string_count;
+  uint16_t inverter_count;
+  WarmTotal strings[kWarmMaxStrings];
+  WarmTotal inverters[kWarmMaxInverters];
+  WarmDevice devices[kWarmMaxDevices];
+};
+
+static RTC_NOINIT_ATTR WarmImage s_warm;
+// Set once warm_start_restore_() has accepted the image, for the rollup
+// restore that has to wait for the string groups.
+static bool s_warm_valid = false;
+
+static size_t warm_crc_len_(uint32_t device_count) {
+  return offsetof(WarmImage, devices) - offsetof(WarmImage, device_count) + device_count * sizeof(WarmDevice);
+}
+
+static uint32_t warm_crc_(const WarmImage &img) {
+  return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&img.device_count), warm_crc_len_(img.device_count));
+}
+
+static uint16_t warm_u16_(float v, float scale) {
+  if (!std::isfinite(v) || v <= 0.0f) return 0;
+  return (uint16_t) std::min(v * scale + 0.5f, 65535.0f);
+}
+
+static int16_t warm_i16_(float v, float scale) {
+  if (!std::isfinite(v)) return 0;
+  return (int16_t) std::max(-32768.0f, std::min(v * scale, 32767.0f));
+}
+
+void TigoMonitorComponent::warm_start_store_() {
+  StateLock lock(state_mutex_);
+  WarmImage &img = s_warm;
+  size_t n = 0;
+  for (const auto &device : devices_) {
+    if (n >= kWarmMaxDevices) break;
+    if (device.addr.size() != 4) continue;
+    WarmDevice &w = img.devices[n++];
+    memset(&w, 0, sizeof(w));
+    memcpy(w.addr, device.addr.data(), 4);
+    if (device.pv_node_id.size() == 4) memcpy(w.pv_node_id, device.pv_node_id.data(), 4);
+    w.flags = device.is_optimizer ? WARM_OPTIMIZER : 0;
+    w.rssi = (uint8_t) device.rssi;
+    w.voltage_in_cv = warm_u16_(device.voltage_in, 100.0f);
+    w.voltage_out_cv = warm_u16_(device.voltage_out, 100.0f);
+    w.temperature_dc = warm_i16_(device.temperature, 10.0f);
+    w.peak_power_dw = warm_u16_(device.peak_power, 10.0f);
+    w.energy_in_kwh = (float) device.energy_in_kwh;
+    w.energy_out_kwh = (float) device.energy_out_kwh;
+  }
+  img.device_count = n;
+
+  // Unused entries are zeroed so the CRC, which covers both arrays whole,
+  // does not depend on whatever RTC memory held before.
+  memset(img.strings, 0, sizeof(img.strings));
+  memset(img.inverters, 0, sizeof(img.inverters));
+  size_t ns = 0;
+  for (const auto &pair : strings_) {
+    if (ns >= kWarmMaxStrings) break;
+    img.strings[ns].label_hash = fnv1_hash(pair.first.c_str());
+    img.strings[ns].energy_kwh = (float) pair.second.total_energy;
+    ns++;
+  }
+  size_t ni = 0;
+  for (const auto &inverter : inverters_) {
+    if (ni >= kWarmMaxInverters) break;
+    img.inverters[ni].label_hash = fnv1_hash(inverter.name.c_str());
+    img.inverters[ni].energy_kwh = (float) inverter.total_energy;
+    ni++;
+  }
+  img.string_count = ns;
+  img.inverter_count = ni;
+  img.total_energy_in_kwh = total_energy_in_kwh_;
+  img.total_energy_out_kwh = total_energy_out_kwh_;
+  img.pending_energy_in_kwh = pending_energy_in_kwh_;
+  img.pending_energy_out_kwh = pending_energy_out_kwh_;
+  img.energy_at_day_start = energy_at_day_start_;
+  img.current_day_key = current_day_key_;
+  img.magic = kWarmMagic;
+  img.version = kWarmVersion;
+  img.record_size = sizeof(WarmDevice);
+  img.crc = warm_crc_(img);
+}
+
+void TigoMonitorComponent::warm_start_restore_() {
+  const WarmImage &img = s_warm;
+  if (esp_reset_reason() == ESP_RST_POWERON) {
+    warm_start_state_ = "cold";
+    return;
+  }
+  if (img.magic != kWarmMagic || img.version != kWarmVersion || img.record_size != sizeof(WarmDevice) ||
+      img.device_count > kWarmMaxDevices || img.string_count > kWarmMaxStrings ||
+      img.inverter_count > kWarmMaxInverters || warm_crc_(img) != img.crc) {
+    warm_start_state_ = "invalid";
+    ESP_LOGI(WARM_TAG, "No valid warm-start image after %s reset; starting cold", reset_reason_str());
+    return;
+  }
+
+  total_energy_in_kwh_ = img.total_energy_in_kwh;
+  total_energy_out_kwh_ = img.total_energy_out_kwh;
+  pending_energy_in_kwh_ = img.pending_energy_in_kwh;
+  pending_energy_out_kwh_ = img.pending_energy_out_kwh;
+  energy_at_day_start_ = img.energy_at_day_start;
+  current_day_key_ = img.current_day_key;
+
+  // Only devices the node table already knows come back: the sensor-index
+  // assignment and barcode that update_device_data() does for a new device
+  // are done here from the node, and anything else is rediscovered by its
+  // next frame as on a cold boot.
+  size_t restored = 0;
+  for (uint32_t i = 0; i < img.device_count && devices_.size() < (size_t) number_of_devices_; ++i) {
+    const WarmDevice &w = img.devices[i];
+    node_string addr(w.addr, 4);
+    NodeTableData *node = find_node_by_addr(addr);
+    if (node == nullptr || node->sensor_index < 0 || find_device_by_addr(addr) != nullptr) continue;
+
+    DeviceData d{};
+    d.addr = addr;
+    d.pv_node_id.assign(w.pv_node_id, strnlen(w.pv_node_id, 4));
+    d.barcode = node->long_address;
+    d.is_optimizer = (w.flags & WARM_OPTIMIZER) != 0;
+    d.rssi = w.rssi;
+    d.voltage_in = w.voltage_in_cv / 100.0f;
+    d.voltage_out = w.voltage_out_cv / 100.0f;
+    d.temperature = w.temperature_dc / 10.0f;
+    d.peak_power = w.peak_power_dw / 10.0f;
+    d.energy_in_kwh = w.energy_in_kwh;
+    d.energy_out_kwh = w.energy_out_kwh;
+    d.power_factor = 1.0f;
+    d.firmware_version = "unknown";
+    // No sample yet (see the top of the file); production stays zero.
+    d.last_update = 0;
+    d.is_stale = true;
+    devices_.push_back(d);
+    created_devices_.insert(addr);
+    restored++;
+  }
+  warm_start_state_ = "restored";
+  s_warm_valid = true;
+  ESP_LOGI(WARM_TAG, "Warm start after %s reset: %zu device(s), energy in %.3f / out %.3f kWh", reset_reason_str(),
+           restored, total_energy_in_kwh_, total_energy_out_kwh_);
+}
+
+void TigoMonitorComponent::warm_start_restore_rollups_() {
+  if (!s_warm_valid) return;
+  s_warm_valid = false;
+  const WarmImage &img = s_warm;
+  size_t restored = 0;
+  for (auto &pair : strings_) {
+    const uint32_t hash = fnv1_hash(pair.first.c_str());
+    for (uint16_t i = 0; i < img.string_count; ++i) {
+      if (img.strings[i].label_hash != hash) continue;
+      pair.second.total_energy = img.strings[i].energy_kwh;
+      restored++;
+      break;
+    }
+  }
+  for (auto &inverter : inverters_) {
+    const uint32_t hash = fnv1_hash(inverter.name.c_str());
+    for (uint16_t i = 0; i < img.inverter_count; ++i) {
+      if (img.inverters[i].label_hash != hash) continue;
+      inverter.total_energy = img.inverters[i].energy_kwh;
+      restored++;
+      break;
+    }
+  }
+  ESP_LOGD(WARM_TAG, "Warm start: %zu string/inverter total(s) restored", restored);
+}
+
+#else
+
+void TigoMonitorComponent::warm_start_store_() {}
+void TigoMonitorComponent::warm_start_restore_() {}
+void TigoMonitorComponent::warm_start_restore_rollups_() {}
+
+#endif  // USE_ESP_IDF
+
+}  // namespace tigo_monitor
+}  // namespace esphome
@@ -10,6 +10,7 @@
 #include "esphome/components/network/util.h"
 #include "esphome/components/logger/logger.h"
 #include "esphome/components/sensor/sensor.h"
+#include "esphome/components/tigo_monitor/tigo_downsample.h"
 #ifdef USE_LIGHT
 #include "esphome/components/light/light_state.h"
 #include "esphome/components/light/light_call.h"
@@ -18,9 +19,11 @@
 #include "esphome/components/wifi/wifi_component.h"
 #endif
 #include <esp_heap_caps.h>
+#include <esp_idf_version.h>
 #include <esp_system.h>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <freertos/task.h>
 #include <lwip/sockets.h>
 #include <lwip/tcp.h>
@@ -108,6 +111,68 @@ class PSRAMString {
   size_t capacity_;
 };
 
+// Streams a response with httpd_resp_send_chunk through one fixed buffer,
+// for output whose size is not known up front. Same append() surface as
+// PSRAMString, but memory stays at kBytes however long the response runs, and
+// the first bytes leave as soon as the buffer fills instead of after the whole
+// body is built. Status and headers must be set before the first append.
+//
+// A failed send (client gone) latches: later appends are dropped, so a handler
+// can finish its loop without checking every call.
+class ChunkedResponse {
+ public:
+  static constexpr size_t kBytes = 2048;
+
+  explicit ChunkedResponse(httpd_req_t *req) : req_(req) {
+    buf_ = static_cast<char *>(heap_caps_malloc(kBytes, MALLOC_CAP_SPIRAM));
+    if (buf_ == nullptr) buf_ = static_cast<char *>(heap_caps_malloc(kBytes, MALLOC_CAP_DEFAULT));
+    if (buf_ == nullptr) {
+      ESP_LOGE(TAG, "Failed to allocate %zu-byte chunk buffer", kBytes);
+      failed_ = true;
+    }
+  }
+  ~ChunkedResponse() {
+    if (buf_) heap_caps_free(buf_);
+  }
+  ChunkedResponse(const ChunkedResponse &) = delete;
+  ChunkedResponse &operator=(const ChunkedResponse &) = delete;
+
+  void append(const char *str) { append(str, strlen(str)); }
+  void append(const char *str, size_t len) {
+    while (len > 0 && !failed_) {
+      size_t n = std::min(len, kBytes - len_);
+      memcpy(buf_ + len_, str, n);
+      len_ += n;
+      str += n;
+      len -= n;
+      if (len_ == kBytes) flush_();
+    }
+  }
+
+  // Sends what is buffered and the terminating empty chunk. Returns false if
+  // any part of the response failed to send.
+  bool finish() {
+    flush_();
+    if (!failed_ && httpd_resp_send_chunk(req_, nullptr, 0) != ESP_OK) failed_ = true;
+    return !failed_;
+  }
+
+ private:
+  void flush_() {
+    if (failed_ || len_ == 0) return;
+    if (httpd_resp_send_chunk(req_, buf_, len_) != ESP_OK) {
+      ESP_LOGD(TAG, "Chunked send failed; dropping the rest of the response");
+      failed_ = true;
+    }
+    len_ = 0;
+  }
+
+  httpd_req_t *req_;
+  char *buf_{nullptr};
+  size_t len_{0};
+  bool failed_{false};
+};
+
 void TigoWebServer::setup() {
   ESP_LOGI(TAG, "Starting Tigo Web Server on port %d...", port_);
 
@@ -157,8 +222,8 @@ void TigoWebServer::setup() {
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
   config.server_port = port_;
   config.ctrl_port = port_ + 1;
-  // Must be >= the number of httpd_register_uri_handler() calls below (50 on a TSDB +
-  // cloud build: 29 base + 4 TSDB + 3 CCA-discovery + 4 CCA-network + 1 CCA data-export
+  // Must be >= the number of httpd_register_uri_handler() calls below (55 on a TSDB +
+  // cloud build: 31 base + 7 TSDB + 3 CCA-discovery + 4 CCA-network + 1 CCA data-export
   // + 2 CCA BLE-search + 5 cloud + 2 config). Handlers past this cap
   // silently fail to register and 404 — TSDB stats registers last, so it's the canary.
   // Keep generous headroom so adding a route doesn't quietly drop the tail again.
@@ -543,6 +608,22 @@ void TigoWebServer::setup() {
     };
     httpd_register_uri_handler(server_, &api_github_release_uri);
 
+    httpd_uri_t api_recent_uri = {
+      .uri = "/api/recent",
+      .method = HTTP_GET,
+      .handler = api_recent_handler,
+      .user_ctx = this
+    };
+    httpd_register_uri_handler(server_, &api_recent_uri);
+
+    httpd_uri_t api_alerts_uri = {
+      .uri = "/api/alerts",
+      .method = HTTP_GET,
+      .handler = api_alerts_handler,
+      .user_ctx = this
+    };
+    httpd_register_uri_handler(server_, &api_alerts_uri);
+
 #ifdef TIGO_TSDB_AVAILABLE
     httpd_uri_t api_history_power_uri = {
       .uri = "/api/history/power",
@@ -560,6 +641,30 @@ void TigoWebServer::setup() {
     };
     httpd_register_uri_handler(server_, &api_history_panel_uri);
 
+    httpd_uri_t api_history_panels_uri = {
+      .uri = "/api/history/panels",
+      .method = HTTP_GET,
+      .handler = api_history_panels_handler,
+      .user_ctx = this
+    };
+    httpd_register_uri_handler(server_, &api_history_panels_uri);
+
+    httpd_uri_t api_history_string_uri = {
+      .uri = "/api/history/string",
+      .method = HTTP_GET,
+      .handler = api_history_string_handler,
+      .user_ctx = this
+    };
+    httpd_register_uri_handler(server_, &api_history_string_uri);
+
+    httpd_uri_t api_history_inverter_uri = {
+      .uri = "/api/history/inverter",
+      .method = HTTP_GET,
+      .handler = api_history_inverter_handler,
+      .user_ctx = this
+    };
+    httpd_register_uri_handler(server_, &api_history_inverter_uri);
+
     httpd_uri_t api_panels_uri = {
       .uri = "/api/panels",
       .method = HTTP_GET,
@@ -575,6 +680,8 @@ void TigoWebServer::setup() {
       .user_ctx = this
     };
     httpd_register_uri_handler(server_, &api_tsdb_stats_uri);
+
+    start_history_worker();
 #endif
 
     // Log web authentication status
@@ -636,6 +743,7 @@ void TigoWebServer::setup() {
   } else {
     ESP_LOGE(TAG, "Failed to start web server");
   }
+  if (parent_ != nullptr) parent_->boot_mark("web_server");
 }
 
 tigo_monitor::TigoMonitorComponent *TigoWebServer::get_parent_from_req(httpd_req_t *req) {
@@ -948,14 +1056,81 @@ esp_err_t TigoWebServer::api_strings_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+// "YYYY-MM-DD" (or, for monthly totals, "YYYY-MM") -> YYYYMMDD. Only the
+// shape is checked here; the archive rejects dates that do not exist.
+static bool parse_energy_date(const char *text, bool monthly, uint32_t &key) {
+  unsigned y = 0, m = 0, d = 1;
+  int used = 0;
+  if (sscanf(text, "%4u-%2u-%2u%n", &y, &m, &d, &used) == 3 && text[used] == '\0') {
+    // full date
+  } else if (monthly && sscanf(text, "%4u-%2u%n", &y, &m, &used) == 2 && text[used] == '\0') {
+    d = 1;
+  } else {
+    return false;
+  }
+  if (m < 1 || m > 12 || d < 1 || d > 31) return false;
+  key = y * 10000 + m * 100 + d;
+  return true;
+}
+
 esp_err_t TigoWebServer::api_energy_history_handler(httpd_req_t *req) {
+  // GET [?from=YYYY-MM-DD][&to=YYYY-MM-DD][&group=day|month]. With no range
+  // this is the last 7 days, as it always was; `to` defaults to today and
+  // `from` to 6 days (or, by month, 11 months) before it. Served from the
+  // daily energy archive — a few years of days, one array read each — never
+  // from the TSDB.
   TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
   if (!server->check_api_auth(req)) {
     return ESP_OK;
   }
-  
+
+  char query[128] = {};
+  char from[16] = {}, to[16] = {}, group[8] = {};
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    httpd_query_key_value(query, "from", from, sizeof(from));
+    httpd_query_key_value(query, "to", to, sizeof(to));
+    httpd_query_key_value(query, "group", group, sizeof(group));
+  }
+  bool monthly = strcmp(group, "month") == 0;
+  if (group[0] != '\0' && !monthly && strcmp(group, "day") != 0) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"error\":\"group must be day or month\"}");
+    return ESP_OK;
+  }
+
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  time_t now_time = tv.tv_sec;
+  struct tm today_tm;
+  localtime_r(&now_time, &today_tm);
+  uint32_t today_key = (today_tm.tm_year + 1900) * 10000 + (today_tm.tm_mon + 1) * 100 + today_tm.tm_mday;
+
+  uint32_t to_key = today_key;
+  uint32_t from_key = 0;
+  if ((to[0] != '\0' && !parse_energy_date(to, monthly, to_key)) ||
+      (from[0] != '\0' && !parse_energy_date(from, monthly, from_key))) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, monthly ? "{\"error\":\"from/to must be YYYY-MM-DD or YYYY-MM\"}"
+                                    : "{\"error\":\"from/to must be YYYY-MM-DD\"}");
+    return ESP_OK;
+  }
+  // Nothing after today has been measured yet.
+  if (to_key > today_key) to_key = today_key;
+  if (from[0] == '\0') {
+    auto end = tigo_monitor::DailyEnergyData::from_key(to_key);
+    if (monthly) {
+      int months = end.year * 12 + (end.month - 1) - 11;
+      from_key = (months / 12) * 10000 + (months % 12 + 1) * 100 + 1;
+    } else {
+      int32_t day = end.day_number();
+      from_key = day >= 6 ? tigo_monitor::DailyEnergyData::from_day_number(day - 6).to_key() : 0;
+    }
+  }
+
   PSRAMString json_buffer;
-  server->build_energy_history_json(json_buffer);
+  server->build_energy_history_json(json_buffer, from_key, to_key, monthly);
   
   httpd_resp_set_type(req, "application/json");
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -2501,6 +2676,86 @@ void TigoWebServer::build_overview_json(PSRAMString& json) {
   json.append(buffer);
 }
 
+// One metric of a string's per-window quartile summary (tigo_quantile.h):
+// "key":{"q1":..,"median":..,"q3":..,"lower_fence":..,"upper_fence":..,"n":..},
+// or "key":null when no frames arrived in the last window (night, all stale).
+static void append_quartiles_json(PSRAMString &json, const char *key,
+                                  const tigo_monitor::QuartileSummary &q) {
+  char buffer[192];
+  if (q.n == 0) {
+    snprintf(buffer, sizeof(buffer), "\"%s\":null", key);
+  } else {
+    snprintf(buffer, sizeof(buffer),
+             "\"%s\":{\"q1\":%.2f,\"median\":%.2f,\"q3\":%.2f,"
+             "\"lower_fence\":%.2f,\"upper_fence\":%.2f,\"n\":%lu}",
+             key, q.q1, q.median, q.q3, q.lower_fence, q.upper_fence, (unsigned long) q.n);
+  }
+  json.append(buffer);
+}
+
+// The "persistence" member of /api/status: NVS write counters and the wear
+// estimate from the persistence manager (tigo_persist.cpp), plus the most
+// written keys. Key names embed user labels ("str_dn:East"), so quotes,
+// backslashes and control characters are dropped rather than escaped.
+static void append_persist_json(PSRAMString &json, tigo_monitor::TigoMonitorComponent *parent) {
+  tigo_monitor::PersistStats st;
+  parent->snapshot_persist_stats(st);
+
+  char years[24];
+  if (std::isfinite(st.years_to_endurance)) {
+    snprintf(years, sizeof(years), "%.1f", st.years_to_endurance);
+  } else {
+    strcpy(years, "null");
+  }
+  char buffer[512];
+  snprintf(buffer, sizeof(buffer),
+           "\"persistence\":{\"keys\":%u,\"saves\":%u,\"writes\":%u,\"skipped_identical\":%u,"
+           "\"coalesced\":%u,\"failed\":%u,\"commits\":%u,\"pending\":%u,\"last_commit_age_s\":%u,"
+           "\"bytes_written\":%llu,\"nvs_entries_written\":%llu,\"nvs_pages\":%u,"
+           "\"est_page_erases\":%.3f,\"est_years_to_endurance\":%s,\"top_keys\":[",
+           (unsigned) st.keys, (unsigned) st.saves, (unsigned) st.writes, (unsigned) st.skipped,
+           (unsigned) st.coalesced, (unsigned) st.failed, (unsigned) st.commits, (unsigned) st.pending,
+           (unsigned) st.last_commit_age_s, (unsigned long long) st.bytes_written,
+           (unsigned long long) st.entries_written, (unsigned) st.nvs_pages, st.page_erases, years);
+  json.append(buffer);
+  for (size_t i = 0; i < st.top_count; ++i) {
+    const auto &k = st.top[i];
+    char key[sizeof(k.key)];
+    size_t n = 0;
+    for (size_t j = 0; j < sizeof(k.key) && k.key[j] != '\0'; ++j) {
+      char c = k.key[j];
+      if (c == '"' || c == '\\' || (unsigned char) c < 0x20) continue;
+      key[n++] = c;
+    }
+    key[n < sizeof(key) ? n : sizeof(key) - 1] = '\0';
+    snprintf(buffer, sizeof(buffer), "%s{\"key\":\"%s\",\"writes\":%u,\"skipped\":%u,\"bytes\":%u}",
+             i > 0 ? "," : "", key, (unsigned) k.writes, (unsigned) k.skipped, (unsigned) k.size);
+    json.append(buffer);
+  }
+  json.append("]}");
+}
+
+// The "boot" member of /api/status: when each setup phase finished and when
+// UART ingest got going, in microseconds since reset. 0 = not reached yet.
+static void append_boot_json(PSRAMString &json, tigo_monitor::TigoMonitorComponent *parent) {
+  tigo_monitor::BootTimeline boot;
+  parent->snapshot_boot_timeline(boot);
+
+  char buffer[160];
+  snprintf(buffer, sizeof(buffer),
+           "\"boot\":{\"first_loop_us\":%u,\"first_byte_us\":%u,\"first_frame_us\":%u,"
+           "\"deferred_done_us\":%u,\"phases\":[",
+           (unsigned) boot.first_loop_us, (unsigned) boot.first_byte_us, (unsigned) boot.first_frame_us,
+           (unsigned) boot.deferred_done_us);
+  json.append(buffer);
+  for (size_t i = 0; i < boot.count; ++i) {
+    snprintf(buffer, sizeof(buffer), "%s{\"phase\":\"%s\",\"us\":%u}", i > 0 ? "," : "",
+             boot.phases[i].name, (unsigned) boot.phases[i].us);
+    json.append(buffer);
+  }
+  json.append("]}");
+}
+
 void TigoWebServer::build_strings_json(PSRAMString& json) {
   json.append("{\"strings\":[");
 
@@ -2526,20 +2781,28 @@ void TigoWebServer::build_strings_json(PSRAMString& json) {
     snprintf(buffer, sizeof(buffer),
       "{\"label\":\"%s\",\"display_label\":\"%s\",\"inverter\":\"%s\","
       "\"panel_rating_w\":%u,"
-      "\"total_power\":%.1f,\"peak_power\":%.1f,"
+      "\"total_power\":%.1f,\"peak_power\":%.1f,\"total_energy\":%.3f,"
       "\"total_current\":%.3f,\"avg_voltage_in\":%.2f,\"avg_voltage_out\":%.2f,"
       "\"avg_temperature\":%.1f,\"avg_efficiency\":%.2f,\"min_efficiency\":%.2f,"
-      "\"max_efficiency\":%.2f,\"active_devices\":%d,\"total_devices\":%d}",
+      "\"max_efficiency\":%.2f,\"active_devices\":%d,\"total_devices\":%d",
       string_data.string_label.c_str(), string_data.display_label.c_str(),
       string_data.inverter_label.c_str(),
       (unsigned) string_data.panel_rating_w,
-      string_data.total_power, string_data.peak_power, string_data.total_current,
+      string_data.total_power, string_data.peak_power, string_data.total_energy,
+      string_data.total_current,
       string_data.avg_voltage_in, string_data.avg_voltage_out,
       string_data.avg_temperature, string_data.avg_efficiency,
       string_data.min_efficiency, string_data.max_efficiency,
       string_data.active_device_count, string_data.total_device_count);
 
     json.append(buffer);
+    json.append(",\"quartiles\":{");
+    append_quartiles_json(json, "power", string_data.power_quartiles);
+    json.append(",");
+    append_quartiles_json(json, "voltage_in", string_data.voltage_quartiles);
+    json.append(",");
+    append_quartiles_json(json, "temperature", string_data.temperature_quartiles);
+    json.append("}}");
   }
   });
 
@@ -2622,6 +2885,9 @@ void TigoWebServer::build_inverters_json(PSRAMString& json) {
     json.append(",\"peak_power\":");
     snprintf(buffer, sizeof(buffer), "%.1f", inverter.peak_power);
     json.append(buffer);
+    json.append(",\"total_energy\":");
+    snprintf(buffer, sizeof(buffer), "%.3f", inverter.total_energy);
+    json.append(buffer);
     
     json.append(",\"active_devices\":");
     snprintf(buffer, sizeof(buffer), "%d", inverter.active_device_count);
@@ -2639,60 +2905,64 @@ void TigoWebServer::build_inverters_json(PSRAMString& json) {
   json.append("]}");
 }
 
-void TigoWebServer::build_energy_history_json(PSRAMString& json) {
+void TigoWebServer::build_energy_history_json(PSRAMString& json, uint32_t from_key, uint32_t to_key,
+                                              bool monthly) {
   if (!parent_) {
     json.append("{\"error\":\"No parent component\"}");
     return;
   }
   
-  auto history = parent_->get_daily_energy_history();
+  auto history = monthly ? parent_->get_monthly_energy_history(from_key, to_key)
+                         : parent_->get_daily_energy_history(from_key, to_key);
+  uint32_t first_key = parent_->get_energy_history_first_key();
   float current_energy = parent_->get_total_energy_out_kwh();
   float energy_at_day_start = parent_->get_energy_at_day_start();
   
+  // Today is not archived until it ends; its entry (or its month's) gets
+  // the live production on top.
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  time_t now_time = tv.tv_sec;
+  struct tm today_tm;
+  localtime_r(&now_time, &today_tm);
+  float today_energy = current_energy - energy_at_day_start;
+  
   json.append("{\"current_energy\":");
   
   char buffer[64];
   snprintf(buffer, sizeof(buffer), "%.3f", current_energy);
   json.append(buffer);
   
-  json.append(",\"history\":[");
+  json.append(monthly ? ",\"group\":\"month\"" : ",\"group\":\"day\"");
+  json.append(",\"first\":");
+  if (first_key == 0) {
+    json.append("null");
+  } else {
+    snprintf(buffer, sizeof(buffer), "\"%04u-%02u-%02u\"", (unsigned) (first_key / 10000),
+             (unsigned) (first_key / 100 % 100), (unsigned) (first_key % 100));
+    json.append(buffer);
+  }
   
-  // Fill in last 7 days with 0 for missing data
-  struct timeval tv;
-  gettimeofday(&tv, nullptr);
-  time_t now_time = tv.tv_sec;
+  json.append(",\"history\":[");
   
   bool first = true;
-  for (int days_ago = 6; days_ago >= 0; days_ago--) {
+  for (const auto &entry : history) {
     if (!first) json.append(",");
     first = false;
     
-    // Calculate date for days_ago
-    time_t day_time = now_time - (days_ago * 86400);
-    struct tm day_tm;
-    localtime_r(&day_time, &day_tm);
-    
-    // Look for this date in history
-    float energy = 0.0f;
-    
-    // For today (days_ago == 0), use current production
-    if (days_ago == 0) {
-      energy = current_energy - energy_at_day_start;
-    } else {
-      // For past days, look in archived history
-      for (const auto &entry : history) {
-        if (entry.year == (day_tm.tm_year + 1900) && 
-            entry.month == (day_tm.tm_mon + 1) && 
-            entry.day == day_tm.tm_mday) {
-          energy = entry.energy_kwh;
-          break;
-        }
-      }
+    bool is_current = entry.year == today_tm.tm_year + 1900 && entry.month == today_tm.tm_mon + 1 &&
+                      (monthly || entry.day == today_tm.tm_mday);
+    float energy = entry.energy_kwh;
+    if (is_current) {
+      energy = monthly ? energy + today_energy : today_energy;
     }
     
     json.append("{\"date\":\"");
-    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", 
-             day_tm.tm_year + 1900, day_tm.tm_mon + 1, day_tm.tm_mday);
+    if (monthly) {
+      snprintf(buffer, sizeof(buffer), "%04d-%02d", entry.year, entry.month);
+    } else {
+      snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", entry.year, entry.month, entry.day);
+    }
     json.append(buffer);
     json.append("\",\"energy\":");
     snprintf(buffer, sizeof(buffer), "%.3f", energy);
@@ -2880,7 +3150,7 @@ void TigoWebServer::build_esp_status_json(PSRAMString& json) {
     "\"invalid_checksum\":%u,\"missed_frames\":%u,\"total_frames\":%u,"
     "\"command_frames\":%u,\"frame_27_count\":%u,"
     "\"network_connected\":%s,\"wifi_rssi\":%d,\"wifi_ssid\":\"%s\",\"ip_address\":\"%s\",\"mac_address\":\"%s\","
-    "\"active_sockets\":%d,\"max_sockets\":%d,\"reset_reason\":\"%s\"}",
+    "\"active_sockets\":%d,\"max_sockets\":%d,\"reset_reason\":\"%s\",\"warm_start\":\"%s\",",
     free_heap, total_heap, free_psram, total_psram,
     min_free_heap, min_free_psram,
     (unsigned) uptime_sec, (unsigned) uptime_days, (unsigned) uptime_hours, (unsigned) uptime_mins,
@@ -2889,9 +3159,13 @@ void TigoWebServer::build_esp_status_json(PSRAMString& json) {
     (unsigned) invalid_checksum, (unsigned) missed_frames, (unsigned) total_frames,
     (unsigned) command_frames, (unsigned) frame_27_count,
     network_connected ? "true" : "false", wifi_rssi, ssid.c_str(), ip_address.c_str(), mac_address.c_str(),
-    active_sockets, max_sockets, tigo_monitor::reset_reason_str());
+    active_sockets, max_sockets, tigo_monitor::reset_reason_str(), parent_->get_warm_start_state());
   
   json.append(buffer);
+  append_persist_json(json, parent_);
+  json.append(",");
+  append_boot_json(json, parent_);
+  json.append("}");
 }
 
 void TigoWebServer::build_yaml_json(PSRAMString& json, const std::set<std::string>& selected_sensors, const std::set<std::string>& selected_hub_sensors, const std::string& grouping) {
@@ -3343,8 +3617,7 @@ esp_err_t TigoWebServer::api_github_release_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
-#ifdef TIGO_TSDB_AVAILABLE
-esp_err_t TigoWebServer::api_history_power_handler(httpd_req_t *req) {
+esp_err_t TigoWebServer::api_recent_handler(httpd_req_t *req) {
   TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
   if (!server->check_api_auth(req))
     return ESP_OK;
@@ -3354,35 +3627,361 @@ esp_err_t TigoWebServer::api_history_power_handler(httpd_req_t *req) {
     httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
     return ESP_OK;
   }
-  tigo_monitor::TigoHistory *hist = server->parent_->get_history();
-  if (hist == nullptr || !hist->initialized()) {
+
+  // addr (required, 4-char short address) + minutes (optional, default 60).
+  char addr[8] = {0};
+  uint32_t minutes = 60;
+  char query_buf[64] = {0};
+  if (httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK) {
+    httpd_query_key_value(query_buf, "addr", addr, sizeof(addr));
+    char min_str[8] = {0};
+    if (httpd_query_key_value(query_buf, "minutes", min_str, sizeof(min_str)) == ESP_OK) {
+      int m = atoi(min_str);
+      if (m < 1 || m > 1440) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, "{\"error\":\"minutes must be 1..1440\"}");
+        return ESP_OK;
+      }
+      minutes = (uint32_t) m;
+    }
+  }
+  if (addr[0] == '\0') {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"error\":\"addr is required\"}");
+    return ESP_OK;
+  }
+
+  // Copy under the state lock, format after it is released. The ring lives in
+  // PSRAM and is fed by the main loop; nothing on this path touches flash.
+  tigo_monitor::node_vector<tigo_monitor::RecentPoint> points;
+  uint32_t now_ms = 0;
+  size_t capacity = 0;
+  bool found = server->parent_->copy_recent_samples(addr, minutes * 60000UL, points, now_ms, capacity);
+  if (capacity == 0) {
     httpd_resp_set_status(req, "503 Service Unavailable");
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"error\":\"history not initialized\"}");
+    httpd_resp_sendstr(req, "{\"error\":\"recent history disabled\"}");
     return ESP_OK;
   }
+  if (!found) {
+    httpd_resp_set_status(req, "404 Not Found");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"error\":\"no samples for addr\"}");
+    return ESP_OK;
+  }
+
+  // Rows carry unix time when the clock is set, so they line up with the
+  // /api/history/* charts; before SNTP they fall back to seconds of uptime and
+  // say so in time_base.
+  uint32_t now_ts = (uint32_t) ::time(nullptr);
+  bool have_clock = now_ts >= 1577836800u /* 2020-01-01 */;
+
+  PSRAMString json;
+  char tmp[96];
+  json.append("{\"addr\":\"");
+  json.append(addr);
+  json.append("\",\"minutes\":");
+  snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) minutes);
+  json.append(tmp);
+  json.append(",\"capacity\":");
+  snprintf(tmp, sizeof(tmp), "%zu", capacity);
+  json.append(tmp);
+  json.append(",\"time_base\":\"");
+  json.append(have_clock ? "unix" : "uptime");
+  json.append("\",\"records\":[");
+
+  bool first = true;
+  for (const auto &p : points) {
+    double t = have_clock ? (double) now_ts - (double) (now_ms - p.ts_ms) / 1000.0
+                          : (double) p.ts_ms / 1000.0;
+    char row[112];
+    snprintf(row, sizeof(row), "%s{\"t\":%.1f,\"p\":%.1f,\"v\":%.2f,\"i\":%.3f,\"temp\":%.1f}",
+             first ? "" : ",", t, p.p_dw / 10.0f, p.v_cv / 100.0f, p.i_ma / 1000.0f,
+             p.t_dc / 10.0f);
+    json.append(row);
+    first = false;
+  }
+
+  json.append("],\"count\":");
+  snprintf(tmp, sizeof(tmp), "%zu", points.size());
+  json.append(tmp);
+  json.append("}");
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_send(req, json.c_str(), json.length());
+  return ESP_OK;
+}
+
+// Panels the underperformance detector (tigo_health.h) currently flags, plus
+// those below threshold but not yet for long enough ("pending"). Everything is
+// in RAM; the walk is over devices_ under the state lock, and only flagged
+// panels pay for the node-table lookup of their string label.
+esp_err_t TigoWebServer::api_alerts_handler(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  if (!server->check_api_auth(req))
+    return ESP_OK;
+
+  if (server->parent_ == nullptr) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
+    return ESP_OK;
+  }
+
+  const tigo_monitor::HealthParams &params = server->parent_->get_health_params();
+  PSRAMString json;
+  char tmp[96];
+  json.append("{\"threshold\":");
+  snprintf(tmp, sizeof(tmp), "%.2f,\"duration_min\":%lu", params.threshold,
+           (unsigned long) (params.hold_ms / 60000));
+  json.append(tmp);
+  json.append(",\"alerts\":[");
+
+  uint32_t now_ms = millis();
+  size_t active = 0;
+  size_t pending = 0;
+  server->parent_->with_state_lock([&]() {
+    bool first = true;
+    for (const auto &device : server->parent_->get_devices()) {
+      const tigo_monitor::PanelHealth &h = device.health;
+      if (!h.alerting && !h.below) continue;
+
+      const char *string_label = "";
+      for (const auto &node : server->parent_->get_node_table()) {
+        if (node.addr == device.addr) {
+          string_label = node.cca_string_label.c_str();
+          break;
+        }
+      }
+      uint32_t since_ms = h.alerting ? h.alert_since_ms : h.below_since_ms;
+
+      char buffer[320];
+      snprintf(buffer, sizeof(buffer),
+               "%s{\"type\":\"underperforming\",\"state\":\"%s\",\"addr\":\"%s\","
+               "\"barcode\":\"%s\",\"string\":\"%s\",\"ratio\":%.3f,\"reference\":\"%s\","
+               "\"power_out\":%.1f,\"for_s\":%lu}",
+               first ? "" : ",", h.alerting ? "active" : "pending", device.addr.c_str(),
+               device.barcode.c_str(), string_label, h.ratio,
+               tigo_monitor::health_reference_str(h.reference), device.power_out,
+               (unsigned long) ((now_ms - since_ms) / 1000));
+      json.append(buffer);
+      first = false;
+      if (h.alerting) {
+        active++;
+      } else {
+        pending++;
+      }
+    }
+  });
+
+  snprintf(tmp, sizeof(tmp), "],\"active\":%zu,\"pending\":%zu}", active, pending);
+  json.append(tmp);
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_send(req, json.c_str(), json.length());
+  return ESP_OK;
+}
+
+#ifdef TIGO_TSDB_AVAILABLE
+// ---- History query worker -------------------------------------------------
+//
+// esp_http_server runs every handler on its one task. A month query holds the
+// flash lock for ~2.3 s and can wait up to 30 s behind a writer commit, and
+// for all of that /api/overview, /api/devices and the rest sat in the same
+// queue — the dashboard froze whenever the History view was loading.
+//
+// The history handlers now only check auth, take an async copy of the request
+// (httpd_req_async_handler_begin keeps its socket open) and queue it for a
+// worker task, so httpd goes straight back to serving everything else. The
+// worker runs the query and streams the response from its own task. Priority
+// 1, below httpd (5), like the tsdb writer: history is the work that can wait.
+//
+// The queue is bounded at 2 on purpose. Each queued request holds one of the
+// four httpd sockets (max_open_sockets), so with one running and two waiting
+// there is always a socket left for live endpoints; a fourth history request
+// gets 503 + Retry-After instead of taking it.
+struct HistoryJob {
+  httpd_req_t *req;
+  esp_err_t (*run)(httpd_req_t *);
+};
+static constexpr UBaseType_t kHistoryQueueDepth = 2;
+
+bool TigoWebServer::start_history_worker() {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+  if (history_task_ != nullptr) return true;
+  history_queue_ = xQueueCreate(kHistoryQueueDepth, sizeof(HistoryJob));
+  if (history_queue_ == nullptr) {
+    ESP_LOGW(TAG, "History worker queue allocation failed; history queries run on the httpd task");
+    return false;
+  }
+  // 8 KB, the same as the httpd task these handlers used to run on. Not
+  // pinned: tigo_history's FlashLock already serializes flash access from any
+  // core, exactly as it did for httpd (tskNO_AFFINITY).
+  if (xTaskCreate(&TigoWebServer::history_worker_entry, "tigo_hist_q", 8192, this, 1, &history_task_) != pdPASS) {
+    ESP_LOGW(TAG, "History worker task creation failed; history queries run on the httpd task");
+    vQueueDelete(history_queue_);
+    history_queue_ = nullptr;
+    history_task_ = nullptr;
+    return false;
+  }
+  ESP_LOGI(TAG, "History queries run on a worker task (queue depth %u)", (unsigned) kHistoryQueueDepth);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TigoWebServer::history_worker_entry(void *arg) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(arg);
+  HistoryJob job;
+  for (;;) {
+    if (xQueueReceive(server->history_queue_, &job, portMAX_DELAY) != pdTRUE) continue;
+    job.run(job.req);
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+    httpd_req_async_handler_complete(job.req);
+#endif
+  }
+}
+
+esp_err_t TigoWebServer::defer_history_query(httpd_req_t *req, esp_err_t (*run)(httpd_req_t *)) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+  if (history_queue_ == nullptr) return run(req);
+  // Only this (httpd) task sends to the queue, so a free slot seen here is
+  // still free at xQueueSend.
+  if (uxQueueSpacesAvailable(history_queue_) == 0) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Retry-After", "2");
+    httpd_resp_sendstr(req, "{\"error\":\"history busy\"}");
+    return ESP_OK;
+  }
+  HistoryJob job{nullptr, run};
+  if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+    // Out of heap for the copy: answer inline, as before the worker existed.
+    return run(req);
+  }
+  xQueueSend(history_queue_, &job, 0);
+  return ESP_OK;
+#else
+  return run(req);
+#endif
+}
+
+// 503 for every history endpoint while there is nothing to read. The history
+// mounts on its writer task after boot, so the first seconds after a restart
+// answer "warming_up" with a Retry-After, while "failed"/"off" mean no history
+// this boot at all.
+static void send_history_unavailable(httpd_req_t *req, tigo_monitor::TigoHistory *hist) {
+  const char *state = hist != nullptr ? hist->state_str() : "off";
+  char body[96];
+  snprintf(body, sizeof(body), "{\"error\":\"%s\",\"status\":\"%s\"}",
+           (hist != nullptr && hist->warming_up()) ? "history warming up" : "history not initialized", state);
+  httpd_resp_set_status(req, "503 Service Unavailable");
+  httpd_resp_set_type(req, "application/json");
+  if (hist != nullptr && hist->warming_up()) httpd_resp_set_hdr(req, "Retry-After", "5");
+  httpd_resp_sendstr(req, body);
+}
+
+// The window and point budget every history endpoint takes: `range`
+// (day|week|month|year, back from now, default day) or explicit `start`/`end`
+// unix seconds, and `points` (default kDefaultHistoryPoints). On a bad
+// parameter or an unset clock the error response is already sent and this
+// returns false.
+struct HistoryQuery {
+  uint32_t start_ts{0};
+  uint32_t end_ts{0};
+  const char *label{"day"};
+  uint32_t points{tigo_monitor::kDefaultHistoryPoints};
+};
+static constexpr uint32_t kMaxHistoryPoints = 5000;
+// Explicit windows longer than this are refused: nothing stored goes back
+// further, and it bounds the raw-row fold a rollup tier may fall back to.
+static constexpr uint32_t kMaxHistoryWindowS = 5UL * 366 * 24 * 3600;
+
+// Output records of a history query, held until the query has returned.
+//
+// The history iterators call back with the flash lock, the recent-rows mutex
+// or a pinned cache entry held. Appending to a ChunkedResponse from there sent
+// a chunk each time its 2 KB buffer filled, so a slow client held that lock for
+// as long as its socket took to drain, and the writer's commit, recent_push_()
+// and an OTA quiesce all waited with it. The streaming handlers now collect
+// here and format after the query returns. Records are 20 bytes in PSRAM; a
+// downsampled answer is at most `points` of them, and the cap only bites on a
+// raw range stored denser than the current cadence, which then ends early
+// with "truncated":true.
+class HistoryRecords {
+ public:
+  static constexpr size_t kMaxRecords = 4 * kMaxHistoryPoints;
+  struct Record {
+    uint32_t ts;
+    float avg;
+    float lo;
+    float hi;
+    float e_kwh;
+  };
+
+  explicit HistoryRecords(uint32_t points) { rows_.reserve(std::min<size_t>(points + 1, kMaxRecords)); }
+
+  void add(uint32_t ts, float avg, float lo, float hi, float e_kwh) {
+    if (rows_.size() >= kMaxRecords) {
+      truncated_ = true;
+      return;
+    }
+    rows_.push_back(Record{ts, avg, lo, hi, e_kwh});
+  }
+
+  // Calls fn(ts, avg, lo, hi, e_kwh) for each record in order.
+  template<typename Fn> void for_each(Fn &&fn) const {
+    for (const Record &r : rows_) fn(r.ts, r.avg, r.lo, r.hi, r.e_kwh);
+  }
+  bool truncated() const { return truncated_; }
+
+ private:
+  psram_vector<Record> rows_;
+  bool truncated_{false};
+};
+
+static bool parse_history_query(httpd_req_t *req, const char *query, HistoryQuery &out) {
+  auto bad = [req](const char *body) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, body);
+    return false;
+  };
 
-  // Parse range. Supported: day | week | month | year. Default day.
   uint32_t window_seconds = 24 * 3600;
-  const char *range_label = "day";
-  char query_buf[64] = {0};
-  if (httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK) {
-    char range[16] = {0};
-    if (httpd_query_key_value(query_buf, "range", range, sizeof(range)) == ESP_OK) {
-      if (strcmp(range, "week") == 0) {
+  uint32_t start_ts = 0, end_ts = 0;
+  bool has_start = false, has_end = false;
+  if (query != nullptr) {
+    char val[16] = {0};
+    if (httpd_query_key_value(query, "points", val, sizeof(val)) == ESP_OK) {
+      long v = strtol(val, nullptr, 10);
+      if (v <= 0) return bad("{\"error\":\"points must be a positive integer\"}");
+      out.points = (uint32_t) std::min<long>(v, kMaxHistoryPoints);
+    }
+    if (httpd_query_key_value(query, "start", val, sizeof(val)) == ESP_OK) {
+      start_ts = (uint32_t) strtoul(val, nullptr, 10);
+      has_start = true;
+    }
+    if (httpd_query_key_value(query, "end", val, sizeof(val)) == ESP_OK) {
+      end_ts = (uint32_t) strtoul(val, nullptr, 10);
+      has_end = true;
+    }
+    if (httpd_query_key_value(query, "range", val, sizeof(val)) == ESP_OK) {
+      if (strcmp(val, "week") == 0) {
         window_seconds = 7UL * 24 * 3600;
-        range_label = "week";
-      } else if (strcmp(range, "month") == 0) {
+        out.label = "week";
+      } else if (strcmp(val, "month") == 0) {
         window_seconds = 30UL * 24 * 3600;
-        range_label = "month";
-      } else if (strcmp(range, "year") == 0) {
+        out.label = "month";
+      } else if (strcmp(val, "year") == 0) {
         window_seconds = 365UL * 24 * 3600;
-        range_label = "year";
-      } else if (strcmp(range, "day") != 0) {
-        httpd_resp_set_status(req, "400 Bad Request");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\":\"range must be day|week|month|year\"}");
-        return ESP_OK;
+        out.label = "year";
+      } else if (strcmp(val, "day") != 0) {
+        return bad("{\"error\":\"range must be day|week|month|year\"}");
       }
     }
   }
@@ -3392,14 +3991,73 @@ esp_err_t TigoWebServer::api_history_power_handler(httpd_req_t *req) {
     httpd_resp_set_status(req, "503 Service Unavailable");
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"error\":\"system clock not set\"}");
+    return false;
+  }
+
+  if (has_start || has_end) {
+    // Either bound alone is fine: a missing end is now, a missing start is
+    // one `range` before the end.
+    out.end_ts = has_end ? std::min(end_ts, now_ts) : now_ts;
+    out.start_ts = has_start ? start_ts : (out.end_ts > window_seconds ? out.end_ts - window_seconds : 0);
+    out.label = "custom";
+    if (out.start_ts >= out.end_ts) return bad("{\"error\":\"start must be before end\"}");
+    if (out.end_ts - out.start_ts > kMaxHistoryWindowS) return bad("{\"error\":\"window longer than 5 years\"}");
+  } else {
+    out.end_ts = now_ts;
+    out.start_ts = (now_ts > window_seconds) ? (now_ts - window_seconds) : 0;
+  }
+  return true;
+}
+
+esp_err_t TigoWebServer::api_history_power_handler(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  if (!server->check_api_auth(req))
+    return ESP_OK;
+  return server->defer_history_query(req, api_history_power_query);
+}
+
+esp_err_t TigoWebServer::api_history_power_query(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  if (server->parent_ == nullptr) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
+    return ESP_OK;
+  }
+  tigo_monitor::TigoHistory *hist = server->parent_->get_history();
+  if (hist == nullptr || !hist->initialized()) {
+    send_history_unavailable(req, hist);
     return ESP_OK;
   }
-  uint32_t start_ts = (now_ts > window_seconds) ? (now_ts - window_seconds) : 0;
 
-  PSRAMString json;
+  char query_buf[128] = {0};
+  bool has_query = httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK;
+  HistoryQuery hq;
+  if (!parse_history_query(req, has_query ? query_buf : nullptr, hq))
+    return ESP_OK;
+  const uint32_t start_ts = hq.start_ts;
+  const uint32_t now_ts = hq.end_ts;
+  const uint32_t window_seconds = now_ts - start_ts;
+
+  // `points` first picks the storage tier (raw snapshots, hourly or daily
+  // rollups), then caps what that tier returns: if it would still exceed the
+  // budget, rows are folded into `points` min/avg/max buckets on the way out.
+  const tigo_monitor::HistoryTier tier = hist->pick_tier(window_seconds, hq.points);
+  const uint32_t tier_res_s = tier == tigo_monitor::TIER_RAW ? server->parent_->get_snapshot_interval_min() * 60
+                                                             : tigo_monitor::history_tier_seconds(tier);
+  const bool downsample = tier_res_s > 0 && window_seconds / tier_res_s > hq.points;
+  tigo_monitor::HistoryDownsampler ds(start_ts, now_ts, hq.points);
+
+  // Sent in 2 KB chunks, so the response is never built whole. Rows are
+  // collected first and formatted once the query has returned: nothing is
+  // sent while a history lock is held (HistoryRecords).
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  ChunkedResponse json(req);
   char tmp[96];
   json.append("{\"range\":\"");
-  json.append(range_label);
+  json.append(hq.label);
+  json.append("\",\"tier\":\"");
+  json.append(tigo_monitor::history_tier_str(tier));
   json.append("\",\"start\":");
   snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) start_ts);
   json.append(tmp);
@@ -3411,39 +4069,69 @@ esp_err_t TigoWebServer::api_history_power_handler(httpd_req_t *req) {
   json.append(",\"interval_min\":");
   snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) server->parent_->get_snapshot_interval_min());
   json.append(tmp);
+  // Seconds per record: the snapshot cadence for raw rows, the bucket width
+  // for rollups or downsampled output. Those rows carry the bucket's min and
+  // max as "lo"/"hi"; "p" is always the average and "e" the energy in the
+  // record's span.
+  json.append(",\"resolution_s\":");
+  snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) (downsample ? ds.width_s() : tier_res_s));
+  json.append(tmp);
+  json.append(",\"points\":");
+  snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) hq.points);
+  json.append(tmp);
   json.append(",\"records\":[");
 
   bool first = true;
-  // Hard cap response to ~1 MB; runaway query (corrupt index, huge range) cant exhaust heap.
-  constexpr size_t kMaxBytes = 1u << 20;
+  int emitted = 0;
+  const bool with_range = downsample || tier != tigo_monitor::TIER_RAW;
+  auto emit = [&](uint32_t ts, float p_avg, float p_min, float p_max, float e_kwh) {
+    if (!first)
+      json.append(",");
+    first = false;
+    char row[96];
+    if (!with_range) {
+      snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d,\"e\":%.2f}",
+               (unsigned long) ts, (int) p_avg, e_kwh);
+    } else {
+      snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d,\"lo\":%d,\"hi\":%d,\"e\":%.2f}",
+               (unsigned long) ts, (int) lroundf(p_avg), (int) p_min, (int) p_max, e_kwh);
+    }
+    json.append(row);
+    ++emitted;
+  };
+  HistoryRecords records(hq.points);
+  auto collect = [&](uint32_t ts, float p_avg, float p_min, float p_max, float e_kwh) {
+    records.add(ts, p_avg, p_min, p_max, e_kwh);
+  };
   uint32_t t0_ms = (uint32_t) (esp_timer_get_time() / 1000);
-  int n = hist->iterate_power(start_ts, now_ts,
-      [&](uint32_t ts, int16_t total_p, int16_t total_e_x100) {
-        if (json.length() > kMaxBytes)
-          return;  // we still get called, just skip emit
-        if (!first)
-          json.append(",");
-        first = false;
-        char row[64];
-        snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d,\"e\":%.2f}",
-                 (unsigned long) ts, (int) total_p, total_e_x100 / 100.0f);
-        json.append(row);
+  int n = hist->iterate_power_tier(tier, start_ts, now_ts,
+      [&](uint32_t ts, float p_avg, float p_min, float p_max, float e_kwh) {
+        if (downsample)
+          ds.add(ts, p_avg, p_min, p_max, e_kwh, collect);
+        else
+          collect(ts, p_avg, p_min, p_max, e_kwh);
       });
+  if (downsample)
+    ds.flush(collect);
   uint32_t dt_ms = (uint32_t) (esp_timer_get_time() / 1000) - t0_ms;
+  records.for_each(emit);
 
+  // "count" is records returned; "rows" what the query read to make them.
   json.append("],\"count\":");
+  snprintf(tmp, sizeof(tmp), "%d", emitted);
+  json.append(tmp);
+  json.append(",\"rows\":");
   snprintf(tmp, sizeof(tmp), "%d", (n < 0) ? 0 : n);
   json.append(tmp);
   json.append(",\"query_ms\":");
   snprintf(tmp, sizeof(tmp), "%u", (unsigned) dt_ms);
   json.append(tmp);
+  if (records.truncated())
+    json.append(",\"truncated\":true");
   if (n < 0)
     json.append(",\"error\":\"query failed\"");
   json.append("}");
-
-  httpd_resp_set_type(req, "application/json");
-  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-  httpd_resp_send(req, json.c_str(), json.length());
+  json.finish();
   return ESP_OK;
 }
 
@@ -3451,7 +4139,11 @@ esp_err_t TigoWebServer::api_history_panel_handler(httpd_req_t *req) {
   TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
   if (!server->check_api_auth(req))
     return ESP_OK;
+  return server->defer_history_query(req, api_history_panel_query);
+}
 
+esp_err_t TigoWebServer::api_history_panel_query(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
   if (server->parent_ == nullptr) {
     httpd_resp_set_status(req, "503 Service Unavailable");
     httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
@@ -3459,65 +4151,75 @@ esp_err_t TigoWebServer::api_history_panel_handler(httpd_req_t *req) {
   }
   tigo_monitor::TigoHistory *hist = server->parent_->get_history();
   if (hist == nullptr || !hist->initialized()) {
-    httpd_resp_set_status(req, "503 Service Unavailable");
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"error\":\"history not initialized\"}");
+    send_history_unavailable(req, hist);
     return ESP_OK;
   }
 
-  // Parse slot (required) + range (optional, default day).
+  // Parse slot (required), metric (default power) + window and budget (see
+  // parse_history_query).
   int slot_int = -1;
-  uint32_t window_seconds = 24 * 3600;
-  const char *range_label = "day";
-  char query_buf[64] = {0};
-  if (httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK) {
+  tigo_monitor::PanelMetric metric = tigo_monitor::PANEL_POWER;
+  bool metric_ok = true;
+  char query_buf[128] = {0};
+  bool has_query = httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK;
+  if (has_query) {
     char slot_str[8] = {0};
     if (httpd_query_key_value(query_buf, "slot", slot_str, sizeof(slot_str)) == ESP_OK) {
       slot_int = atoi(slot_str);
     }
-    char range[16] = {0};
-    if (httpd_query_key_value(query_buf, "range", range, sizeof(range)) == ESP_OK) {
-      if (strcmp(range, "week") == 0) {
-        window_seconds = 7UL * 24 * 3600;
-        range_label = "week";
-      } else if (strcmp(range, "month") == 0) {
-        window_seconds = 30UL * 24 * 3600;
-        range_label = "month";
-      } else if (strcmp(range, "year") == 0) {
-        window_seconds = 365UL * 24 * 3600;
-        range_label = "year";
-      } else if (strcmp(range, "day") != 0) {
-        httpd_resp_set_status(req, "400 Bad Request");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\":\"range must be day|week|month|year\"}");
-        return ESP_OK;
-      }
+    char metric_str[8] = {0};
+    if (httpd_query_key_value(query_buf, "metric", metric_str, sizeof(metric_str)) == ESP_OK) {
+      metric_ok = tigo_monitor::parse_panel_metric(metric_str, metric) && tigo_monitor::panel_metric_enabled(metric);
     }
   }
 
   if (slot_int < 0 || slot_int >= (int) tigo_monitor::kMaxPanelSlots) {
     httpd_resp_set_status(req, "400 Bad Request");
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"error\":\"slot must be 0..47\"}");
+    char err[64];
+    snprintf(err, sizeof(err), "{\"error\":\"slot must be 0..%u\"}", (unsigned) tigo_monitor::kMaxPanelSlots - 1);
+    httpd_resp_sendstr(req, err);
     return ESP_OK;
   }
-
-  uint32_t now_ts = (uint32_t) ::time(nullptr);
-  if (now_ts < 1577836800u /* 2020-01-01 */) {
-    httpd_resp_set_status(req, "503 Service Unavailable");
+  if (!metric_ok) {
+    // Unknown, or not in this build's history_panel_metrics: list what is.
+    httpd_resp_set_status(req, "400 Bad Request");
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"error\":\"system clock not set\"}");
+    std::string err = "{\"error\":\"metric must be one of:";
+    for (size_t f = 0; f < tigo_monitor::kNumPanelFamilies; ++f) {
+      err += f == 0 ? " " : ", ";
+      err += tigo_monitor::panel_metric_str(tigo_monitor::panel_family_metric(f));
+    }
+    err += "\"}";
+    httpd_resp_sendstr(req, err.c_str());
     return ESP_OK;
   }
-  uint32_t start_ts = (now_ts > window_seconds) ? (now_ts - window_seconds) : 0;
+  const float scale = tigo_monitor::panel_metric_scale(metric);
 
-  PSRAMString json;
+  HistoryQuery hq;
+  if (!parse_history_query(req, has_query ? query_buf : nullptr, hq))
+    return ESP_OK;
+  const uint32_t start_ts = hq.start_ts;
+  const uint32_t now_ts = hq.end_ts;
+  // Panel history is raw only; past the budget it is folded into `points`
+  // min/avg/max buckets as it is read.
+  const uint32_t res_s = server->parent_->get_snapshot_interval_min() * 60;
+  const bool downsample = res_s > 0 && (now_ts - start_ts) / res_s > hq.points;
+  tigo_monitor::HistoryDownsampler ds(start_ts, now_ts, hq.points);
+
+  // Chunked, and collected before sending, as in the power handler.
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  ChunkedResponse json(req);
   char tmp[96];
   json.append("{\"slot\":");
   snprintf(tmp, sizeof(tmp), "%d", slot_int);
   json.append(tmp);
+  snprintf(tmp, sizeof(tmp), ",\"metric\":\"%s\",\"unit\":\"%s\"", tigo_monitor::panel_metric_str(metric),
+           tigo_monitor::panel_metric_unit(metric));
+  json.append(tmp);
   json.append(",\"range\":\"");
-  json.append(range_label);
+  json.append(hq.label);
   json.append("\",\"start\":");
   snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) start_ts);
   json.append(tmp);
@@ -3529,46 +4231,266 @@ esp_err_t TigoWebServer::api_history_panel_handler(httpd_req_t *req) {
   json.append(",\"interval_min\":");
   snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) server->parent_->get_snapshot_interval_min());
   json.append(tmp);
+  json.append(",\"resolution_s\":");
+  snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) (downsample ? ds.width_s() : res_s));
+  json.append(tmp);
+  json.append(",\"points\":");
+  snprintf(tmp, sizeof(tmp), "%lu", (unsigned long) hq.points);
+  json.append(tmp);
   json.append(",\"records\":[");
 
   bool first = true;
-  constexpr size_t kMaxBytes = 1u << 20;
+  int emitted = 0;
+  // Power keeps its integer-watt `p` rows; other metrics are `v`, in their
+  // unit, to the precision they are stored at.
+  const bool power = metric == tigo_monitor::PANEL_POWER;
+  const int decimals = scale >= 100.0f ? 2 : (scale >= 10.0f ? 1 : 0);
+  auto emit = [&](uint32_t ts, float p_avg, float p_min, float p_max, float) {
+    if (!first)
+      json.append(",");
+    first = false;
+    char row[96];
+    if (power && !downsample) {
+      snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d}", (unsigned long) ts, (int) p_avg);
+    } else if (power) {
+      snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d,\"lo\":%d,\"hi\":%d}", (unsigned long) ts,
+               (int) lroundf(p_avg), (int) p_min, (int) p_max);
+    } else if (!downsample) {
+      snprintf(row, sizeof(row), "{\"t\":%lu,\"v\":%.*f}", (unsigned long) ts, decimals, p_avg / scale);
+    } else {
+      snprintf(row, sizeof(row), "{\"t\":%lu,\"v\":%.*f,\"lo\":%.*f,\"hi\":%.*f}", (unsigned long) ts,
+               decimals, p_avg / scale, decimals, p_min / scale, decimals, p_max / scale);
+    }
+    json.append(row);
+    ++emitted;
+  };
+  HistoryRecords records(hq.points);
+  auto collect = [&](uint32_t ts, float p_avg, float p_min, float p_max, float e_kwh) {
+    records.add(ts, p_avg, p_min, p_max, e_kwh);
+  };
   uint32_t t0_ms = (uint32_t) (esp_timer_get_time() / 1000);
   int n = hist->iterate_panel((uint8_t) slot_int, start_ts, now_ts,
-      [&](uint32_t ts, int16_t power_w) {
-        if (json.length() > kMaxBytes)
-          return;
-        if (!first)
-          json.append(",");
-        first = false;
-        char row[48];
-        snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d}",
-                 (unsigned long) ts, (int) power_w);
-        json.append(row);
-      });
+      [&](uint32_t ts, int16_t raw) {
+        const float p = (float) raw;
+        if (downsample)
+          ds.add(ts, p, p, p, 0.0f, collect);
+        else
+          collect(ts, p, p, p, 0.0f);
+      }, metric);
+  if (downsample)
+    ds.flush(collect);
   uint32_t dt_ms = (uint32_t) (esp_timer_get_time() / 1000) - t0_ms;
+  records.for_each(emit);
 
   json.append("],\"count\":");
+  snprintf(tmp, sizeof(tmp), "%d", emitted);
+  json.append(tmp);
+  json.append(",\"rows\":");
   snprintf(tmp, sizeof(tmp), "%d", (n < 0) ? 0 : n);
   json.append(tmp);
   json.append(",\"query_ms\":");
   snprintf(tmp, sizeof(tmp), "%u", (unsigned) dt_ms);
   json.append(tmp);
+  if (records.truncated())
+    json.append(",\"truncated\":true");
   if (n < 0)
     json.append(",\"error\":\"query failed\"");
   json.append("}");
+  json.finish();
+  return ESP_OK;
+}
+
+// In-place %XX and '+' decoding for a query value — httpd_query_key_value
+// hands it over still URL-encoded, and string labels have spaces in them.
+static void url_decode_in_place(char *s) {
+  auto hex = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+  char *out = s;
+  for (const char *in = s; *in != '\0'; ++in) {
+    if (*in == '+') {
+      *out++ = ' ';
+    } else if (*in == '%' && hex(in[1]) >= 0 && hex(in[2]) >= 0) {
+      *out++ = (char) (hex(in[1]) * 16 + hex(in[2]));
+      in += 2;
+    } else {
+      *out++ = *in;
+    }
+  }
+  *out = '\0';
+}
+
+// One string's or inverter's series from strings.tsdb / inverters.tsdb,
+// named by its canonical label (`label=` for a string, `name=` for an
+// inverter). A single-column read — two for an inverter, whose rows also
+// carry energy — where the string view used to be rebuilt from every panel
+// on the string. Raw rows, downsampled past `points` like a panel's.
+esp_err_t TigoWebServer::api_history_series_query(httpd_req_t *req, tigo_monitor::SeriesGroup group) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  tigo_monitor::TigoMonitorComponent *parent = server->parent_;
+  if (parent == nullptr) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
+    return ESP_OK;
+  }
+  tigo_monitor::TigoHistory *hist = parent->get_history();
+  if (hist == nullptr || !hist->initialized()) {
+    send_history_unavailable(req, hist);
+    return ESP_OK;
+  }
+
+  const bool is_string = group == tigo_monitor::GROUP_STRING;
+  const char *key = is_string ? "label" : "name";
+  char query_buf[256] = {0};
+  char label[96] = {0};
+  bool has_query = httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK;
+  if (has_query && httpd_query_key_value(query_buf, key, label, sizeof(label)) == ESP_OK)
+    url_decode_in_place(label);
+  const uint8_t column = label[0] != '\0' ? hist->find_series(group, label) : 0xFF;
+  if (column == 0xFF) {
+    // Missing or never recorded: list the labels that have a series.
+    httpd_resp_set_status(req, label[0] != '\0' ? "404 Not Found" : "400 Bad Request");
+    httpd_resp_set_type(req, "application/json");
+    std::string err = "{\"error\":\"";
+    err += label[0] != '\0' ? "no history for this " : "missing ";
+    err += label[0] != '\0' ? tigo_monitor::series_group_str(group) : key;
+    err += "\",\"known\":[";
+    bool first_label = true;
+    for (const auto &e : hist->snapshot_series_map(group)) {
+      if (!first_label) err += ",";
+      first_label = false;
+      err += "\"" + e.label + "\"";  // never holds '"' or '\\' (get_or_assign_series)
+    }
+    err += "]}";
+    httpd_resp_sendstr(req, err.c_str());
+    return ESP_OK;
+  }
 
+  HistoryQuery hq;
+  if (!parse_history_query(req, has_query ? query_buf : nullptr, hq))
+    return ESP_OK;
+  const uint32_t start_ts = hq.start_ts;
+  const uint32_t now_ts = hq.end_ts;
+  const uint32_t res_s = parent->get_snapshot_interval_min() * 60;
+  const bool downsample = res_s > 0 && (now_ts - start_ts) / res_s > hq.points;
+  tigo_monitor::HistoryDownsampler ds(start_ts, now_ts, hq.points);
+
+  // Chunked, and collected before sending, as in the power handler.
   httpd_resp_set_type(req, "application/json");
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-  httpd_resp_send(req, json.c_str(), json.length());
+  ChunkedResponse json(req);
+  char tmp[96];
+  json.append("{\"");
+  json.append(key);
+  json.append("\":\"");
+  json.append(label);
+  snprintf(tmp, sizeof(tmp), "\",\"column\":%u,\"range\":\"", (unsigned) column);
+  json.append(tmp);
+  json.append(hq.label);
+  snprintf(tmp, sizeof(tmp), "\",\"start\":%lu,\"end\":%lu", (unsigned long) start_ts, (unsigned long) now_ts);
+  json.append(tmp);
+  snprintf(tmp, sizeof(tmp), ",\"interval_min\":%lu,\"resolution_s\":%lu,\"points\":%lu",
+           (unsigned long) parent->get_snapshot_interval_min(),
+           (unsigned long) (downsample ? ds.width_s() : res_s), (unsigned long) hq.points);
+  json.append(tmp);
+  json.append(",\"records\":[");
+
+  // Rows as in /api/history/power: "p" watts (with "lo"/"hi" once
+  // downsampled) and, for an inverter, "e" kWh over the record's span.
+  bool first = true;
+  int emitted = 0;
+  auto emit = [&](uint32_t ts, float p_avg, float p_min, float p_max, float e_kwh) {
+    if (!first)
+      json.append(",");
+    first = false;
+    char row[96];
+    int len;
+    if (!downsample) {
+      len = snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d", (unsigned long) ts, (int) p_avg);
+    } else {
+      len = snprintf(row, sizeof(row), "{\"t\":%lu,\"p\":%d,\"lo\":%d,\"hi\":%d", (unsigned long) ts,
+                     (int) lroundf(p_avg), (int) p_min, (int) p_max);
+    }
+    if (!is_string)
+      snprintf(row + len, sizeof(row) - len, ",\"e\":%.2f}", e_kwh);
+    else
+      snprintf(row + len, sizeof(row) - len, "}");
+    json.append(row);
+    ++emitted;
+  };
+  HistoryRecords records(hq.points);
+  auto collect = [&](uint32_t ts, float p_avg, float p_min, float p_max, float e_kwh) {
+    records.add(ts, p_avg, p_min, p_max, e_kwh);
+  };
+  uint32_t t0_ms = (uint32_t) (esp_timer_get_time() / 1000);
+  int n = hist->iterate_series(group, column, start_ts, now_ts,
+      [&](uint32_t ts, int16_t p_raw, int16_t e_raw) {
+        const float p = (float) p_raw;
+        const float e = e_raw / 100.0f;
+        if (downsample)
+          ds.add(ts, p, p, p, e, collect);
+        else
+          collect(ts, p, p, p, e);
+      });
+  if (downsample)
+    ds.flush(collect);
+  uint32_t dt_ms = (uint32_t) (esp_timer_get_time() / 1000) - t0_ms;
+  records.for_each(emit);
+
+  snprintf(tmp, sizeof(tmp), "],\"count\":%d,\"rows\":%d,\"query_ms\":%u", emitted, (n < 0) ? 0 : n,
+           (unsigned) dt_ms);
+  json.append(tmp);
+  if (records.truncated())
+    json.append(",\"truncated\":true");
+  if (n < 0)
+    json.append(",\"error\":\"query failed\"");
+  json.append("}");
+  json.finish();
   return ESP_OK;
 }
 
-esp_err_t TigoWebServer::api_panels_handler(httpd_req_t *req) {
+esp_err_t TigoWebServer::api_history_string_handler(httpd_req_t *req) {
   TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
   if (!server->check_api_auth(req))
     return ESP_OK;
+  return server->defer_history_query(req, api_history_string_query);
+}
 
+esp_err_t TigoWebServer::api_history_string_query(httpd_req_t *req) {
+  return api_history_series_query(req, tigo_monitor::GROUP_STRING);
+}
+
+esp_err_t TigoWebServer::api_history_inverter_handler(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  if (!server->check_api_auth(req))
+    return ESP_OK;
+  return server->defer_history_query(req, api_history_inverter_query);
+}
+
+esp_err_t TigoWebServer::api_history_inverter_query(httpd_req_t *req) {
+  return api_history_series_query(req, tigo_monitor::GROUP_INVERTER);
+}
+
+// Several panels at once, column-oriented:
+//   {"slots":[0,3],"barcodes":["abc123","def456"],"t":[...],"p":[[...],[...]]}
+// p[i] is slots[i]'s power at each t, null where its DB has no row. Backed by
+// iterate_panels(), which reads each panel DB once for all its columns rather
+// than once per slot. The matrix is assembled in PSRAM (it has to be complete
+// before the first column can be sent) and is at most kMaxPanelsPoints rows.
+static constexpr uint32_t kMaxPanelsPoints = 1000;
+
+esp_err_t TigoWebServer::api_history_panels_handler(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  if (!server->check_api_auth(req))
+    return ESP_OK;
+  return server->defer_history_query(req, api_history_panels_query);
+}
+
+esp_err_t TigoWebServer::api_history_panels_query(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
   if (server->parent_ == nullptr) {
     httpd_resp_set_status(req, "503 Service Unavailable");
     httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
@@ -3576,73 +4498,242 @@ esp_err_t TigoWebServer::api_panels_handler(httpd_req_t *req) {
   }
   tigo_monitor::TigoHistory *hist = server->parent_->get_history();
   if (hist == nullptr || !hist->initialized()) {
-    httpd_resp_set_status(req, "503 Service Unavailable");
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"error\":\"history not initialized\"}");
+    send_history_unavailable(req, hist);
     return ESP_OK;
   }
 
-  // Build a barcode-suffix -> NodeTableData lookup so we can attach friendly
-  // names from CCA metadata to each slot. node_table_ keys are 16-char
-  // long_addresses; the slot map keys on the last 6 chars of the barcode.
-  auto nodes = server->parent_->snapshot_node_table();
-  std::unordered_map<std::string, const tigo_monitor::NodeTableData *> by_suffix;
-  for (const auto &n : nodes) {
-    if (n.long_address.size() >= 6) {
-      by_suffix[tigo_monitor::to_std_string(n.long_address).substr(n.long_address.size() - 6)] = &n;
+  // slots=0,3,17 — or "all"/absent for every assigned slot. Sized for an
+  // explicit list of all 128 slots at the largest history_panel_dbs.
+  char query_buf[512] = {0};
+  bool has_query = httpd_req_get_url_query_str(req, query_buf, sizeof(query_buf)) == ESP_OK;
+  std::vector<tigo_monitor::PanelSlot> slot_map = hist->snapshot_slot_map();
+  tigo_monitor::PanelSlotMask mask;
+  char slots_str[448] = {0};
+  if (has_query && httpd_query_key_value(query_buf, "slots", slots_str, sizeof(slots_str)) == ESP_OK &&
+      strcmp(slots_str, "all") != 0) {
+    const char *p = slots_str;
+    while (*p != '\0') {
+      char *endp = nullptr;
+      long v = strtol(p, &endp, 10);
+      if (endp == p || v < 0 || v >= (long) tigo_monitor::kMaxPanelSlots || (*endp != ',' && *endp != '\0')) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_set_type(req, "application/json");
+        char err[96];
+        snprintf(err, sizeof(err), "{\"error\":\"slots must be a comma-separated list of 0..%u\"}",
+                 (unsigned) tigo_monitor::kMaxPanelSlots - 1);
+        httpd_resp_sendstr(req, err);
+        return ESP_OK;
+      }
+      mask.set((size_t) v);
+      p = (*endp == ',') ? endp + 1 : endp;
     }
+  } else {
+    for (const auto &ps : slot_map) mask.set(ps.slot);
+  }
+
+  HistoryQuery hq;
+  if (!parse_history_query(req, has_query ? query_buf : nullptr, hq))
+    return ESP_OK;
+  const uint32_t points = std::min(hq.points, kMaxPanelsPoints);
+
+  uint8_t slots[tigo_monitor::kMaxPanelSlots];
+  size_t nslots = 0;
+  for (uint8_t s = 0; s < tigo_monitor::kMaxPanelSlots; ++s)
+    if (mask.test(s)) slots[nslots++] = s;
+
+  // Rows land in `points` equal-width time buckets (per-slot mean), or one
+  // per stored row when the range is within the budget.
+  const uint32_t res_s = server->parent_->get_snapshot_interval_min() * 60;
+  const uint32_t span = hq.end_ts - hq.start_ts + 1;
+  const bool downsample = res_s > 0 && (hq.end_ts - hq.start_ts) / res_s > points;
+  const uint32_t width = downsample ? (span + points - 1) / points : 0;
+
+  psram_vector<uint32_t> times;
+  psram_vector<int16_t> cells;  // row-major, nslots per row; INT16_MIN = no value
+  times.reserve(points);
+  cells.reserve((size_t) points * nslots);
+  float sums[tigo_monitor::kMaxPanelSlots];
+  uint16_t counts[tigo_monitor::kMaxPanelSlots];
+  uint32_t bucket_idx = 0, bucket_ts = 0;
+  bool open = false, truncated = false;
+  auto close_bucket = [&]() {
+    if (!open) return;
+    open = false;
+    if (times.size() >= points) {
+      truncated = true;  // stored rows denser than the current cadence
+      return;
+    }
+    times.push_back(bucket_ts);
+    for (size_t i = 0; i < nslots; ++i)
+      cells.push_back(counts[i] > 0 ? (int16_t) lroundf(sums[i] / counts[i]) : INT16_MIN);
+  };
+
+  uint32_t t0_ms = (uint32_t) (esp_timer_get_time() / 1000);
+  uint32_t row_no = 0;
+  int n = mask.none() ? 0 : hist->iterate_panels(mask, hq.start_ts, hq.end_ts,
+      [&](uint32_t ts, const int16_t *values, const tigo_monitor::PanelSlotMask &present) {
+        const uint32_t idx = downsample ? (ts - hq.start_ts) / width : row_no++;
+        if (open && idx != bucket_idx) close_bucket();
+        if (!open) {
+          open = true;
+          bucket_idx = idx;
+          bucket_ts = ts;
+          for (size_t i = 0; i < nslots; ++i) {
+            sums[i] = 0.0f;
+            counts[i] = 0;
+          }
+        }
+        for (size_t i = 0; i < nslots; ++i) {
+          if (!present.test(slots[i])) continue;
+          sums[i] += values[slots[i]];
+          counts[i]++;
+        }
+      });
+  close_bucket();
+  uint32_t dt_ms = (uint32_t) (esp_timer_get_time() / 1000) - t0_ms;
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  ChunkedResponse json(req);
+  char tmp[64];
+  json.append("{\"range\":\"");
+  json.append(hq.label);
+  snprintf(tmp, sizeof(tmp), "\",\"start\":%lu,\"end\":%lu", (unsigned long) hq.start_ts,
+           (unsigned long) hq.end_ts);
+  json.append(tmp);
+  snprintf(tmp, sizeof(tmp), ",\"resolution_s\":%lu,\"points\":%lu", (unsigned long) (downsample ? width : res_s),
+           (unsigned long) points);
+  json.append(tmp);
+  json.append(",\"slots\":[");
+  for (size_t i = 0; i < nslots; ++i) {
+    snprintf(tmp, sizeof(tmp), "%s%u", i ? "," : "", (unsigned) slots[i]);
+    json.append(tmp);
+  }
+  json.append("],\"barcodes\":[");
+  for (size_t i = 0; i < nslots; ++i) {
+    const char *barcode = "";
+    for (const auto &ps : slot_map)
+      if (ps.slot == slots[i]) barcode = ps.barcode_last6.c_str();
+    json.append(i ? ",\"" : "\"");
+    json.append(barcode);
+    json.append("\"");
+  }
+  json.append("],\"t\":[");
+  for (size_t r = 0; r < times.size(); ++r) {
+    snprintf(tmp, sizeof(tmp), "%s%lu", r ? "," : "", (unsigned long) times[r]);
+    json.append(tmp);
+  }
+  json.append("],\"p\":[");
+  for (size_t i = 0; i < nslots; ++i) {
+    json.append(i ? ",[" : "[");
+    for (size_t r = 0; r < times.size(); ++r) {
+      int16_t v = cells[r * nslots + i];
+      if (v == INT16_MIN)
+        snprintf(tmp, sizeof(tmp), "%snull", r ? "," : "");
+      else
+        snprintf(tmp, sizeof(tmp), "%s%d", r ? "," : "", (int) v);
+      json.append(tmp);
+    }
+    json.append("]");
+  }
+  snprintf(tmp, sizeof(tmp), "],\"count\":%u,\"rows\":%d,\"query_ms\":%u", (unsigned) times.size(),
+           (n < 0) ? 0 : n, (unsigned) dt_ms);
+  json.append(tmp);
+  if (truncated)
+    json.append(",\"truncated\":true");
+  if (n < 0)
+    json.append(",\"error\":\"query failed\"");
+  json.append("}");
+  json.finish();
+  return ESP_OK;
+}
+
+esp_err_t TigoWebServer::api_panels_handler(httpd_req_t *req) {
+  TigoWebServer *server = static_cast<TigoWebServer *>(req->user_ctx);
+  if (!server->check_api_auth(req))
+    return ESP_OK;
+
+  if (server->parent_ == nullptr) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_sendstr(req, "{\"error\":\"monitor not bound\"}");
+    return ESP_OK;
+  }
+  tigo_monitor::TigoHistory *hist = server->parent_->get_history();
+  if (hist == nullptr || !hist->initialized()) {
+    send_history_unavailable(req, hist);
+    return ESP_OK;
   }
 
   std::vector<tigo_monitor::PanelSlot> slots = hist->snapshot_slot_map();
+  std::vector<tigo_monitor::PanelTrend> trends;
+  hist->copy_trends(trends);
+
+  // CCA labels can contain quotes/backslashes — escape them. Most installs
+  // won't, but better to be defensive than to break the parse. Escaped
+  // through a stack buffer straight into the PSRAM document, so no
+  // per-label string is built.
+  auto append_escaped = [](PSRAMString &out, const tigo_monitor::node_string &in) {
+    char buf[64];
+    size_t n = 0;
+    for (char c : in) {
+      // Drop control chars rather than emit \u escapes.
+      if ((unsigned char) c < 0x20) continue;
+      if (n + 3 > sizeof(buf)) {
+        buf[n] = '\0';
+        out.append(buf);
+        n = 0;
+      }
+      if (c == '"' || c == '\\') buf[n++] = '\\';
+      buf[n++] = c;
+    }
+    buf[n] = '\0';
+    out.append(buf);
+  };
 
   PSRAMString json;
   json.append("{\"slots\":[");
   bool first = true;
-  for (const auto &s : slots) {
-    if (!first) json.append(",");
-    first = false;
-    char row[256];
-    const tigo_monitor::NodeTableData *node = nullptr;
-    auto it = by_suffix.find(s.barcode_last6);
-    if (it != by_suffix.end()) node = it->second;
-
-    // CCA labels can contain quotes/backslashes — escape them. Most installs
-    // won't, but better to be defensive than to break the parse.
-    auto json_escape = [](const std::string &in) {
-      std::string out;
-      out.reserve(in.size());
-      for (char c : in) {
-        if (c == '"' || c == '\\') {
-          out.push_back('\\');
-          out.push_back(c);
-        } else if ((unsigned char) c < 0x20) {
-          // Drop control chars rather than emit \u escapes.
-          continue;
-        } else {
-          out.push_back(c);
-        }
+  // Friendly names come from the node table's CCA metadata, found through the
+  // monitor's barcode index by the slot's 6-digit barcode suffix. Read in
+  // place under the state lock rather than from a copy of the whole table.
+  server->parent_->with_state_lock([&]() {
+    for (const auto &s : slots) {
+      if (!first) json.append(",");
+      first = false;
+      char row[256];
+      const tigo_monitor::NodeTableData *node =
+          server->parent_->find_node_by_barcode_suffix(s.barcode_last6.c_str());
+
+      snprintf(row, sizeof(row),
+               "{\"slot\":%u,\"barcode\":\"%s\"",
+               (unsigned) s.slot, s.barcode_last6.c_str());
+      json.append(row);
+      if (node != nullptr) {
+        json.append(",\"label\":\"");
+        append_escaped(json, node->cca_label);
+        json.append("\",\"mppt\":\"");
+        append_escaped(json, node->cca_inverter_label);
+        json.append("\",\"string\":\"");
+        append_escaped(json, node->cca_string_label);
+        json.append("\"");
       }
-      return out;
-    };
 
-    snprintf(row, sizeof(row),
-             "{\"slot\":%u,\"barcode\":\"%s\"",
-             (unsigned) s.slot, s.barcode_last6.c_str());
-    json.append(row);
-    if (node != nullptr) {
-      std::string label = json_escape(tigo_monitor::to_std_string(node->cca_label));
-      std::string mppt = json_escape(tigo_monitor::to_std_string(node->cca_inverter_label));
-      std::string str_lbl = json_escape(tigo_monitor::to_std_string(node->cca_string_label));
-      json.append(",\"label\":\"");
-      json.append(label.c_str());
-      json.append("\",\"mppt\":\"");
-      json.append(mppt.c_str());
-      json.append("\",\"string\":\"");
-      json.append(str_lbl.c_str());
-      json.append("\"");
+      // Degradation relative to the panel's string (tigo_trend.h). null until
+      // the fit spans enough days to mean anything.
+      const tigo_monitor::PanelTrend &t = trends[s.slot];
+      float rate = t.rate_pct_per_year();
+      char rate_str[16] = "null";
+      char level_str[16] = "null";
+      if (!std::isnan(rate)) snprintf(rate_str, sizeof(rate_str), "%.2f", rate);
+      if (!std::isnan(t.ewma)) snprintf(level_str, sizeof(level_str), "%.3f", t.ewma);
+      snprintf(row, sizeof(row),
+               ",\"degradation_pct_per_year\":%s,\"relative_level\":%s,\"trend_days\":%.0f,"
+               "\"trend_samples\":%lu",
+               rate_str, level_str, t.span_days, (unsigned long) t.n);
+      json.append(row);
+      json.append("}");
     }
-    json.append("}");
-  }
+  });
   json.append("],\"count\":");
   char tmp[16];
   snprintf(tmp, sizeof(tmp), "%zu", slots.size());
@@ -3669,9 +4760,7 @@ esp_err_t TigoWebServer::api_tsdb_stats_handler(httpd_req_t *req) {
   }
   tigo_monitor::TigoHistory *hist = server->parent_->get_history();
   if (hist == nullptr || !hist->initialized()) {
-    httpd_resp_set_status(req, "503 Service Unavailable");
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"error\":\"history not initialized\"}");
+    send_history_unavailable(req, hist);
     return ESP_OK;
   }
 
@@ -3704,7 +4793,7 @@ esp_err_t TigoWebServer::api_tsdb_stats_handler(httpd_req_t *req) {
   }
 
   psram_string json;
-  server->build_tsdb_stats_json_(snap, json);
+  server->build_tsdb_stats_json_(hist, snap, json);
 
   httpd_resp_set_type(req, "application/json");
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -3712,7 +4801,7 @@ esp_err_t TigoWebServer::api_tsdb_stats_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
-void TigoWebServer::build_tsdb_stats_json_(
+void TigoWebServer::build_tsdb_stats_json_(tigo_monitor::TigoHistory *hist,
     const tigo_monitor::TigoHistory::StatsSnapshot &snap, psram_string &json) {
   json.clear();
   char buf[160];
@@ -3726,6 +4815,15 @@ void TigoWebServer::build_tsdb_stats_json_(
   snprintf(buf, sizeof(buf), "%zu", snap.fs_total); json.append(buf);
   json.append(",\"used\":");
   snprintf(buf, sizeof(buf), "%zu", snap.fs_used); json.append(buf);
+  // The file sizes init() planned for this partition; DBs created under an
+  // older layout keep their own capacity (max_records below).
+  const tigo_monitor::TigoHistory::FileSizes &fs = hist->file_sizes();
+  snprintf(buf, sizeof(buf), ",\"partition\":%zu},\"sizing\":{\"system\":%zu,\"panel\":%zu,\"metric\":%zu",
+           fs.partition, fs.system, fs.panel, fs.metric);
+  json.append(buf);
+  snprintf(buf, sizeof(buf), ",\"hourly\":%zu,\"daily\":%zu,\"strings\":%zu,\"inverters\":%zu", fs.rollup[0],
+           fs.rollup[1], fs.series[0], fs.series[1]);
+  json.append(buf);
   json.append("},\"snapshot_age_ms\":");
   snprintf(buf, sizeof(buf), "%lu", (unsigned long) age_ms); json.append(buf);
   json.append(",\"slots\":{\"used\":");
@@ -3734,6 +4832,26 @@ void TigoWebServer::build_tsdb_stats_json_(
   snprintf(buf, sizeof(buf), "%u", (unsigned) snap.next_free_slot); json.append(buf);
   json.append(",\"max\":");
   snprintf(buf, sizeof(buf), "%zu", tigo_monitor::kMaxPanelSlots); json.append(buf);
+  // String and inverter columns assigned, against each DB's capacity.
+  snprintf(buf, sizeof(buf),
+           "},\"series\":{\"strings\":{\"used\":%zu,\"max\":%zu},\"inverters\":{\"used\":%zu,\"max\":%zu}",
+           snap.series_count[0], tigo_monitor::kMaxStringSeries, snap.series_count[1],
+           tigo_monitor::kMaxInverterSeries);
+  json.append(buf);
+  // Recent-rows cache: RAM-only counters, like everything else here.
+  tigo_monitor::TigoHistory::RecentCacheInfo rc = hist->recent_cache_info();
+  snprintf(buf, sizeof(buf), "},\"recent_cache\":{\"rows\":%zu,\"capacity\":%zu", rc.rows, rc.capacity);
+  json.append(buf);
+  snprintf(buf, sizeof(buf), ",\"floor_ts\":%lu,\"hits\":%lu,\"misses\":%lu", (unsigned long) rc.floor_ts,
+           (unsigned long) rc.hits, (unsigned long) rc.misses);
+  json.append(buf);
+  tigo_monitor::HistoryQueryCache::Info qc = hist->query_cache_info();
+  snprintf(buf, sizeof(buf), "},\"query_cache\":{\"entries\":%zu,\"rows\":%zu,\"hits\":%lu", qc.entries, qc.rows,
+           (unsigned long) qc.hits);
+  json.append(buf);
+  snprintf(buf, sizeof(buf), ",\"misses\":%lu,\"coalesced\":%lu", (unsigned long) qc.misses,
+           (unsigned long) qc.coalesced);
+  json.append(buf);
   json.append("},\"databases\":[");
 
   // A DB that was never opened (lazy panel DB) gets no row at all — there is
@@ -3744,9 +4862,15 @@ void TigoWebServer::build_tsdb_stats_json_(
   // `first` is owned by the lambda rather than the caller: an earlier version
   // had the caller clear it unconditionally, so a skipped *first* database
   // emitted a leading comma and produced invalid JSON.
+  //
+  // `retention_days` is how far back a full ring reaches: capacity times the
+  // time one record covers — history_interval for raw DBs, the bucket width
+  // for rollups. A raw DB's figure follows the interval configured now, not
+  // the one its older rows were written at.
   bool first = true;
+  const uint32_t raw_s = this->parent_->get_snapshot_interval_min() * 60;
   auto append_db = [&](const char *label,
-                       const tigo_monitor::TigoHistory::StatsSnapshot::Db &db) {
+                       const tigo_monitor::TigoHistory::StatsSnapshot::Db &db, uint32_t record_s) {
     if (!db.present) return;
     if (!first) json.append(",");
     first = false;
@@ -3757,7 +4881,7 @@ void TigoWebServer::build_tsdb_stats_json_(
       json.append(esp_err_to_name(db.error));
       json.append("\",\"records\":null,\"max_records\":null,\"writes\":null,"
                   "\"evictions\":null,\"oldest_ts\":null,\"newest_ts\":null,"
-                  "\"size_bytes\":null,\"params\":null}");
+                  "\"size_bytes\":null,\"params\":null,\"retention_days\":null}");
       return;
     }
     const tsdb_stats_t &st = db.stats;
@@ -3777,15 +4901,29 @@ void TigoWebServer::build_tsdb_stats_json_(
     snprintf(buf, sizeof(buf), "%lu", (unsigned long) st.storage_bytes); json.append(buf);
     json.append(",\"params\":");
     snprintf(buf, sizeof(buf), "%u", (unsigned) st.num_params); json.append(buf);
+    json.append(",\"retention_days\":");
+    snprintf(buf, sizeof(buf), "%.1f", (double) st.max_records * record_s / 86400.0); json.append(buf);
     json.append("}");
   };
 
-  append_db("system", snap.system);
-  for (size_t i = 0; i < tigo_monitor::kNumPanelDbs; ++i) {
-    char label[16];
-    snprintf(label, sizeof(label), "panels%zu", i);
-    append_db(label, snap.panels[i]);
+  append_db("system", snap.system, raw_s);
+  // Power keeps its panels<N> labels; metric families are labelled by file,
+  // e.g. panels_vin0.
+  for (size_t f = 0; f < tigo_monitor::kNumPanelFamilies; ++f) {
+    const char *metric = tigo_monitor::panel_metric_str(tigo_monitor::panel_family_metric(f));
+    for (size_t i = 0; i < tigo_monitor::kNumPanelDbs; ++i) {
+      char label[24];
+      if (f == 0)
+        snprintf(label, sizeof(label), "panels%zu", i);
+      else
+        snprintf(label, sizeof(label), "panels_%s%zu", metric, i);
+      append_db(label, snap.panels[f][i], raw_s);
+    }
   }
+  append_db("hourly", snap.rollups[0], tigo_monitor::history_tier_seconds(tigo_monitor::TIER_HOURLY));
+  append_db("daily", snap.rollups[1], tigo_monitor::history_tier_seconds(tigo_monitor::TIER_DAILY));
+  append_db("strings", snap.series[0], raw_s);
+  append_db("inverters", snap.series[1], raw_s);
 
   json.append("]}");
 }
@@ -149,6 +149,11 @@ class TigoWebServer : public Component
   temperature_sensor_handle_t temp_sensor_handle_{nullptr};
 #endif
   sensor::Sensor *external_temp_sensor_{nullptr};  // optional, wins over our own handle
+#ifdef TIGO_TSDB_AVAILABLE
+  // History requests waiting for, and the task running, their flash reads.
+  QueueHandle_t history_queue_{nullptr};
+  TaskHandle_t history_task_{nullptr};
+#endif
   CcaSource cca_source_{CcaSource::HTTP};
 
 #ifdef USE_TIGO_CCA_BLE
@@ -301,15 +306,32 @@ class TigoWebServer : public Component
   static esp_err_t api_health_handler(httpd_req_t *req);
   static esp_err_t api_backlight_handler(httpd_req_t *req);
   static esp_err_t api_github_release_handler(httpd_req_t *req);
+  static esp_err_t api_recent_handler(httpd_req_t *req);  // GET ?addr=&minutes= (RAM only)
+  static esp_err_t api_alerts_handler(httpd_req_t *req);  // GET underperforming panels
 #ifdef TIGO_TSDB_AVAILABLE
   static esp_err_t api_history_power_handler(httpd_req_t *req);
   static esp_err_t api_history_panel_handler(httpd_req_t *req);
+  static esp_err_t api_history_panels_handler(httpd_req_t *req);
+  static esp_err_t api_history_string_handler(httpd_req_t *req);    // GET ?label=
+  static esp_err_t api_history_inverter_handler(httpd_req_t *req);  // GET ?name=
+  // The queries behind the history handlers, run on the history worker.
+  static esp_err_t api_history_power_query(httpd_req_t *req);
+  static esp_err_t api_history_panel_query(httpd_req_t *req);
+  static esp_err_t api_history_panels_query(httpd_req_t *req);
+  static esp_err_t api_history_string_query(httpd_req_t *req);
+  static esp_err_t api_history_inverter_query(httpd_req_t *req);
+  static esp_err_t api_history_series_query(httpd_req_t *req, tigo_monitor::SeriesGroup group);
   static esp_err_t api_panels_handler(httpd_req_t *req);
   static esp_err_t api_tsdb_stats_handler(httpd_req_t *req);
 #endif
   
   // Helper functions
   bool check_api_auth(httpd_req_t *req);
+#ifdef TIGO_TSDB_AVAILABLE
+  bool start_history_worker();
+  static void history_worker_entry(void *arg);
+  esp_err_t defer_history_query(httpd_req_t *req, esp_err_t (*run)(httpd_req_t *));
+#endif
   bool check_web_auth(httpd_req_t *req);
   tigo_monitor::TigoMonitorComponent *get_parent_from_req(httpd_req_t *req);
   void get_app_html(PSRAMString& html);
@@ -319,7 +341,8 @@ class TigoWebServer : public Component
   void build_overview_json(PSRAMString& json);
   void build_node_table_json(PSRAMString& json);
   void build_strings_json(PSRAMString& json);
-  void build_energy_history_json(PSRAMString& json);
+  // Daily (or, if `monthly`, monthly) totals for [from_key, to_key], YYYYMMDD.
+  void build_energy_history_json(PSRAMString& json, uint32_t from_key, uint32_t to_key, bool monthly);
   void build_inverters_json(PSRAMString& json);
   void build_esp_status_json(PSRAMString& json);
   void build_yaml_json(PSRAMString& json, const std::set<std::string>& selected_sensors, const std::set<std::string>& selected_hub_sensors, const std::string& grouping);
@@ -327,8 +350,8 @@ class TigoWebServer : public Component
 #ifdef TIGO_TSDB_AVAILABLE
   // Pure formatting of a RAM snapshot — must not reach flash. See the comment
   // in api_tsdb_stats_handler for why that is a hard rule and not a preference.
-  void build_tsdb_stats_json_(const tigo_monitor::TigoHistory::StatsSnapshot &snap,
-                              psram_string &json);
+  void build_tsdb_stats_json_(tigo_monitor::TigoHistory *hist,
+                              const tigo_monitor::TigoHistory::StatsSnapshot &snap, psram_string &json);
 #endif
 };
 
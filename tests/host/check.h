@@ -0,0 +1,35 @@
+#pragma once
+
+// Minimal assertion helpers for the host tests: report every failure with its
+// location, keep going, and let check_exit() turn the count into the exit code.
+
+#include <cmath>
+#include <cstdio>
+
+static int check_failures = 0;
+
+#define CHECK(cond)                                                    \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      ++check_failures;                                                \
+    }                                                                  \
+  } while (0)
+
+#define CHECK_NEAR(a, b, eps)                                                             \
+  do {                                                                                    \
+    double check_a_ = (a), check_b_ = (b);                                                \
+    if (!(std::fabs(check_a_ - check_b_) <= (eps))) {                                     \
+      std::printf("%s:%d: %s = %g, expected %g\n", __FILE__, __LINE__, #a, check_a_, check_b_); \
+      ++check_failures;                                                                   \
+    }                                                                                     \
+  } while (0)
+
+static inline int check_exit(const char *name) {
+  if (check_failures == 0) {
+    std::printf("%s: ok\n", name);
+    return 0;
+  }
+  std::printf("%s: %d failure(s)\n", name, check_failures);
+  return 1;
+}
@@ -0,0 +1,158 @@
+// HistoryDownsampler (tigo_downsample.h) against a naive reference: bucket
+// every row by (ts - start) / width, then take min, max, mean and energy sum
+// per non-empty bucket.
+
+#include "check.h"
+#include "tigo_downsample.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace esphome::tigo_monitor;
+
+struct Row {
+  uint32_t ts;
+  float avg, lo, hi, e;
+};
+
+struct Bucket {
+  uint32_t ts;
+  float avg, lo, hi, e;
+};
+
+static std::vector<Bucket> run(uint32_t start, uint32_t end, uint32_t points, const std::vector<Row> &rows) {
+  HistoryDownsampler ds(start, end, points);
+  std::vector<Bucket> out;
+  auto emit = [&](uint32_t ts, float avg, float lo, float hi, float e) { out.push_back({ts, avg, lo, hi, e}); };
+  for (const Row &r : rows) ds.add(r.ts, r.avg, r.lo, r.hi, r.e, emit);
+  ds.flush(emit);
+  return out;
+}
+
+static std::vector<Bucket> naive(uint32_t start, uint32_t width, const std::vector<Row> &rows) {
+  std::vector<Bucket> out;
+  std::vector<std::vector<Row>> groups;
+  std::vector<uint32_t> keys;
+  for (const Row &r : rows) {
+    uint32_t k = r.ts >= start ? (r.ts - start) / width : 0;
+    if (keys.empty() || keys.back() != k) {
+      keys.push_back(k);
+      groups.emplace_back();
+    }
+    groups.back().push_back(r);
+  }
+  for (const auto &g : groups) {
+    Bucket b{g.front().ts, 0.0f, g.front().lo, g.front().hi, 0.0f};
+    double sum = 0.0, e = 0.0;
+    for (const Row &r : g) {
+      if (r.lo < b.lo) b.lo = r.lo;
+      if (r.hi > b.hi) b.hi = r.hi;
+      sum += r.avg;
+      e += r.e;
+    }
+    b.avg = (float) (sum / g.size());
+    b.e = (float) e;
+    out.push_back(b);
+  }
+  return out;
+}
+
+static void check_same(const std::vector<Bucket> &got, const std::vector<Bucket> &want) {
+  CHECK(got.size() == want.size());
+  for (size_t i = 0; i < got.size() && i < want.size(); ++i) {
+    CHECK(got[i].ts == want[i].ts);
+    CHECK_NEAR(got[i].avg, want[i].avg, 1e-3);
+    CHECK_NEAR(got[i].lo, want[i].lo, 0.0);
+    CHECK_NEAR(got[i].hi, want[i].hi, 0.0);
+    CHECK_NEAR(got[i].e, want[i].e, 1e-4);
+  }
+}
+
+static Row raw(uint32_t ts, float p, float e) { return Row{ts, p, p, p, e}; }
+
+static void test_width() {
+  CHECK(HistoryDownsampler(0, 99, 10).width_s() == 10);
+  CHECK(HistoryDownsampler(0, 100, 10).width_s() == 11);  // ceil(101 / 10)
+  CHECK(HistoryDownsampler(0, 5, 100).width_s() == 1);
+  CHECK(HistoryDownsampler(0, 1000, 0).width_s() == 1001);  // 0 points means one bucket
+  CHECK(HistoryDownsampler(500, 100, 10).width_s() == 1);   // inverted range
+  CHECK(HistoryDownsampler(0, 0xFFFFFFFFu, 1).width_s() == 0xFFFFFFFFu);
+}
+
+static void test_empty() {
+  CHECK(run(1000, 2000, 10, {}).empty());
+}
+
+static void test_single_point() {
+  std::vector<Row> rows = {raw(1500, 42.0f, 0.25f)};
+  auto got = run(1000, 2000, 10, rows);
+  check_same(got, naive(1000, HistoryDownsampler(1000, 2000, 10).width_s(), rows));
+  CHECK(got.size() == 1 && got[0].ts == 1500);
+}
+
+static void test_gaps_across_buckets() {
+  // Width 100; rows in buckets 0, 1, 4 and 9 only. Empty buckets emit nothing.
+  const uint32_t start = 10000, end = 10999;
+  std::vector<Row> rows = {raw(10000, 10, 0.1f), raw(10050, 30, 0.2f), raw(10150, 5, 0.0f),
+                           raw(10199, 7, 0.3f),  raw(10420, 90, 1.0f), raw(10990, 1, 0.05f)};
+  auto got = run(start, end, 10, rows);
+  check_same(got, naive(start, 100, rows));
+  CHECK(got.size() == 4);
+  // Rollup rows carry their own min/max; the envelope must survive.
+  std::vector<Row> rollups = {{10000, 50, 20, 80, 1.0f}, {10060, 40, 35, 95, 0.5f}, {10300, 60, 1, 61, 2.0f}};
+  check_same(run(start, end, 10, rollups), naive(start, 100, rollups));
+}
+
+static void test_partial_last_bucket() {
+  // 1001 s in 10 points: width 101, and the tenth bucket covers 909..1000,
+  // which is shorter than the rest.
+  const uint32_t start = 0, end = 1000;
+  std::vector<Row> rows;
+  for (uint32_t ts = 0; ts <= end; ts += 7) rows.push_back(raw(ts, (float) (ts % 13), 0.01f));
+  auto got = run(start, end, 10, rows);
+  check_same(got, naive(start, 101, rows));
+  CHECK(got.size() == 10);
+  // Stamped with its first row: 910 is the first multiple of 7 past 909.
+  CHECK(!got.empty() && got.back().ts == 910);
+}
+
+static void test_rows_before_start() {
+  // A rollup query starts on a bucket boundary that can precede the
+  // requested start; such rows fold into the first bucket.
+  std::vector<Row> rows = {raw(900, 3, 0.1f), raw(1000, 9, 0.1f), raw(1099, 6, 0.1f), raw(1100, 1, 0.1f)};
+  auto got = run(1000, 1999, 10, rows);
+  check_same(got, naive(1000, 100, rows));
+  CHECK(got.size() == 2);
+}
+
+static void test_random_against_naive() {
+  srand(12345);
+  for (int iter = 0; iter < 200; ++iter) {
+    const uint32_t start = 1700000000u + (uint32_t) (rand() % 100000);
+    const uint32_t span = 1 + (uint32_t) (rand() % 200000);
+    const uint32_t points = 1 + (uint32_t) (rand() % 400);
+    std::vector<Row> rows;
+    uint32_t ts = start;
+    while (ts <= start + span - 1) {
+      float lo = (float) (rand() % 500), hi = lo + (float) (rand() % 300);
+      rows.push_back({ts, (lo + hi) / 2.0f, lo, hi, (float) (rand() % 100) / 100.0f});
+      // Mostly steady cadence, with the odd long gap.
+      ts += (rand() % 20 == 0) ? 1 + (uint32_t) (rand() % (span / 4 + 1)) : 1 + (uint32_t) (rand() % 600);
+    }
+    HistoryDownsampler ds(start, start + span - 1, points);
+    auto got = run(start, start + span - 1, points, rows);
+    check_same(got, naive(start, ds.width_s(), rows));
+    CHECK(got.size() <= points);
+  }
+}
+
+int main() {
+  test_width();
+  test_empty();
+  test_single_point();
+  test_gaps_across_buckets();
+  test_partial_last_bucket();
+  test_rows_before_start();
+  test_random_against_naive();
+  return check_exit("test_downsample");
+}
@@ -0,0 +1,191 @@
+// Underperformance classifier (tigo_health.h) and the quartile summary that
+// feeds it its reference (tigo_quantile.h).
+
+#include "check.h"
+#include "tigo_health.h"
+#include "tigo_quantile.h"
+
+using namespace esphome::tigo_monitor;
+
+static const uint32_t kMin = 60UL * 1000UL;
+// A step long enough that alpha rounds to exactly 1, so the ratio jumps
+// straight to the frame's value.
+static const uint32_t kJump = 100000UL * 1000UL;
+
+static HealthParams params() {
+  HealthParams p;
+  p.threshold = 0.7f;
+  p.hold_ms = 30 * kMin;
+  return p;
+}
+
+static void test_untrusted_reference_freezes() {
+  PanelHealth h;
+  HealthParams p = params();
+  CHECK(!update_panel_health(h, p, 1000, 50.0f, NAN, HealthReference::STRING));
+  CHECK(!update_panel_health(h, p, 2000, 5.0f, kMinReferenceW - 0.01f, HealthReference::STRING));
+  CHECK(!update_panel_health(h, p, 3000, NAN, 200.0f, HealthReference::STRING));
+  CHECK(std::isnan(h.ratio));
+  CHECK(h.reference == HealthReference::NONE);
+  // Exactly at the floor is trusted.
+  update_panel_health(h, p, 4000, 10.0f, kMinReferenceW, HealthReference::ARRAY);
+  CHECK_NEAR(h.ratio, 0.5, 1e-6);
+  CHECK(h.reference == HealthReference::ARRAY);
+}
+
+static void test_threshold_is_strict() {
+  PanelHealth h;
+  HealthParams p = params();
+  // First trusted frame seeds the ratio exactly; 0.7 is not below 0.7.
+  update_panel_health(h, p, 1000, 70.0f, 100.0f, HealthReference::STRING);
+  CHECK(!h.below);
+  for (uint32_t t = 1000; t <= 1000 + 2 * p.hold_ms; t += kMin)
+    update_panel_health(h, p, t, 70.0f, 100.0f, HealthReference::STRING);
+  CHECK(!h.alerting);
+}
+
+static void test_hold_boundary() {
+  PanelHealth h;
+  HealthParams p = params();
+  const uint32_t t0 = 5000;
+  update_panel_health(h, p, t0, 50.0f, 100.0f, HealthReference::STRING);
+  CHECK(h.below);
+  CHECK(h.below_since_ms == t0);
+  CHECK(!update_panel_health(h, p, t0 + p.hold_ms - 1, 50.0f, 100.0f, HealthReference::STRING));
+  CHECK(!h.alerting);
+  CHECK(update_panel_health(h, p, t0 + p.hold_ms, 50.0f, 100.0f, HealthReference::STRING));
+  CHECK(h.alerting);
+  CHECK(h.alert_since_ms == t0 + p.hold_ms);
+}
+
+static void test_hysteresis() {
+  PanelHealth h;
+  HealthParams p = params();
+  uint32_t t = 1000;
+  update_panel_health(h, p, t, 50.0f, 100.0f, HealthReference::STRING);
+  t += p.hold_ms;
+  update_panel_health(h, p, t, 50.0f, 100.0f, HealthReference::STRING);
+  CHECK(h.alerting);
+  // Back above the threshold but inside the hysteresis band: stays up.
+  t += kJump;
+  CHECK(!update_panel_health(h, p, t, 74.0f, 100.0f, HealthReference::STRING));
+  CHECK_NEAR(h.ratio, 0.74, 1e-6);
+  CHECK(h.alerting);
+  CHECK(!h.below);
+  // Clear of the band: recovers.
+  t += kJump;
+  CHECK(update_panel_health(h, p, t, 76.0f, 100.0f, HealthReference::STRING));
+  CHECK(!h.alerting);
+}
+
+static void test_dark_restarts_hold() {
+  PanelHealth h;
+  HealthParams p = params();
+  uint32_t t = 1000;
+  update_panel_health(h, p, t, 50.0f, 100.0f, HealthReference::STRING);
+  t += 20 * kMin;
+  update_panel_health(h, p, t, 50.0f, 100.0f, HealthReference::STRING);
+  // Dusk: reference drops out, the state freezes and the hold timer is lost.
+  t += kMin;
+  update_panel_health(h, p, t, 1.0f, 2.0f, HealthReference::STRING);
+  CHECK(!h.below);
+  CHECK_NEAR(h.ratio, 0.5, 1e-6);
+  // Twenty more minutes below is not thirty from the first frame.
+  t += 10 * kMin;
+  update_panel_health(h, p, t, 50.0f, 100.0f, HealthReference::STRING);
+  CHECK(h.below_since_ms == t);
+  t += 20 * kMin;
+  update_panel_health(h, p, t, 50.0f, 100.0f, HealthReference::STRING);
+  CHECK(!h.alerting);
+}
+
+static void test_ratio_clamped() {
+  PanelHealth h;
+  HealthParams p = params();
+  update_panel_health(h, p, 1000, 900.0f, 100.0f, HealthReference::STRING);
+  CHECK_NEAR(h.ratio, 2.0, 1e-6);
+  PanelHealth g;
+  update_panel_health(g, p, 1000, -5.0f, 100.0f, HealthReference::STRING);
+  CHECK_NEAR(g.ratio, 0.0, 1e-6);
+}
+
+static void test_rate_independent() {
+  // A 2 s reporter and a 30 s reporter see the same step and should be in the
+  // same place ten minutes later.
+  HealthParams p = params();
+  PanelHealth fast, slow;
+  update_panel_health(fast, p, 1000, 100.0f, 100.0f, HealthReference::STRING);
+  update_panel_health(slow, p, 1000, 100.0f, 100.0f, HealthReference::STRING);
+  for (uint32_t t = 3000; t <= 1000 + 10 * kMin; t += 2000)
+    update_panel_health(fast, p, t, 40.0f, 100.0f, HealthReference::STRING);
+  for (uint32_t t = 31000; t <= 1000 + 10 * kMin; t += 30000)
+    update_panel_health(slow, p, t, 40.0f, 100.0f, HealthReference::STRING);
+  const double expect = 0.4 + 0.6 * std::exp(-600.0 / kHealthTauS);
+  CHECK_NEAR(fast.ratio, expect, 1e-3);
+  CHECK_NEAR(slow.ratio, expect, 1e-3);
+}
+
+static void test_quartiles_edges() {
+  QuartileSketch s;
+  QuartileSummary q = s.summary();
+  CHECK(q.n == 0);
+  CHECK(std::isnan(q.median));
+  // An empty window is no reference at all.
+  PanelHealth h;
+  CHECK(!update_panel_health(h, params(), 1000, 50.0f, q.median, HealthReference::STRING));
+  CHECK(std::isnan(h.ratio));
+
+  // One sample: every quartile is that sample and the IQR is zero.
+  s.add(250.0f);
+  q = s.summary();
+  CHECK(q.n == 1);
+  CHECK_NEAR(q.q1, 250.0, 1e-6);
+  CHECK_NEAR(q.q3, 250.0, 1e-6);
+  CHECK_NEAR(q.lower_fence, 250.0, 1e-6);
+  CHECK_NEAR(q.upper_fence, 250.0, 1e-6);
+
+  // Three samples are interpolated exactly.
+  s.reset();
+  s.add(300.0f);
+  s.add(100.0f);
+  s.add(200.0f);
+  q = s.summary();
+  CHECK_NEAR(q.q1, 150.0, 1e-4);
+  CHECK_NEAR(q.median, 200.0, 1e-4);
+  CHECK_NEAR(q.q3, 250.0, 1e-4);
+  CHECK_NEAR(q.lower_fence, 0.0, 1e-3);
+  CHECK_NEAR(q.upper_fence, 400.0, 1e-3);
+
+  // Identical panels: zero IQR, fences collapse onto the value, and the
+  // NaN a silent panel would send is ignored rather than poisoning it.
+  s.reset();
+  for (int i = 0; i < 40; ++i) s.add(i == 7 ? NAN : 320.0f);
+  q = s.summary();
+  CHECK(q.n == 39);
+  CHECK_NEAR(q.q3 - q.q1, 0.0, 1e-4);
+  CHECK_NEAR(q.median, 320.0, 1e-4);
+
+  // A single shaded panel among many does not drag the median, and sits
+  // below the lower fence.
+  s.reset();
+  for (int i = 0; i < 200; ++i) s.add(i % 20 == 0 ? 60.0f : 300.0f + (float) (i % 7));
+  q = s.summary();
+  CHECK(q.q1 <= q.median && q.median <= q.q3);
+  CHECK(q.median > 295.0f && q.median < 310.0f);
+  CHECK(60.0f < q.lower_fence);
+  PanelHealth shaded;
+  update_panel_health(shaded, params(), 1000, 60.0f, q.median, HealthReference::STRING);
+  CHECK(shaded.below);
+}
+
+int main() {
+  test_untrusted_reference_freezes();
+  test_threshold_is_strict();
+  test_hold_boundary();
+  test_hysteresis();
+  test_dark_restarts_hold();
+  test_ratio_clamped();
+  test_rate_independent();
+  test_quartiles_edges();
+  return check_exit("test_health");
+}